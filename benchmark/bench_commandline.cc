@@ -0,0 +1,73 @@
+/* Cost of command line parsing with 64 declared options.
+ *
+ * "linear match" reproduces the previous option lookup of
+ * command_line::parse: each argument is compared to the short, long and
+ * --long= forms of every option in turn, building the strings to compare
+ * to each time. It only finds the option, so its time is a lower bound
+ * of what parse() used to spend per argument.
+ */
+#include "benchmark.hh"
+#include <utilmm/configfile/commandline.hh>
+#include <utilmm/configfile/configset.hh>
+#include <utilmm/stringtools.hh>
+#include <boost/lexical_cast.hpp>
+#include <vector>
+
+using namespace utilmm;
+using std::string;
+
+namespace
+{
+    int const option_count = 64;
+
+    int linear_match(std::vector<cmdline_option> const& options, char const* arg)
+    {
+        for (size_t i = 0; i < options.size(); ++i)
+        {
+            cmdline_option const& opt = options[i];
+            if (arg == "-" + opt.getShort()
+                    || arg == "--" + opt.getLong()
+                    || starts_with(arg, "--" + opt.getLong() + "="))
+                return i;
+        }
+        return -1;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    long const count = argc > 1 ? boost::lexical_cast<long>(argv[1]) : 20000;
+
+    std::list<string> description;
+    for (int i = 0; i < option_count; ++i)
+    {
+        string name = "option-" + boost::lexical_cast<string>(i);
+        description.push_back(":" + name + "=int");
+    }
+    std::vector<cmdline_option> options(description.begin(), description.end());
+    command_line cmdline(description);
+
+    // Each option is given once, as --option-i=i
+    std::vector<string> args;
+    for (int i = 0; i < option_count; ++i)
+        args.push_back("--option-" + boost::lexical_cast<string>(i) + "=" + boost::lexical_cast<string>(i));
+    std::vector<char const*> c_args;
+    for (size_t i = 0; i < args.size(); ++i)
+        c_args.push_back(args[i].c_str());
+
+    benchmark::timer timer;
+    for (long n = 0; n < count; ++n)
+        for (int i = 0; i < option_count; ++i)
+            benchmark::use(linear_match(options, c_args[i]));
+    benchmark::report("linear match, per argument", timer.elapsed(), count * option_count);
+
+    timer.reset();
+    for (long n = 0; n < count; ++n)
+    {
+        config_set config;
+        cmdline.parse(option_count, &c_args[0], config);
+        benchmark::use(config);
+    }
+    benchmark::report("command_line::parse, per argument", timer.elapsed(), count * option_count);
+    return 0;
+}
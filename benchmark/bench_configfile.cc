@@ -0,0 +1,155 @@
+/* Parsing time of config_file on generated multi-megabyte files.
+ *
+ * "regex parser" is the boost::regex based parser config_file used
+ * before, kept here for comparison. Times are given per line. The heap
+ * memory used by the loaded tree is given for each config_file mode.
+ * "Cached, warm" loads the file from an up to date compiled form.
+ */
+#include "benchmark.hh"
+#include <utilmm/configfile/configfile.hh>
+#include <boost/filesystem/operations.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/regex.hpp>
+#include <fstream>
+#include <sstream>
+#include <malloc.h>
+#include <stdlib.h>
+
+using namespace utilmm;
+using std::string;
+
+namespace
+{
+    /** The previous implementation of config_file::read */
+    void regex_read(string const& name, config_set& root)
+    {
+        std::fstream file;
+        file.open(name.c_str(), std::fstream::in);
+
+        static const string
+            regexp_header("^[[:blank:]]*"),
+            regexp_trail("[[:blank:]]*(?:#.*)?$");
+
+        static boost::regex
+            rx_empty(regexp_header + regexp_trail),
+            rx_name(regexp_header + "([[:alnum:]_-]+)([^#]*)" + regexp_trail),
+            rx_attribute(regexp_header + ":[[:blank:]]*([^#]+)" + regexp_trail),
+            rx_open_bracket(regexp_header + "\\{" + regexp_trail),
+            rx_close_bracket(regexp_header + "\\}" + regexp_trail);
+
+        enum { Normal, FindBracket } mode = Normal;
+        config_set* cur_set = &root;
+        int line_number = 1;
+        std::stringbuf linebuf;
+        const string empty_string;
+        while (! file.eof())
+        {
+            while (file.peek() == '\n')
+            {
+                ++line_number;
+                file.ignore();
+            }
+
+            file.get(linebuf);
+            const string line(linebuf.str());
+            linebuf.str(empty_string);
+
+            boost::smatch result;
+            if (regex_match(line, rx_empty)) continue;
+
+            if (mode == FindBracket)
+            {
+                if (! regex_match(line, rx_open_bracket))
+                    throw parse_error(line_number, "expected '{', found " + line);
+                mode = Normal;
+            }
+            else if (regex_match(line, result, rx_name))
+            {
+                string key = result[1];
+                string value = result[2];
+                boost::smatch attribute_value;
+                if (value.empty() || regex_match(value, rx_open_bracket))
+                {
+                    mode = value.empty() ? FindBracket : Normal;
+                    config_set* new_set = new config_set(cur_set);
+                    cur_set->insert( key, new_set );
+                    cur_set = new_set;
+                }
+                else if (regex_match(value, attribute_value, rx_attribute)) 
+                    cur_set->insert( key, attribute_value[1] );
+                else
+                    throw parse_error(line_number, "expected '" + key + ": value', found " + key + value);
+            }
+            else if (regex_match(line, rx_close_bracket))
+                cur_set = cur_set->parent();
+            else
+                throw parse_error(line_number, "expected \"key: value\", found " + line);
+        }
+    }
+
+    /** Writes a file of \c sections sections of 100 lines each, and
+     * returns its line count */
+    long generate(string const& name, long sections)
+    {
+        std::ofstream out(name.c_str());
+        long lines = 0;
+        for (long i = 0; i < sections; ++i)
+        {
+            out << "# section " << i << "\n"
+                << "section_" << i << "\n{\n";
+            for (int j = 0; j < 48; ++j)
+                out << "    key_" << j << ": value " << i * j << "  # comment\n";
+            out << "    child {\n";
+            for (int j = 0; j < 44; ++j)
+                out << "\tlist: " << j << "\n";
+            out << "    }\n}\n";
+            lines += 100;
+        }
+        return lines;
+    }
+
+    std::size_t heap_usage()
+    { return mallinfo2().uordblks; }
+
+    void load(string const& name, config_file::load_mode mode, string const& label, long lines)
+    {
+        std::size_t heap = heap_usage();
+        benchmark::timer timer;
+        config_file file(name, mode);
+        benchmark::report(label, timer.elapsed(), lines);
+        std::cout << "  heap: " << (heap_usage() - heap) / (1024 * 1024) << " MB" << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    long const sections = argc > 1 ? boost::lexical_cast<long>(argv[1]) : 20000;
+    string const name = (boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path("bench-configfile-%%%%%%.config")).string();
+
+    long const lines = generate(name, sections);
+    std::cout << boost::filesystem::file_size(name) / (1024 * 1024) << " MB, "
+        << lines << " lines" << std::endl;
+
+    benchmark::timer timer;
+    { config_set root;
+        regex_read(name, root);
+        benchmark::use(root.empty());
+    }
+    benchmark::report("regex parser", timer.elapsed(), lines);
+
+    load(name, config_file::ReadFile, "config_file, ReadFile", lines);
+    load(name, config_file::MapFile, "config_file, MapFile", lines);
+
+    boost::filesystem::path cache_dir = boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path("bench-configfile-cache-%%%%%%");
+    setenv("UTILMM_CONFIG_CACHE", cache_dir.string().c_str(), 1);
+    load(name, config_file::Cached, "config_file, Cached, cold", lines);
+    load(name, config_file::Cached, "config_file, Cached, warm", lines);
+    std::cout << "  compiled size: " << boost::filesystem::file_size(config_file::cache_path(name)) / (1024 * 1024)
+        << " MB" << std::endl;
+    boost::filesystem::remove_all(cache_dir);
+
+    boost::filesystem::remove(name);
+    return 0;
+}
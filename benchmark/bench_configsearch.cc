@@ -0,0 +1,123 @@
+/* Cost of ConfigurationFinder::find with a deep search path.
+ *
+ * ROCK_CONFIG_PATH lists 64 directories of 32 files each, and the files
+ * looked for are in the last one, in a package subdirectory, or do not
+ * exist. The cold runs include listing the directories.
+ *
+ * "previous" is the previous implementation: ROCK_CONFIG_PATH split on
+ * each call, then boost::filesystem::exists on each candidate.
+ */
+#include "benchmark.hh"
+#include <utilmm/configsearch/configuration_finder.hh>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <vector>
+#include <stdlib.h>
+
+using namespace utilmm;
+using std::string;
+namespace fs = boost::filesystem;
+
+namespace
+{
+    int const directory_count = 64;
+    int const file_count = 32;
+    long const lookups = 200;
+
+    struct lookup
+    {
+        string file;
+        string package;
+    };
+
+    string previous_find(string const& file, string const& package)
+    {
+        std::vector<string> directories;
+        boost::split(directories, getenv("ROCK_CONFIG_PATH"), boost::is_any_of(":"));
+        if (!package.empty())
+        {
+            for (std::vector<string>::iterator it = directories.begin(); it != directories.end(); ++it)
+                *it = (fs::path(*it) / package).string();
+        }
+
+        if (fs::exists(file))
+            return fs::system_complete(file).string();
+        for (std::vector<string>::const_iterator it = directories.begin(); it != directories.end(); ++it)
+        {
+            fs::path candidate = fs::path(*it) / file;
+            if (fs::exists(candidate))
+                return fs::system_complete(candidate).string();
+        }
+        return string();
+    }
+
+    struct previous
+    {
+        string operator()(lookup const& q) const { return previous_find(q.file, q.package); }
+    };
+
+    struct current
+    {
+        string operator()(lookup const& q) const { return ConfigurationFinder::find(q.file, q.package); }
+    };
+
+    template<typename Find>
+    void run(string const& name, std::vector<lookup> const& queries, long count, Find find)
+    {
+        benchmark::timer timer;
+        for (long i = 0; i < count; ++i)
+            benchmark::use(find(queries[i % queries.size()]));
+        benchmark::report(name, timer.elapsed(), count);
+    }
+}
+
+int main()
+{
+    fs::path root = fs::temp_directory_path() / fs::unique_path("utilmm-bench-%%%%-%%%%");
+    string search_path;
+    for (int d = 0; d < directory_count; ++d)
+    {
+        fs::path dir = root / ("dir" + boost::lexical_cast<string>(d));
+        fs::create_directories(dir / "pkg");
+        for (int f = 0; f < file_count; ++f)
+        {
+            string file = "file" + boost::lexical_cast<string>(d == directory_count - 1 ? f : d * file_count + f) + ".conf";
+            fs::ofstream((dir / file));
+            if (d == directory_count - 1)
+                fs::ofstream((dir / "pkg" / file));
+        }
+        if (!search_path.empty())
+            search_path += ":";
+        search_path += dir.string();
+    }
+    setenv("ROCK_CONFIG_PATH", search_path.c_str(), 1);
+
+    std::vector<lookup> queries;
+    for (int f = 0; f < file_count; ++f)
+    {
+        lookup q;
+        q.file = "file" + boost::lexical_cast<string>(f) + ".conf";
+        queries.push_back(q);
+        q.package = "pkg";
+        queries.push_back(q);
+    }
+    lookup missing;
+    missing.file = "missing.conf";
+    queries.push_back(missing);
+
+    std::cout << directory_count << " directories in the search path" << std::endl;
+    run("previous", queries, lookups * 10, previous());
+    ConfigurationFinder::setIndexMode(ConfigurationFinder::NoIndex);
+    run("no index", queries, lookups * 10, current());
+    ConfigurationFinder::setIndexMode(ConfigurationFinder::StaticIndex);
+    run("static index, cold", queries, queries.size(), current());
+    run("static index", queries, lookups * 100, current());
+    ConfigurationFinder::setIndexMode(ConfigurationFinder::WatchedIndex);
+    run("watched index, cold", queries, queries.size(), current());
+    run("watched index", queries, lookups * 100, current());
+
+    fs::remove_all(root);
+    return 0;
+}
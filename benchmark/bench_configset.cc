@@ -0,0 +1,169 @@
+/* Cost of config_set lookups on a scope of 64 keys.
+ *
+ * "multimap" reproduces the previous storage of config_set and its get<>
+ * methods for comparison: values in a std::multimap, and single values
+ * read by building the list of all values for the key first.
+ * "binding" reads the values through config_set::binding handles.
+ *
+ * The traversal benchmarks walk a tree of 16^3 scopes, either through
+ * the std::list returned by children() or through children_range(), and
+ * resolve a path either through children() as child() used to, or
+ * through lookup().
+ */
+#include "benchmark.hh"
+#include <utilmm/configfile/configset.hh>
+#include <boost/lexical_cast.hpp>
+#include <map>
+
+using namespace utilmm;
+using std::string;
+
+namespace
+{
+    struct multimap_set
+    {
+        typedef std::multimap<string, string> ValueMap;
+        ValueMap m_values;
+
+        void insert(string const& name, string const& value)
+        { m_values.insert(make_pair(name, value)); }
+
+        std::list<string> get_list(string const& name) const
+        {
+            std::list<string> values;
+            for (ValueMap::const_iterator it = m_values.find(name); it != m_values.end() && it->first == name; ++it)
+                values.push_back(it->second);
+            return values;
+        }
+
+        template<typename T>
+        T get(string const& name, T const& defval = T()) const
+        {
+            std::list<string> values = get_list(name);
+            if (values.empty())
+                return defval;
+            std::list<T> result;
+            for (std::list<string>::const_iterator it = values.begin(); it != values.end(); ++it)
+                result.push_back(boost::lexical_cast<T>(*it));
+            return result.front();
+        }
+    };
+
+    string key(int i) { return "parameter_" + boost::lexical_cast<string>(i); }
+
+    template<typename Set>
+    void fill(Set& set)
+    {
+        for (int i = 0; i < 64; ++i)
+            set.insert(key(i), boost::lexical_cast<string>(i * 3));
+    }
+
+    template<typename T, typename Set>
+    void lookup(Set const& set, string const& label, long count)
+    {
+        string const keys[] = { key(3), key(17), key(42), key(63) };
+        benchmark::timer timer;
+        for (long i = 0; i < count; ++i)
+            benchmark::use(set.template get<T>(keys[i & 3]));
+        benchmark::report(label, timer.elapsed(), count);
+    }
+
+    template<typename T>
+    void lookup_binding(config_set const& set, string const& label, long count)
+    {
+        config_set::binding<T> const bindings[] = 
+        { set.bind<T>(key(3)), set.bind<T>(key(17)), set.bind<T>(key(42)), set.bind<T>(key(63)) };
+        benchmark::timer timer;
+        for (long i = 0; i < count; ++i)
+            benchmark::use(*bindings[i & 3]);
+        benchmark::report(label, timer.elapsed(), count);
+    }
+}
+
+namespace
+{
+    void fill_tree(config_set& set, int depth)
+    {
+        set.insert("value", "1");
+        if (depth == 0)
+            return;
+        for (int i = 0; i < 16; ++i)
+        {
+            config_set* child = new config_set(&set);
+            fill_tree(*child, depth - 1);
+            set.insert("node", child);
+        }
+    }
+
+    int walk_list(config_set const& set)
+    {
+        int count = 1;
+        std::list<config_set const*> children = set.children("node");
+        for (std::list<config_set const*>::const_iterator it = children.begin(); it != children.end(); ++it)
+            count += walk_list(**it);
+        return count;
+    }
+
+    int walk_range(config_set const& set)
+    {
+        int count = 1;
+        config_set::child_range children = set.children_range("node");
+        for (config_set::child_iterator it = children.begin(); it != children.end(); ++it)
+            count += walk_range(*it);
+        return count;
+    }
+
+    config_set const* lookup_list(config_set const& set)
+    {
+        config_set const* current = &set;
+        for (int i = 0; i < 3; ++i)
+            current = current->children("node").front();
+        return current;
+    }
+
+    void traversal(long count)
+    {
+        config_set tree;
+        fill_tree(tree, 3);
+
+        long const walks = count / 4096 + 1;
+        benchmark::timer timer;
+        for (long i = 0; i < walks; ++i)
+            benchmark::use(walk_list(tree));
+        benchmark::report("walk, children() lists", timer.elapsed(), walks * 4369);
+
+        timer.reset();
+        for (long i = 0; i < walks; ++i)
+            benchmark::use(walk_range(tree));
+        benchmark::report("walk, children_range()", timer.elapsed(), walks * 4369);
+
+        timer.reset();
+        for (long i = 0; i < count; ++i)
+            benchmark::use(lookup_list(tree));
+        benchmark::report("path, children() lists", timer.elapsed(), count);
+
+        timer.reset();
+        for (long i = 0; i < count; ++i)
+            benchmark::use(tree.lookup("node/node/node"));
+        benchmark::report("path, lookup()", timer.elapsed(), count);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    long const count = argc > 1 ? boost::lexical_cast<long>(argv[1]) : 2000000;
+
+    multimap_set old_set;
+    fill(old_set);
+    config_set new_set;
+    fill(new_set);
+
+    lookup<int>(old_set, "multimap, get<int>", count);
+    lookup<int>(new_set, "config_set, get<int>", count);
+    lookup<string>(old_set, "multimap, get<string>", count);
+    lookup<string>(new_set, "config_set, get<string>", count);
+    lookup_binding<int>(new_set, "config_set, binding<int>", count);
+    lookup_binding<string>(new_set, "config_set, binding<string>", count);
+    traversal(count);
+    return 0;
+}
@@ -0,0 +1,75 @@
+/* Startup cost of loading several plugin libraries with plugin::loader.
+ *
+ * Each round loads BENCH_LOADER_MODULES copies of the benchmark plugin
+ * and creates one object from each. The libraries are unloaded at the
+ * end of each round, when the loader and the objects are destroyed.
+ */
+#include "benchmark.hh"
+#include "bench_plugin.hh"
+#include <utilmm/plugin/loader.hh>
+#include <boost/lexical_cast.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+
+using namespace utilmm::plugin;
+
+namespace
+{
+    std::string module_path(int i)
+    {
+        return std::string(BENCH_LOADER_DIR) + "/libbench_loader_module_"
+            + boost::lexical_cast<std::string>(i) + ".so";
+    }
+    std::string class_name(int i)
+    { return "bench_" + boost::lexical_cast<std::string>(i); }
+
+    /** Eagerly loads all modules with \c threads threads, then creates
+     * one object from each */
+    void eager(unsigned int threads, bool print_report)
+    {
+        boost::ptr_vector<bench_plugin_base> objects;
+        loader<bench_plugin_base> plugins(threads);
+        for (int i = 0; i < BENCH_LOADER_MODULES; ++i)
+            plugins.load(module_path(i));
+        plugins.wait();
+        for (int i = 0; i < BENCH_LOADER_MODULES; ++i)
+            objects.push_back(plugins.create(class_name(i)));
+        if (print_report)
+            plugins.report(std::cout);
+    }
+
+    /** Declares all modules, but only creates an object from the first one */
+    void lazy()
+    {
+        loader<bench_plugin_base> plugins(1);
+        for (int i = 0; i < BENCH_LOADER_MODULES; ++i)
+            plugins.declare(class_name(i), module_path(i));
+        delete plugins.create(class_name(0));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    long const rounds = argc > 1 ? boost::lexical_cast<long>(argv[1]) : 200;
+    unsigned int const threads = boost::thread::hardware_concurrency();
+
+    benchmark::timer timer;
+    for (long i = 0; i < rounds; ++i)
+        eager(1, false);
+    benchmark::report("eager, 1 thread", timer.elapsed(), rounds);
+
+    timer.reset();
+    for (long i = 0; i < rounds; ++i)
+        eager(threads, false);
+    benchmark::report("eager, " + boost::lexical_cast<std::string>(threads) + " threads",
+            timer.elapsed(), rounds);
+
+    timer.reset();
+    for (long i = 0; i < rounds; ++i)
+        lazy();
+    benchmark::report("lazy, 1 of " + boost::lexical_cast<std::string>(BENCH_LOADER_MODULES)
+            + " libraries used", timer.elapsed(), rounds);
+
+    std::cout << std::endl;
+    eager(threads, true);
+    return 0;
+}
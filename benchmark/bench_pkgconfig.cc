@@ -0,0 +1,165 @@
+/* Cost of pkgconfig queries, with the pkg-config program, with the
+ * native .pc parser and with pkgconfig_batch.
+ *
+ * The packages are the ones given on the command line, or all the
+ * packages listed by pkg-config --list-all. For each of them, the program
+ * queries the version, a variable and all the compiler and linker flags
+ * with both backends, and reports the queries whose results differ. The
+ * same queries are then run by pkgconfig_batch, once with an empty
+ * result cache and once with the cache filled by the first run.
+ */
+#include "benchmark.hh"
+#include <utilmm/configfile/pkgconfig.hh>
+#include <boost/filesystem/operations.hpp>
+#include <vector>
+#include <stdlib.h>
+
+using namespace utilmm;
+using std::string;
+
+namespace
+{
+    int const query_count = 10;
+
+    string query(pkgconfig const& pc, int i)
+    {
+        switch (i)
+        {
+            case 0: return pc.version();
+            case 1: return pc.get("prefix");
+            case 2: return pc.compiler(pkgconfig::All);
+            case 3: return pc.compiler(pkgconfig::Path);
+            case 4: return pc.compiler(pkgconfig::Other);
+            case 5: return pc.linker(pkgconfig::All);
+            case 6: return pc.linker(pkgconfig::Path);
+            case 7: return pc.linker(pkgconfig::Other);
+            case 8: return pc.linker(pkgconfig::Static);
+            default: return pc.linker(pkgconfig::Libraries);
+        }
+    }
+
+    char const* const query_names[query_count] = {
+        "version", "get(prefix)", "compiler", "compiler(Path)", "compiler(Other)",
+        "linker", "linker(Path)", "linker(Other)", "linker(Static)", "linker(Libraries)" };
+
+    /** Runs all the queries on all the packages, and returns the
+     * results, or "<not found>" if the query failed */
+    std::vector<string> run(std::vector<string> const& packages, pkgconfig::Backend backend, double& duration, long& count)
+    {
+        std::vector<string> results;
+        benchmark::timer timer;
+        for (size_t p = 0; p < packages.size(); ++p)
+        {
+            if (!pkgconfig::exists(packages[p], backend))
+            {
+                results.insert(results.end(), query_count, "<not found>");
+                ++count;
+                continue;
+            }
+
+            pkgconfig pc(packages[p], backend);
+            for (int i = 0; i < query_count; ++i)
+            {
+                try { results.push_back(query(pc, i)); }
+                catch(not_found) { results.push_back("<not found>"); }
+            }
+            count += query_count + 2;
+        }
+        duration = timer.elapsed();
+        return results;
+    }
+
+    /** Runs the queries of run() with a pkgconfig_batch */
+    std::vector<string> run_batch(std::vector<string> const& packages, double& duration, long& count, size_t& processes)
+    {
+        benchmark::timer timer;
+        pkgconfig_batch batch;
+        std::vector<size_t> queries;
+        for (size_t p = 0; p < packages.size(); ++p)
+        {
+            string const& name = packages[p];
+            queries.push_back(batch.add(name, pkgconfig_batch::Exists));
+            queries.push_back(batch.add(name, pkgconfig_batch::Version));
+            queries.push_back(batch.variable(name, "prefix"));
+            for (int mode = pkgconfig::All; mode <= pkgconfig::Other; ++mode)
+                queries.push_back(batch.add(name, pkgconfig_batch::Compiler, pkgconfig::Modes(mode)));
+            for (int mode = pkgconfig::All; mode <= pkgconfig::Libraries; ++mode)
+                queries.push_back(batch.add(name, pkgconfig_batch::Linker, pkgconfig::Modes(mode)));
+        }
+        batch.run();
+        duration = timer.elapsed();
+        count += queries.size();
+        processes = batch.process_count();
+
+        std::vector<string> results;
+        for (size_t i = 0; i < queries.size(); i += query_count + 1)
+        {
+            for (int q = 1; q <= query_count; ++q)
+            {
+                // get() returns an empty string for unknown variables
+                if (!batch.found(queries[i]) || (!batch.found(queries[i + q]) && q != 2))
+                    results.push_back("<not found>");
+                else
+                    results.push_back(batch.result(queries[i + q]));
+            }
+        }
+        return results;
+    }
+
+    int compare(std::vector<string> const& packages, std::vector<string> const& expected,
+            std::vector<string> const& results, char const* name)
+    {
+        int mismatches = 0;
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            if (expected[i] == results[i])
+                continue;
+            ++mismatches;
+            std::cout << "mismatch for " << packages[i / query_count] << " " << query_names[i % query_count] << "\n"
+                << "  pkg-config: " << expected[i] << "\n"
+                << "  " << name << ": " << results[i] << std::endl;
+        }
+        return mismatches;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<string> packages(argv + 1, argv + argc);
+    if (packages.empty())
+    {
+        std::list<string> all = pkgconfig::packages();
+        packages.assign(all.begin(), all.end());
+    }
+
+    double external_time, native_time, cached_time;
+    long external_count = 0, native_count = 0, cached_count = 0;
+    std::vector<string> external = run(packages, pkgconfig::External, external_time, external_count);
+    std::vector<string> native   = run(packages, pkgconfig::Native, native_time, native_count);
+    run(packages, pkgconfig::Native, cached_time, cached_count);
+
+    boost::filesystem::path cache_dir = boost::filesystem::temp_directory_path()
+        / boost::filesystem::unique_path("utilmm-bench-%%%%-%%%%");
+    setenv("UTILMM_CONFIG_CACHE", cache_dir.string().c_str(), 1);
+    double batch_time, batch_cached_time;
+    long batch_count = 0, batch_cached_count = 0;
+    size_t batch_processes, batch_cached_processes;
+    std::vector<string> batch = run_batch(packages, batch_time, batch_count, batch_processes);
+    std::vector<string> batch_cached = run_batch(packages, batch_cached_time, batch_cached_count, batch_cached_processes);
+    boost::filesystem::remove_all(cache_dir);
+
+    std::cout << packages.size() << " packages" << std::endl;
+    benchmark::report("pkg-config program, per query", external_time, external_count);
+    benchmark::report("native parser, per query", native_time, native_count);
+    benchmark::report("native parser, cached, per query", cached_time, cached_count);
+    benchmark::report("pkgconfig_batch, per query", batch_time, batch_count);
+    benchmark::report("pkgconfig_batch, result cache, per query", batch_cached_time, batch_cached_count);
+    std::cout << "pkgconfig_batch ran pkg-config " << batch_processes << " times, then "
+        << batch_cached_processes << " times" << std::endl;
+
+    int mismatches = compare(packages, external, native, "native    ")
+        + compare(packages, external, batch, "batch     ")
+        + compare(packages, external, batch_cached, "cached    ");
+    std::cout << mismatches << " mismatches" << std::endl;
+    return mismatches != 0;
+}
@@ -0,0 +1,83 @@
+/* Cost of plugin_factory::create() in a loop.
+ *
+ * The "dlopen per create" line reproduces what dll::get() used to do
+ * on each call for comparison: dlopen and dlsym, and dlclose once the
+ * product is gone. As nothing else holds the library, it gets loaded
+ * and unloaded on every iteration. The "map lookup per create" line
+ * is the lookup plugin_factory did before caching resolved factories:
+ * the symbol, the exported class map and the any_cast on each call.
+ */
+#include "benchmark.hh"
+#include "bench_plugin.hh"
+#include <utilmm/plugin/plugin_factory.hh>
+#include <boost/lexical_cast.hpp>
+#include <dlfcn.h>
+#include <cstdlib>
+
+using namespace utilmm::plugin;
+
+namespace
+{
+    typedef std::map<std::string, boost::any>& (*list_function)();
+
+    bench_plugin_base* create_reopening(std::string const& path, void*& handle)
+    {
+        handle = dlopen(path.c_str(), RTLD_LAZY | RTLD_GLOBAL);
+        list_function list = (list_function)dlsym(handle, "boost_exported_plugins_list");
+        abstract_factory<bench_plugin_base>* f =
+            boost::any_cast<abstract_factory<bench_plugin_base>*>((*list)()["bench"]);
+        return f->create(dll_handle());
+    }
+
+    bench_plugin_base* create_uncached(dll const& module)
+    {
+        dll_handle list = module.get<list_function>("boost_exported_plugins_list");
+        std::map<std::string, boost::any>& e = (*list)();
+        std::map<std::string, boost::any>::iterator it = e.find("bench");
+        abstract_factory<bench_plugin_base>* f =
+            *boost::any_cast<abstract_factory<bench_plugin_base>*>(&it->second);
+        return f->create(list);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string const path = BENCH_PLUGIN_MODULE;
+    long const count = argc > 1 ? boost::lexical_cast<long>(argv[1]) : 100000;
+
+    long const reopen_count = count / 100 + 1;
+    benchmark::timer timer;
+    for (long i = 0; i < reopen_count; ++i)
+    {
+        void* handle;
+        bench_plugin_base* obj = create_reopening(path, handle);
+        benchmark::use(obj->value());
+        delete obj;
+        dlclose(handle);
+    }
+    benchmark::report("dlopen per create", timer.elapsed(), reopen_count);
+
+    dll module(path);
+    plugin_factory<bench_plugin_base> factory(module);
+    // Warm up: loads the library
+    delete factory.create("bench");
+
+    timer.reset();
+    for (long i = 0; i < count; ++i)
+    {
+        bench_plugin_base* obj = create_uncached(module);
+        benchmark::use(obj->value());
+        delete obj;
+    }
+    benchmark::report("map lookup per create", timer.elapsed(), count);
+
+    timer.reset();
+    for (long i = 0; i < count; ++i)
+    {
+        bench_plugin_base* obj = factory.create("bench");
+        benchmark::use(obj->value());
+        delete obj;
+    }
+    benchmark::report("plugin_factory::create", timer.elapsed(), count);
+    return 0;
+}
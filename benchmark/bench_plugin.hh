@@ -0,0 +1,10 @@
+#ifndef UTILMM_BENCH_PLUGIN_HH
+#define UTILMM_BENCH_PLUGIN_HH
+
+struct bench_plugin_base
+{
+    virtual ~bench_plugin_base() {}
+    virtual int value() const = 0;
+};
+
+#endif
@@ -0,0 +1,15 @@
+#include "bench_plugin.hh"
+#include <utilmm/plugin/export_plugin.hh>
+
+namespace
+{
+    struct bench_plugin : public bench_plugin_base
+    { int value() const { return 42; } };
+}
+
+#ifndef BENCH_PLUGIN_CLASS
+# define BENCH_PLUGIN_CLASS "bench"
+#endif
+
+BOOST_EXPORT_PLUGIN(bench_plugin_base, bench_plugin, BENCH_PLUGIN_CLASS)
+BOOST_EXPORT_PLUGIN_LIST()
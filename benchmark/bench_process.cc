@@ -0,0 +1,179 @@
+/* Latency of process::start() + wait() with the Fork and Spawn
+ * launchers, depending on the memory used by the parent.
+ *
+ * The parent allocates and touches the given amount of memory, then
+ * runs /bin/true repeatedly. fork() copies the page tables of the
+ * parent, while posix_spawn() does not. The same commands are also run
+ * by a process_pool created before the allocations, sequentially and
+ * with all the jobs queued at once.
+ *
+ * On Linux, it also measures the cost of checking running() on a set
+ * of sleeping children, with and without a process_manager, the cost
+ * of process::sample_usage(), and the
+ * time needed to capture the output of children writing 1 MB each.
+ */
+#include "benchmark.hh"
+#include <utilmm/system/process.hh>
+#include <utilmm/system/process_pool.hh>
+#ifdef __linux__
+#include <utilmm/system/process_manager.hh>
+#endif
+#include <boost/lexical_cast.hpp>
+#include <vector>
+#include <string.h>
+
+using namespace utilmm;
+using std::string;
+
+namespace
+{
+    void run(string const& name, process::Launcher launcher, long count)
+    {
+        benchmark::timer timer;
+        for (long i = 0; i < count; ++i)
+        {
+            process prs;
+            prs.set_launcher(launcher);
+            prs << "/bin/true";
+            prs.start();
+            prs.wait();
+        }
+        benchmark::report(name, timer.elapsed(), count);
+    }
+
+    void run_pool(string const& name, process_pool& pool, long count)
+    {
+        benchmark::timer timer;
+        for (long i = 0; i < count; ++i)
+        {
+            process prs;
+            prs << "/bin/true";
+            pool.run(prs);
+        }
+        benchmark::report(name + ", run()", timer.elapsed(), count);
+
+        timer.reset();
+        for (long i = 0; i < count; ++i)
+        {
+            boost::shared_ptr<process> prs(new process);
+            *prs << "/bin/true";
+            pool.submit(prs);
+        }
+        pool.wait_all();
+        benchmark::report(name + ", submit()", timer.elapsed(), count);
+    }
+
+    /** Calls running() \c count times on each of \c children */
+    template<typename Ptr>
+    void sweep(string const& name, std::vector<Ptr> const& children, long count)
+    {
+        benchmark::timer timer;
+        for (long i = 0; i < count; ++i)
+        {
+            for (size_t j = 0; j < children.size(); ++j)
+                benchmark::use(children[j]->running());
+        }
+        benchmark::report(name, timer.elapsed(), count * children.size());
+    }
+
+#ifdef __linux__
+    void supervise(size_t child_count, long count)
+    {
+        std::vector< boost::shared_ptr<process> > children;
+        for (size_t i = 0; i < child_count; ++i)
+        {
+            boost::shared_ptr<process> prs(new process);
+            *prs << "sleep" << "60";
+            prs->start();
+            children.push_back(prs);
+        }
+        sweep("running(), waitpid", children, count);
+
+        benchmark::timer timer;
+        resource_usage usage;
+        for (size_t i = 0; i < child_count; ++i)
+            children[i]->sample_usage(usage);
+        benchmark::report("sample_usage()", timer.elapsed(), child_count);
+        for (size_t i = 0; i < child_count; ++i)
+        {
+            children[i]->signal(SIGKILL);
+            children[i]->wait();
+        }
+
+        process_manager manager;
+        children.clear();
+        for (size_t i = 0; i < child_count; ++i)
+        {
+            boost::shared_ptr<process> prs(new process);
+            *prs << "sleep" << "60";
+            manager.start(prs);
+            children.push_back(prs);
+        }
+        sweep("running(), process_manager", children, count);
+        manager.signal_all(SIGKILL);
+        manager.wait_all();
+    }
+
+    void capture(size_t child_count)
+    {
+        benchmark::timer timer;
+        for (size_t i = 0; i < child_count; ++i)
+        {
+            process prs;
+            prs << "head" << "-c" << "1000000" << "/dev/zero";
+            prs.capture(process::Stdout);
+            prs.start();
+            prs.communicate();
+            prs.wait();
+            benchmark::use(prs.output(process::Stdout).size());
+        }
+        benchmark::report("capture 1 MB, communicate()", timer.elapsed(), child_count);
+
+        timer.reset();
+        { process_manager manager;
+            for (size_t i = 0; i < child_count; ++i)
+            {
+                boost::shared_ptr<process> prs(new process);
+                *prs << "head" << "-c" << "1000000" << "/dev/zero";
+                prs->capture(process::Stdout);
+                manager.start(prs);
+            }
+            manager.wait_all();
+        }
+        benchmark::report("capture 1 MB, process_manager", timer.elapsed(), child_count);
+    }
+#endif
+}
+
+int main()
+{
+    long const count = 200;
+    size_t const sizes[] = { 0, 256, 1024, 2048 };
+
+#ifdef __linux__
+    supervise(100, 1000);
+    capture(50);
+#endif
+
+    process_pool pool;
+    std::vector<char*> memory;
+    size_t allocated = 0;
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        for (; allocated < sizes[i]; ++allocated)
+        {
+            char* block = new char[1 << 20];
+            memset(block, 1, 1 << 20);
+            memory.push_back(block);
+        }
+
+        string rss = boost::lexical_cast<string>(sizes[i]) + " MB";
+        run("fork, parent RSS + " + rss, process::Fork, count);
+        run("posix_spawn, parent RSS + " + rss, process::Spawn, count);
+        run_pool("pool, parent RSS + " + rss, pool, count);
+    }
+
+    for (size_t i = 0; i < memory.size(); ++i)
+        delete[] memory[i];
+    return 0;
+}
@@ -0,0 +1,241 @@
+/* Echo round trips over many connections, dispatched by a reactor or by
+ * sweeping the sockets with try_wait().
+ *
+ * A server and its clients live in the same thread. Each client sends a
+ * 64 byte message, waits for the server to echo it back, and starts
+ * over until it did the given number of round trips. The active
+ * clients are in flight at the same time, the others stay idle. The
+ * reactor gets the ready sockets from epoll, while the sweep calls
+ * try_wait() on every socket, as a program had to before reactor
+ * existed. Both run over Unix and TCP sockets, with 100 and 1000
+ * connections which are all active, and with 1000 connections of
+ * which 10 are active.
+ */
+#include "benchmark.hh"
+#include <utilmm/system/reactor.hh>
+#include <utilmm/system/socket.hh>
+#include <utilmm/system/system.hh>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+#include <algorithm>
+#include <vector>
+#include <errno.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+using namespace utilmm;
+using std::string;
+
+namespace
+{
+    std::size_t const message_size = 64;
+    typedef boost::shared_ptr<utilmm::socket> socket_ptr;
+
+    /** The connections between the clients and the server */
+    struct connections
+    {
+        connections(base_socket::Domain domain, std::size_t count);
+        ~connections();
+
+        base_socket::Domain domain;
+        std::string path;
+        boost::shared_ptr<server_socket> server;
+        std::vector<socket_ptr> clients;
+        std::vector<socket_ptr> accepted;
+
+        void accept_all()
+        {
+            while (utilmm::socket* s = server->accept())
+                accepted.push_back(socket_ptr(s));
+        }
+    };
+
+    connections::connections(base_socket::Domain domain, std::size_t count)
+        : domain(domain)
+    {
+        std::string address;
+        if (domain == base_socket::Unix)
+        {
+            path = "/tmp/utilmm_bench_reactor_" + boost::lexical_cast<string>(getpid());
+            unlink(path.c_str());
+            server.reset(new server_socket(domain, base_socket::Stream, path, 1024));
+            address = path;
+        }
+        else
+        {
+            server.reset(new server_socket(domain, base_socket::Stream, "127.0.0.1:0", 1024));
+            sockaddr_in addr;
+            socklen_t size = sizeof(addr);
+            getsockname(server->fd(), reinterpret_cast<sockaddr*>(&addr), &size);
+            address = "127.0.0.1:" + boost::lexical_cast<string>(ntohs(addr.sin_port));
+        }
+        server->set_nonblocking(true);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            socket_ptr client(new utilmm::socket(domain, base_socket::Stream));
+            client->set_nonblocking(true);
+            while (true)
+            {
+                try
+                {
+                    client->connect(address);
+                    break;
+                }
+                catch(unix_error const& e)
+                {
+                    // The backlog of the server is full
+                    if (e.error() != EAGAIN)
+                        throw;
+                    accept_all();
+                }
+            }
+            clients.push_back(client);
+            accept_all();
+        }
+        while (accepted.size() < count)
+        {
+            server->wait();
+            accept_all();
+        }
+        for (std::size_t i = 0; i < count; ++i)
+            clients[i]->wait(base_socket::WaitWrite);
+    }
+
+    connections::~connections()
+    {
+        if (!path.empty())
+            unlink(path.c_str());
+    }
+
+    /** The state of the round trips, shared by both dispatchers */
+    struct echo_state
+    {
+        echo_state(std::size_t max_fd, long round_trips, long count)
+            : remaining(max_fd, round_trips), received(max_fd, 0)
+            , pending(round_trips * count)
+        { memset(message, 'x', message_size); }
+
+        char message[message_size];
+        /** Round trips left and bytes of the current reply, by client fd */
+        std::vector<long> remaining;
+        std::vector<std::size_t> received;
+        long pending;
+
+        void echo(utilmm::socket& s)
+        {
+            char buffer[4096];
+            int count;
+            while ((count = s.read(buffer, sizeof(buffer))) > 0)
+                s.write(buffer, count);
+        }
+
+        void reply(utilmm::socket& s)
+        {
+            int fd = s.fd();
+            char buffer[4096];
+            int count;
+            while ((count = s.read(buffer, sizeof(buffer))) > 0)
+            {
+                received[fd] += count;
+                while (received[fd] >= message_size)
+                {
+                    received[fd] -= message_size;
+                    --pending;
+                    if (--remaining[fd] > 0)
+                        s.write(message, message_size);
+                }
+            }
+        }
+    };
+
+    std::size_t max_fd(connections const& c)
+    {
+        int result = c.server->fd();
+        for (std::size_t i = 0; i < c.clients.size(); ++i)
+            result = std::max(result, std::max(c.clients[i]->fd(), c.accepted[i]->fd()));
+        return result + 1;
+    }
+
+    void on_echo(echo_state& state, utilmm::socket* s, int) { state.echo(*s); }
+    void on_reply(echo_state& state, utilmm::socket* s, int) { state.reply(*s); }
+
+    void run_reactor(string const& name, connections& c, std::size_t active, long round_trips)
+    {
+        echo_state state(max_fd(c), round_trips, active);
+        reactor loop;
+        for (std::size_t i = 0; i < c.clients.size(); ++i)
+        {
+            loop.add(*c.accepted[i], reactor::Read, boost::bind(on_echo, boost::ref(state), c.accepted[i].get(), _2));
+            loop.add(*c.clients[i], reactor::Read, boost::bind(on_reply, boost::ref(state), c.clients[i].get(), _2));
+        }
+
+        long total = state.pending;
+        benchmark::timer timer;
+        for (std::size_t i = 0; i < active; ++i)
+            c.clients[i]->write(state.message, message_size);
+        while (state.pending > 0)
+            loop.run_once();
+        benchmark::report(name + ", reactor", timer.elapsed(), total);
+    }
+
+    void run_sweep(string const& name, connections& c, std::size_t active, long round_trips)
+    {
+        echo_state state(max_fd(c), round_trips, active);
+
+        long total = state.pending;
+        benchmark::timer timer;
+        for (std::size_t i = 0; i < active; ++i)
+            c.clients[i]->write(state.message, message_size);
+        while (state.pending > 0)
+        {
+            for (std::size_t i = 0; i < c.accepted.size(); ++i)
+            {
+                if (c.accepted[i]->try_wait(base_socket::WaitRead))
+                    state.echo(*c.accepted[i]);
+            }
+            for (std::size_t i = 0; i < c.clients.size(); ++i)
+            {
+                if (c.clients[i]->try_wait(base_socket::WaitRead))
+                    state.reply(*c.clients[i]);
+            }
+        }
+        benchmark::report(name + ", try_wait() sweep", timer.elapsed(), total);
+    }
+}
+
+int main()
+{
+    // Each connection needs two descriptors
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < 4096 && limit.rlim_max >= 4096)
+    {
+        limit.rlim_cur = 4096;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    std::size_t const counts[] = { 100, 1000, 1000 };
+    std::size_t const active[] = { 100, 1000, 10 };
+    long const round_trips = 100;
+    for (int domain = 0; domain < 2; ++domain)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            base_socket::Domain d = domain ? base_socket::Inet : base_socket::Unix;
+            string name = string(domain ? "tcp" : "unix") + ", "
+                + boost::lexical_cast<string>(counts[i]) + " connections";
+            if (active[i] != counts[i])
+                name += ", " + boost::lexical_cast<string>(active[i]) + " active";
+
+            connections c(d, counts[i]);
+            run_sweep(name, c, active[i], round_trips);
+            run_reactor(name, c, active[i], round_trips);
+        }
+    }
+    return 0;
+}
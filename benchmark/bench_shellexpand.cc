@@ -0,0 +1,79 @@
+/* Cost of shell_expand on a typical configuration value.
+ *
+ * "regex" is the previous implementation: repeated regex_search, output
+ * through an ostringstream and getenv() for each variable.
+ */
+#include "benchmark.hh"
+#include <utilmm/configfile/shell_expand.hh>
+#include <boost/lexical_cast.hpp>
+#include <boost/regex.hpp>
+#include <iterator>
+#include <sstream>
+#include <stdlib.h>
+
+using namespace utilmm;
+using std::string;
+
+namespace
+{
+    string regex_shell_expand(string const& text)
+    {
+        static boost::regex const rx_shellvalue("\\$(\\w+)");
+
+        boost::smatch result;
+        if (! regex_search(text, result, rx_shellvalue))
+            return text;
+
+        string::const_iterator last_match;
+        string::const_iterator const end = text.end();
+
+        std::ostringstream expanded;
+        do
+        {
+            expanded << result.prefix();
+            char const* env_value = getenv(string(result[1]).c_str());
+            if (env_value)
+                expanded << env_value;
+            last_match = result.suffix().first;
+        } while(regex_search(last_match, end, result, rx_shellvalue));
+
+        std::copy(last_match, end, std::ostream_iterator<char>(expanded));
+        return expanded.str();
+    }
+
+    template<typename Expand>
+    void run(string const& name, string const& text, Expand expand, long count)
+    {
+        benchmark::timer timer;
+        for (long i = 0; i < count; ++i)
+            benchmark::use(expand(text));
+        benchmark::report(name, timer.elapsed(), count);
+    }
+
+    struct snapshot_expand
+    {
+        environment const& env;
+        explicit snapshot_expand(environment const& env) : env(env) {}
+        string operator()(string const& text) const { return shell_expand(text, env); }
+    };
+}
+
+int main(int argc, char** argv)
+{
+    long const count = argc > 1 ? boost::lexical_cast<long>(argv[1]) : 500000;
+
+    setenv("BENCH_PREFIX", "/opt/robots", 1);
+    setenv("BENCH_PROJECT", "navigation", 1);
+    environment env = environment::capture();
+
+    string const plain = "/usr/share/config/without/any/variable";
+    string const text = "$BENCH_PREFIX/share/$BENCH_PROJECT/config:$BENCH_PREFIX/lib";
+
+    string (*getenv_expand)(string const&) = &shell_expand;
+    run("regex, no variable", plain, &regex_shell_expand, count);
+    run("scanner, no variable", plain, getenv_expand, count);
+    run("regex, 3 variables", text, &regex_shell_expand, count);
+    run("scanner + getenv, 3 variables", text, getenv_expand, count);
+    run("scanner + environment, 3 variables", text, snapshot_expand(env), count);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef UTILMM_BENCHMARK_HH
+#define UTILMM_BENCHMARK_HH
+
+#include <time.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+/** Small helpers shared by the benchmark programs */
+namespace benchmark
+{
+    /** Monotonic wall-clock time in seconds */
+    inline double now()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    /** Measures the time elapsed since construction or the last reset() */
+    class timer
+    {
+        double m_start;
+
+    public:
+        timer() : m_start(now()) {}
+        void reset() { m_start = now(); }
+        double elapsed() const { return now() - m_start; }
+    };
+
+    /** Prints one result line: total time and time per iteration */
+    inline void report(std::string const& name, double seconds, long iterations)
+    {
+        std::cout << std::left << std::setw(40) << name << std::right
+            << std::setw(12) << std::fixed << std::setprecision(3) << seconds * 1e3 << " ms"
+            << std::setw(14) << std::setprecision(1) << seconds * 1e9 / iterations << " ns/iter"
+            << std::endl;
+    }
+
+    /** Keeps the compiler from optimizing away a computed value */
+    template<typename T>
+    inline void use(T const& value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+}
+
+#endif
@@ -153,16 +153,29 @@ namespace utilmm
     {
         for(char const** opt = options; *opt; ++opt)
             m_options.push_back(cmdline_option(*opt));
+        build_index();
     }
 
     command_line::command_line(const std::list<std::string>& description)
     {
         for(list<string>::const_iterator it = description.begin(); it != description.end(); ++it)
             m_options.push_back(cmdline_option(*it));
+        build_index();
     }
             
     command_line::~command_line() { }
 
+    void command_line::build_index()
+    {
+	// If two options have the same name, the first one is used
+	for (size_t i = 0; i < m_options.size(); ++i)
+	{
+	    if (!m_options[i].getShort().empty())
+		m_short_options.insert(make_pair(m_options[i].getShort(), i));
+	    m_long_options.insert(make_pair(m_options[i].getLong(), i));
+	}
+    }
+
     void command_line::add_argument(config_set& config, cmdline_option const& optdesc, std::string const& value)
     { 
 	if (! optdesc.checkArgument(value))
@@ -174,10 +187,17 @@ namespace utilmm
             config.set(optdesc.getConfigKey(), value);
     }
 
-    int command_line::option_match(config_set& config, cmdline_option const& opt, int argc, char const* const* argv, int i)
+    int command_line::option_match(config_set& config, int argc, char const* const* argv, int i)
     {
-	if (argv[i] == "-" + opt.getShort())
+	boost::string_view arg(argv[i]);
+	if (arg.size() == 2)
 	{
+	    // -x
+	    OptionIndex::const_iterator it = m_short_options.find(arg.substr(1), name_hash(), name_equal());
+	    if (it == m_short_options.end())
+		return i;
+	    cmdline_option const& opt = m_options[it->second];
+
 	    // check if it looks like we have an argument
 	    bool has_argument = (i + 1 < argc && argv[i + 1][0] != '-');
 
@@ -190,24 +210,33 @@ namespace utilmm
 	    }
 	    else
 		throw commandline_error("missing argument to -" + opt.getShort());
+	    return i + 1;
 	}
-	else if (argv[i] == "--" + opt.getLong())
-	{
-	    if (opt.hasArgument() && !opt.isArgumentOptional())
-		throw commandline_error("missing argument to --" + opt.getLong());
-
-	    add_argument(config, opt, opt.getDefaultValue());
-	}
-	else if (starts_with(argv[i], "--" + opt.getLong() + "="))
+	else if (arg.size() > 2 && arg[1] == '-')
 	{
-	    if (!opt.hasArgument())
-		throw commandline_error("argument provided to --" + opt.getLong());
-
-	    int seed_size = opt.getLong().length() + 3;
-	    add_argument(config, opt, std::string(argv[i]).substr(seed_size));
+	    // --long or --long=value
+	    size_t value_start = arg.find('=');
+	    boost::string_view name = arg.substr(2, value_start == boost::string_view::npos ? boost::string_view::npos : value_start - 2);
+	    OptionIndex::const_iterator it = m_long_options.find(name, name_hash(), name_equal());
+	    if (it == m_long_options.end())
+		return i;
+	    cmdline_option const& opt = m_options[it->second];
+
+	    if (value_start == boost::string_view::npos)
+	    {
+		if (opt.hasArgument() && !opt.isArgumentOptional())
+		    throw commandline_error("missing argument to --" + opt.getLong());
+		add_argument(config, opt, opt.getDefaultValue());
+	    }
+	    else
+	    {
+		if (!opt.hasArgument())
+		    throw commandline_error("argument provided to --" + opt.getLong());
+		add_argument(config, opt, std::string(argv[i] + value_start + 1));
+	    }
+	    return i + 1;
 	}
-	else return i;
-	return i + 1;
+	return i;
     }
 
     void command_line::parse(int argc, char const* const argv[], config_set& config)
@@ -224,19 +253,10 @@ namespace utilmm
 		continue;
 	    }
 
-            // Get the option description object (if this is an option)
-	    Options::iterator opt;
-            for (opt = m_options.begin(); opt != m_options.end(); ++opt)
-	    {
-		int new_index = option_match(config, *opt, argc, argv, i);
-		if (new_index != i) 
-		{
-		    i = new_index;
-		    break;
-		}
-	    }
-	    if (opt == m_options.end())
+	    int new_index = option_match(config, argc, argv, i);
+	    if (new_index == i)
 		throw commandline_error("unknown argument " + string(argv[i]));
+	    i = new_index;
         }
 
 	// Set default values for options that have one
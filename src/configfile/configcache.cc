@@ -0,0 +1,410 @@
+#include "utilmm/configfile/configfile.hh"
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <iomanip>
+
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::string;
+using boost::uint32_t;
+using boost::uint64_t;
+using namespace utilmm;
+
+/* Layout of the compiled files. All integers are in the native byte
+ * order, and the cache is never shared between machines.
+ *
+ *   header
+ *   source path, padded to 8 bytes
+ *   node table: node_count node_record, the root first. A node comes
+ *     after its parent
+ *   value table: value_count value_record
+ *   child table: child_count child_record
+ *   string table: string_size bytes. Each string appears once
+ */
+namespace
+{
+    char const cache_magic[8] = { 'u', 't', 'i', 'l', 'm', 'm', 'c', 'f' };
+    uint32_t const cache_version = 1;
+
+    struct cache_header
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t path_size;
+        uint64_t mtime_sec;
+        uint64_t mtime_nsec;
+        uint64_t source_size;
+        uint32_t node_count;
+        uint32_t value_count;
+        uint32_t child_count;
+        uint32_t string_size;
+    };
+
+    /** The values and children of a node are ranges in the value and
+     * child tables */
+    struct node_record
+    {
+        uint32_t first_value;
+        uint32_t value_count;
+        uint32_t first_child;
+        uint32_t child_count;
+    };
+
+    struct string_record
+    {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    struct value_record
+    {
+        string_record key;
+        string_record value;
+    };
+
+    struct child_record
+    {
+        string_record key;
+        uint32_t node;
+        uint32_t padding;
+    };
+
+    uint64_t padded(uint64_t size) { return (size + 7) & ~uint64_t(7); }
+
+    struct view_hash
+    {
+        std::size_t operator()(boost::string_view value) const
+        { return boost::hash_range(value.begin(), value.end()); }
+    };
+
+    /** Builds the string table, storing each string once */
+    class string_table
+    {
+        typedef boost::unordered_map<boost::string_view, uint32_t, view_hash> index_t;
+        index_t m_index;
+        string  m_data;
+
+    public:
+        void reserve(std::size_t count) { m_index.reserve(count); }
+
+        string_record add(boost::string_view value)
+        {
+            string_record record;
+            record.size = value.size();
+
+            index_t::const_iterator it = m_index.find(value);
+            if (it != m_index.end())
+                record.offset = it->second;
+            else
+            {
+                if (m_data.size() + value.size() > 0xFFFFFFFFULL)
+                    throw std::runtime_error("configuration too big to be compiled");
+                record.offset = m_data.size();
+                m_data.append(value.data(), value.size());
+                // The tree outlives the string table, so the views in the
+                // index remain valid
+                m_index.insert(std::make_pair(value, record.offset));
+            }
+            return record;
+        }
+
+        string const& data() const { return m_data; }
+    };
+
+    template<typename T>
+    void write(std::ofstream& out, T const* data, std::size_t count)
+    { out.write(reinterpret_cast<char const*>(data), sizeof(T) * count); }
+
+    string getenv_string(char const* name)
+    {
+        char const* value = getenv(name);
+        return value ? string(value) : string();
+    }
+
+    /** 64-bit FNV-1a */
+    uint64_t hash_path(string const& path)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (string::const_iterator it = path.begin(); it != path.end(); ++it)
+        {
+            hash ^= static_cast<unsigned char>(*it);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+}
+
+bool config_file::get_source_info(const std::string& name, source_info& info)
+{
+    struct stat file_stat;
+    if (stat(name.c_str(), &file_stat) == -1)
+        return false;
+
+    boost::filesystem::path path = boost::filesystem::absolute(name);
+    info.path       = path.lexically_normal().string();
+    info.mtime_sec  = file_stat.st_mtim.tv_sec;
+    info.mtime_nsec = file_stat.st_mtim.tv_nsec;
+    info.size       = file_stat.st_size;
+    info.known      = true;
+    return true;
+}
+
+std::string config_file::cache_directory()
+{
+    boost::filesystem::path dir = getenv_string("UTILMM_CONFIG_CACHE");
+    if (! dir.empty())
+        return dir.string();
+
+    // Relative directories would put the caches in the current directory
+    boost::filesystem::path xdg_cache = getenv_string("XDG_CACHE_HOME");
+    if (xdg_cache.is_absolute())
+        return (xdg_cache / "utilmm").string();
+
+    boost::filesystem::path home = getenv_string("HOME");
+    if (home.empty())
+    {
+        if (passwd const* entry = getpwuid(getuid()))
+            home = entry->pw_dir;
+    }
+    if (home.is_absolute())
+        return (home / ".cache" / "utilmm").string();
+    return string();
+}
+
+std::string config_file::cache_path(const std::string& source)
+{
+    boost::filesystem::path dir = cache_directory();
+    if (dir.empty())
+        return string();
+    string absolute = boost::filesystem::absolute(source).lexically_normal().string();
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash_path(absolute) << ".cfgc";
+    return (dir / name.str()).string();
+}
+
+void config_file::compile(const std::string& path) const
+{
+    // Files not loaded in Cached mode are only looked at now
+    source_info source = m_source;
+    if (! source.known && ! get_source_info(m_source.path, source))
+        throw std::runtime_error("cannot get the status of " + m_source.path);
+
+    // List the nodes breadth-first, so that children come after their
+    // parent
+    std::deque<config_set const*> sets;
+    sets.push_back(this);
+    std::size_t value_count = 0, child_count = 0;
+    for (std::size_t i = 0; i < sets.size(); ++i)
+    {
+        value_count += sets[i]->m_values.size();
+        child_count += sets[i]->m_children.size();
+        for (ChildMap::const_iterator it = sets[i]->m_children.begin(); it != sets[i]->m_children.end(); ++it)
+            sets.push_back(it->second);
+    }
+
+    std::vector<node_record>  nodes;
+    std::vector<value_record> values;
+    std::vector<child_record> children;
+    nodes.reserve(sets.size());
+    values.reserve(value_count);
+    children.reserve(child_count);
+    string_table strings;
+    strings.reserve(2 * value_count + child_count);
+    std::size_t next_node = 1;
+    for (std::size_t i = 0; i < sets.size(); ++i)
+    {
+        config_set const& set = *sets[i];
+        node_record node;
+        node.first_value = values.size();
+        node.value_count = set.m_values.size();
+        node.first_child = children.size();
+        node.child_count = set.m_children.size();
+        nodes.push_back(node);
+
+        for (ValueMap::const_iterator it = set.m_values.begin(); it != set.m_values.end(); ++it)
+        {
+            value_record value;
+            value.key   = strings.add(it->first.view());
+            value.value = strings.add(it->second.view());
+            values.push_back(value);
+        }
+        for (ChildMap::const_iterator it = set.m_children.begin(); it != set.m_children.end(); ++it)
+        {
+            child_record child;
+            child.key     = strings.add(it->first.view());
+            child.node    = next_node++;
+            child.padding = 0;
+            children.push_back(child);
+        }
+    }
+
+    cache_header header;
+    memcpy(header.magic, cache_magic, sizeof(header.magic));
+    header.version     = cache_version;
+    header.path_size   = source.path.size();
+    header.mtime_sec   = source.mtime_sec;
+    header.mtime_nsec  = source.mtime_nsec;
+    header.source_size = source.size;
+    header.node_count  = nodes.size();
+    header.value_count = values.size();
+    header.child_count = children.size();
+    header.string_size = strings.data().size();
+
+    // Write in a temporary file and rename it, so that concurrent
+    // processes never see a partial file
+    boost::filesystem::path target(path);
+    if (target.has_parent_path())
+        boost::filesystem::create_directories(target.parent_path());
+
+    std::ostringstream temp_name;
+    temp_name << path << ".tmp." << getpid();
+    string temp = temp_name.str();
+    {
+        std::ofstream out(temp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        char const padding[8] = { 0 };
+        write(out, &header, 1);
+        out.write(source.path.data(), source.path.size());
+        out.write(padding, padded(source.path.size()) - source.path.size());
+        write(out, nodes.empty() ? 0 : &nodes[0], nodes.size());
+        write(out, values.empty() ? 0 : &values[0], values.size());
+        write(out, children.empty() ? 0 : &children[0], children.size());
+        out.write(strings.data().data(), strings.data().size());
+        out.close();
+        if (! out)
+        {
+            unlink(temp.c_str());
+            throw std::runtime_error("cannot write " + path);
+        }
+    }
+
+    if (rename(temp.c_str(), path.c_str()) == -1)
+    {
+        unlink(temp.c_str());
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+bool config_file::load_compiled(const std::string& path)
+{
+    if (! map_file(path))
+        return false;
+
+    char const* const begin = m_mapping;
+
+    cache_header header;
+    if (m_mapping_size < sizeof(header))
+    {
+        unmap();
+        return false;
+    }
+    memcpy(&header, begin, sizeof(header));
+
+    uint64_t const tables = sizeof(header) + padded(header.path_size);
+    uint64_t const expected_size = tables
+        + uint64_t(header.node_count)  * sizeof(node_record)
+        + uint64_t(header.value_count) * sizeof(value_record)
+        + uint64_t(header.child_count) * sizeof(child_record)
+        + header.string_size;
+
+    if (memcmp(header.magic, cache_magic, sizeof(header.magic)) != 0
+            || header.version != cache_version
+            || expected_size != m_mapping_size
+            || header.node_count == 0
+            || header.mtime_sec  != m_source.mtime_sec
+            || header.mtime_nsec != m_source.mtime_nsec
+            || header.source_size != m_source.size
+            || m_source.path != boost::string_view(begin + sizeof(header), header.path_size))
+    {
+        unmap();
+        return false;
+    }
+
+    node_record const*  nodes    = reinterpret_cast<node_record const*>(begin + tables);
+    value_record const* values   = reinterpret_cast<value_record const*>(nodes + header.node_count);
+    child_record const* children = reinterpret_cast<child_record const*>(values + header.value_count);
+    char const* strings          = reinterpret_cast<char const*>(children + header.child_count);
+
+    struct invalid_file {};
+    try
+    {
+        std::vector<config_set*> sets(header.node_count, static_cast<config_set*>(0));
+        sets[0] = this;
+
+        for (uint32_t i = 0; i < header.node_count; ++i)
+        {
+            config_set* set = sets[i];
+            node_record const& node = nodes[i];
+            if (! set
+                    || uint64_t(node.first_value) + node.value_count > header.value_count
+                    || uint64_t(node.first_child) + node.child_count > header.child_count)
+                throw invalid_file();
+
+            set->m_values.reserve(node.value_count);
+            set->m_children.reserve(node.child_count);
+
+            for (uint32_t v = node.first_value; v < node.first_value + node.value_count; ++v)
+            {
+                value_record const& value = values[v];
+                if (uint64_t(value.key.offset) + value.key.size > header.string_size
+                        || uint64_t(value.value.offset) + value.value.size > header.string_size)
+                    throw invalid_file();
+
+                set->append_value(
+                        config_string(boost::string_view(strings + value.key.offset, value.key.size)),
+                        config_string(boost::string_view(strings + value.value.offset, value.value.size)));
+            }
+
+            for (uint32_t c = node.first_child; c < node.first_child + node.child_count; ++c)
+            {
+                child_record const& child = children[c];
+                if (uint64_t(child.key.offset) + child.key.size > header.string_size
+                        || child.node <= i || child.node >= header.node_count
+                        || sets[child.node])
+                    throw invalid_file();
+
+                config_set* new_set = new config_set(set);
+                set->append_child(
+                        config_string(boost::string_view(strings + child.key.offset, child.key.size)),
+                        new_set);
+                sets[child.node] = new_set;
+            }
+        }
+    }
+    catch(invalid_file)
+    {
+        clear();
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+void config_file::load_cached(const std::string& name)
+{
+    clear();
+
+    string cache = cache_path(name);
+    if (cache.empty())
+    {
+        map(name);
+        return;
+    }
+    if (load_compiled(cache))
+        return;
+
+    map(name);
+    try { compile(cache); }
+    catch(std::exception const&) { } // caching is best effort
+}
@@ -1,115 +1,262 @@
 #include "utilmm/configfile/configfile.hh"
 #include "utilmm/configfile/exceptions.hh"
 
-#include <boost/regex.hpp>
-
+#include <algorithm>
 #include <fstream>
-#include <sstream>
+#include <vector>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-using std::fstream;
 using std::string;
-using std::stringbuf;
 using namespace utilmm;
 
-using boost::regex;
-using boost::smatch;
-
 parse_error::parse_error(int line_, std::string const& message_)
     : line(line_), message(message_) {}
 
-config_file::config_file(std::string const& name)
+config_file::config_file(std::string const& name, load_mode mode)
+    : m_mapping(0), m_mapping_size(0)
 {
-    try { read(name); }
+    try 
+    { 
+        m_source.path  = name;
+        m_source.known = false;
+
+        if (mode == Cached)
+        {
+            // Get the file version first: if the file changes while
+            // being read, its cache is out of date anyway
+            if (! get_source_info(name, m_source))
+                throw not_found(name);
+            load_cached(name);
+        }
+        else if (mode == MapFile)
+            map(name);
+        else
+            read(name);
+    }
     catch(...) {
         clear();
+        unmap();
         throw;
     }
 }
+
+config_file::~config_file()
+{
+    // The children refer to the file contents
+    clear();
+    unmap();
+}
     
+namespace
+{
+    bool is_blank(char c) { return c == ' ' || c == '\t'; }
+    bool is_key_char(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+            || (c >= '0' && c <= '9') || c == '_' || c == '-';
+    }
+
+    char const* skip_blanks(char const* it, char const* end)
+    {
+        while (it != end && is_blank(*it))
+            ++it;
+        return it;
+    }
+
+    /** True if [it, end) is only made of blanks and an optional comment */
+    bool is_empty(char const* it, char const* end)
+    {
+        it = skip_blanks(it, end);
+        return it == end || *it == '#';
+    }
+
+    /** True if [it, end) is \c bracket, with optional blanks around it
+     * and an optional comment */
+    bool is_bracket(char const* it, char const* end, char bracket)
+    {
+        it = skip_blanks(it, end);
+        return it != end && *it == bracket && is_empty(it + 1, end);
+    }
+
+    void read_file(std::string const& name, std::vector<char>& buffer)
+    {
+        std::ifstream file(name.c_str(), std::ios::in | std::ios::binary);
+        if (! file.is_open()) 
+            throw not_found(name);
+
+        // Read the file in one go if its size is known, then in chunks
+        // for files whose size is not (pipes, /proc, ...)
+        file.seekg(0, std::ios::end);
+        std::streamoff file_size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        if (!file)
+        {
+            file.clear();
+            file_size = 0;
+        }
+
+        std::size_t chunk_size = file_size > 0 ? file_size : 65536;
+        buffer.clear();
+        while (file && file.peek() != std::ifstream::traits_type::eof())
+        {
+            std::size_t size = buffer.size();
+            buffer.resize(size + chunk_size);
+            file.read(&buffer[size], chunk_size);
+            buffer.resize(size + file.gcount());
+            chunk_size = 65536;
+        }
+    }
+}
+
 void config_file::read(const std::string& name)
 {
     clear();
 
-    fstream file;
-    file.open(name.c_str(), fstream::in);
-    if (! file.is_open()) 
-        throw not_found(name);
+    read_file(name, m_buffer);
+    if (m_buffer.empty())
+        return;
+
+    parse(&m_buffer[0], &m_buffer[0] + m_buffer.size());
+}
+
+void config_file::map(const std::string& name)
+{
+    clear();
+
+    if (! map_file(name))
+    {
+        // Empty files cannot be mapped, and some special files
+        // (pipes, /proc) do not support it
+        read(name);
+        return;
+    }
+
+    madvise(const_cast<char*>(m_mapping), m_mapping_size, MADV_SEQUENTIAL);
+    parse(m_mapping, m_mapping + m_mapping_size);
+}
+
+bool config_file::map_file(const std::string& name)
+{
+    int fd = open(name.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+        void* mapping = mmap(0, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            m_mapping = static_cast<char const*>(mapping);
+            m_mapping_size = file_stat.st_size;
+        }
+    }
+    close(fd);
+    return m_mapping != 0;
+}
+
+void config_file::unmap()
+{
+    if (!m_mapping)
+        return;
 
-    static const string
-        regexp_header("^[[:blank:]]*"),
-        regexp_trail("[[:blank:]]*(?:#.*)?$");
+    munmap(const_cast<char*>(m_mapping), m_mapping_size);
+    m_mapping = 0;
+    m_mapping_size = 0;
+}
 
-    static regex
-        rx_empty(regexp_header + regexp_trail),
-        rx_name(regexp_header + "([[:alnum:]_-]+)([^#]*)" + regexp_trail),
-        rx_attribute(regexp_header + ":[[:blank:]]*([^#]+)" + regexp_trail),
-        rx_open_bracket(regexp_header + "\\{" + regexp_trail),
-        rx_close_bracket(regexp_header + "\\}" + regexp_trail);
+namespace
+{
+    config_string make_string(char const* begin, char const* end)
+    { return config_string(boost::string_view(begin, end - begin)); }
+}
 
+void config_file::parse(char const* buffer, char const* buffer_end)
+{
     enum { Normal, FindBracket } mode;
     mode = Normal;
 
     config_set* cur_set = this;
     
     int line_number = 1;
-    stringbuf linebuf;
-    const string empty_string;
-    while (! file.eof())
+    for (char const* line = buffer; line != buffer_end; ++line_number)
     {
-        while (file.peek() == '\n')
-        {
-            ++line_number;
-            file.ignore();
-        }
-
-        file.get(linebuf);
-        const string line(linebuf.str());
-        linebuf.str(empty_string);
-        
-        smatch result;
-        if (regex_match(line, rx_empty)) continue;
+        char const* line_end = static_cast<char const*>(memchr(line, '\n', buffer_end - line));
+        if (!line_end)
+            line_end = buffer_end;
 
-        if (mode == FindBracket)
+        char const* first = skip_blanks(line, line_end);
+        if (first == line_end || *first == '#')
+        { } // empty line or comment
+        else if (mode == FindBracket)
         {
-            if (! regex_match(line, rx_open_bracket))
-                throw parse_error(line_number, "expected '{', found " + line);
+            if (! is_bracket(first, line_end, '{'))
+                throw parse_error(line_number, "expected '{', found " + string(line, line_end));
 
             mode = Normal;
         }
-        else if (regex_match(line, result, rx_name))
+        else if (is_key_char(*first))
         {
-            string key = result[1];
-            string value = result[2];
+            // The key is followed by either nothing, a bracket, or ':'
+            // and the value. The value ends with the line or at the
+            // first '#' and keeps its trailing blanks.
+            char const* key_end = first;
+            while (key_end != line_end && is_key_char(*key_end))
+                ++key_end;
+            char const* value_end = std::find(key_end, line_end, '#');
+            config_string key = make_string(first, key_end);
 
-            smatch attribute_value;
-
-            if (value.empty() 
-                    || regex_match(value, rx_open_bracket))
+            if (key_end == value_end || is_bracket(key_end, value_end, '{'))
             {
-                mode = value.empty() ? FindBracket : Normal;
+                mode = (key_end == value_end) ? FindBracket : Normal;
 
                 config_set* new_set = new config_set(cur_set);
-                cur_set->insert( key, new_set );
+                cur_set->append_child( key, new_set );
                 cur_set = new_set;
             }
-            else if (regex_match(value, attribute_value, rx_attribute)) 
-                cur_set->insert( key, attribute_value[1] );
             else
-                throw parse_error(line_number, "expected '" + key + ": value', found " + key + value);
+            {
+                char const* colon = skip_blanks(key_end, value_end);
+                char const* attribute = value_end;
+                if (colon != value_end && *colon == ':')
+                {
+                    attribute = skip_blanks(colon + 1, value_end);
+                    // The value is never empty: if there are only blanks
+                    // after ':', it is the last one
+                    if (attribute == value_end && attribute != colon + 1)
+                        --attribute;
+                }
+
+                if (attribute == value_end)
+                    throw parse_error(line_number, "expected '" + key.str() + ": value', found " + string(first, value_end));
+
+                cur_set->append_value( key, make_string(attribute, value_end) );
+            }
         }
-        else if (regex_match(line, rx_close_bracket))
+        else if (is_bracket(first, line_end, '}'))
         {
             if (cur_set -> parent() == 0)
                 throw parse_error(line_number, "unmatched bracket");
+            cur_set->sort();
             cur_set = cur_set->parent();
         }
         else
-            throw parse_error(line_number, "expected \"key: value\", found " + line);
+            throw parse_error(line_number, "expected \"key: value\", found " + string(line, line_end));
+
+        if (line_end == buffer_end)
+            break;
+        line = line_end + 1;
     }
 
     if (mode == FindBracket)
         throw parse_error(line_number, "expected '{', got end of file");
     else if (cur_set -> parent())
         throw parse_error(line_number, "expected '}' before end of file");
+    sort();
 }
 
@@ -5,7 +5,7 @@ using namespace std;
 using namespace utilmm;
 
 config_set::config_set(config_set* parent_)
-    : m_parent(parent_) {}
+    : m_parent(parent_), m_generation(0) {}
 
 config_set::~config_set()
 { 
@@ -16,13 +16,11 @@ bool config_set::empty() const
 { return m_values.empty() && m_children.empty(); }
 void config_set::clear() 
 {
+    ++m_generation;
     m_values.clear();
-    while (!m_children.empty())
-    {
-        ChildMap::iterator it = m_children.begin();
+    for (ChildMap::iterator it = m_children.begin(); it != m_children.end(); ++it)
         delete it->second;
-        m_children.erase(it);
-    }
+    m_children.clear();
 }
     
 const config_set* config_set::parent() const { return m_parent; } 
@@ -31,7 +29,7 @@ list<const config_set*> config_set::children(const std::string& name) const
 {
     typedef list<const config_set *> SetList;
     pair<ChildMap::const_iterator, ChildMap::const_iterator>
-        range = m_children.equal_range(name);
+        range = find_range(m_children, name);
 
     ChildMap::const_iterator
         it = range.first,
@@ -48,21 +46,74 @@ list<const config_set*> config_set::children(const std::string& name) const
 config_set const& config_set::child(std::string const& name) const
 {
     static config_set empty_set;
-    subsets every_child = children(name);
-    if (every_child.empty())
+    config_set const* result = find_child(name);
+    if (!result)
 	return empty_set;
-    return *every_child.front();
+    return *result;
+}
+
+config_set::child_range config_set::children_range(boost::string_view name) const
+{
+    pair<ChildMap::const_iterator, ChildMap::const_iterator>
+        range = find_range(m_children, name);
+    return child_range(child_iterator(range.first), child_iterator(range.second));
+}
+config_set::child_range config_set::children_range() const
+{ return child_range(child_iterator(m_children.begin()), child_iterator(m_children.end())); }
+config_set::value_range config_set::values_range() const
+{ return value_range(m_values.begin(), m_values.end()); }
+
+config_set const* config_set::find_child(boost::string_view name) const
+{
+    ChildMap::const_iterator it =
+        std::lower_bound(m_children.begin(), m_children.end(), name, key_less());
+    if (it == m_children.end() || it->first.view() != name)
+        return 0;
+    return it->second;
+}
+
+config_set const* config_set::lookup(boost::string_view path) const
+{
+    config_set const* current = this;
+    while (current && !path.empty())
+    {
+        boost::string_view::size_type separator = path.find('/');
+        boost::string_view name = path.substr(0, separator);
+        if (!name.empty())
+            current = current->find_child(name);
+
+        if (separator == boost::string_view::npos)
+            break;
+        path.remove_prefix(separator + 1);
+    }
+    return current;
 }
 
 bool config_set::exists(const std::string& name) const
 {
     return 
-        m_values.find(name) != m_values.end()
-        || m_children.find(name) != m_children.end();
+        std::binary_search(m_values.begin(), m_values.end(), boost::string_view(name), key_less())
+        || std::binary_search(m_children.begin(), m_children.end(), boost::string_view(name), key_less());
+}
+
+void config_set::append_value(config_string const& name, config_string const& value)
+{ m_values.push_back( make_pair(name, value) ); }
+void config_set::append_child(config_string const& name, config_set const* child_)
+{ m_children.push_back( make_pair(name, child_) ); }
+void config_set::sort()
+{
+    ++m_generation;
+    std::stable_sort(m_values.begin(), m_values.end(), key_less());
+    std::stable_sort(m_children.begin(), m_children.end(), key_less());
 }
 
 void config_set::insert(std::string const& name, std::string const& value)
-{ m_values.insert( make_pair(name, value) ); }
+{
+    ++m_generation;
+    ValueMap::iterator it = std::upper_bound(m_values.begin(), m_values.end(),
+            boost::string_view(name), key_less());
+    m_values.insert(it, make_pair(config_string(name), config_string(value)));
+}
 void config_set::insert(std::string const& name, std::list<std::string> const& value)
 { 
     list<string>::const_iterator it, end = value.end();
@@ -70,23 +121,32 @@ void config_set::insert(std::string const& name, std::list<std::string> const& v
         insert(name, *it);
 }
 void config_set::insert(std::string const& name, config_set const* child_)
-{ m_children.insert( make_pair(name, child_) ); }
+{
+    ChildMap::iterator it = std::upper_bound(m_children.begin(), m_children.end(),
+            boost::string_view(name), key_less());
+    m_children.insert(it, make_pair(config_string(name), child_));
+}
 void config_set::set(std::string const& name, std::string const& value)
 {
-    m_values.erase(name);
+    erase(name);
     insert(name, value);
 }
 void config_set::set(std::string const& name, std::list<std::string> const& value)
 {
-    m_values.erase(name);
+    erase(name);
     insert(name, value);
 }
 void config_set::erase(std::string const& name)
-{ m_values.erase(name); }
+{
+    ++m_generation;
+    pair<ValueMap::iterator, ValueMap::iterator> range =
+        std::equal_range(m_values.begin(), m_values.end(), boost::string_view(name), key_less());
+    m_values.erase(range.first, range.second);
+}
 
 
 
-template<> bool config_set::convert(const std::string& value)
+template<> bool config_set::convert(boost::string_view value)
 {
     if (value == "true" || value == "1")
         return true;
@@ -96,17 +156,3 @@ template<> bool config_set::convert(const std::string& value)
     throw boost::bad_lexical_cast();
 }
 
-template<>
-config_set::stringlist config_set::get(const std::string& name, stringlist const& defval, 
-        boost::enable_if< details::is_list<config_set::stringlist> >::type* dummy) const
-{
-    list<string> values;
-    for(ValueMap::const_iterator it = m_values.find(name); it != m_values.end() && it->first == name; ++it)
-        values.push_back(it->second);
-
-    if(values.empty())
-        return defval;
-
-    return values;
-}
-
@@ -1,17 +1,1160 @@
 #include <utilmm/system/system.hh>
 #include <utilmm/system/process.hh>
 #include <utilmm/configfile/pkgconfig.hh>
+#include <utilmm/configfile/configfile.hh>
 #include <utilmm/configfile/exceptions.hh>
 #include <utilmm/stringtools.hh>
+#include "utilmm/config/config.h"
+
+#include <boost/bind.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace utilmm;
 using std::string;
 using std::list;
+using std::vector;
+
+/* The native backend follows the behaviour of pkgconf, the pkg-config
+ * implementation of most current distributions, including its quirks:
+ * how Requires lists are tokenized, which flags get merged when they
+ * appear more than once, and how the flags are quoted on output. */
+namespace
+{
+    /** Removes the blanks at both ends of \c output */
+    string strip(string const& output)
+    {
+        string::size_type first = output.find_first_not_of(" \t\n");
+        if (first == string::npos) return string();
+        string::size_type last  = output.find_last_not_of(" \t\n");
+        return string(output, first, last - first + 1);
+    }
+
+    /** The variables which change where and how .pc files are looked
+     * for. The cache of the native backend is flushed when one of them
+     * changes */
+    char const* const environment_variables[] = {
+        "PKG_CONFIG_PATH", "PKG_CONFIG_LIBDIR", "PKG_CONFIG_DISABLE_UNINSTALLED",
+        "PKG_CONFIG_SYSTEM_INCLUDE_PATH", "PKG_CONFIG_SYSTEM_LIBRARY_PATH",
+        "PKG_CONFIG_ALLOW_SYSTEM_CFLAGS", "PKG_CONFIG_ALLOW_SYSTEM_LIBS",
+        "CPATH", "C_INCLUDE_PATH", "CPLUS_INCLUDE_PATH", "OBJC_INCLUDE_PATH",
+        "LIBRARY_PATH", 0 };
+
+    /** Variables the native backend does not implement. If one is set,
+     * the queries go to the pkg-config program */
+    char const* const unsupported_variables[] = {
+        "PKG_CONFIG_SYSROOT_DIR", "PKG_CONFIG_TOP_BUILD_DIR",
+        "PKG_CONFIG_PURE_DEPGRAPH", 0 };
+
+    bool native_supported()
+    {
+        for (char const* const* var = unsupported_variables; *var; ++var)
+            if (getenv(*var))
+                return false;
+        return true;
+    }
+
+    void append_path(vector<string>& result, char const* value)
+    {
+        if (!value)
+            return;
+        stringlist dirs = split(value, ":");
+        result.insert(result.end(), dirs.begin(), dirs.end());
+    }
+
+    struct search_environment
+    {
+        vector<string> search_path;
+        vector<string> system_includes;
+        vector<string> system_libdirs;
+        bool allow_system_cflags;
+        bool allow_system_libs;
+        bool uninstalled;
+
+        search_environment()
+        {
+            append_path(search_path, getenv("PKG_CONFIG_PATH"));
+            char const* libdir = getenv("PKG_CONFIG_LIBDIR");
+            append_path(search_path, libdir ? libdir : UTILMM_PKGCONFIG_PATH);
+
+            char const* includes = getenv("PKG_CONFIG_SYSTEM_INCLUDE_PATH");
+            append_path(system_includes, includes ? includes : UTILMM_PKGCONFIG_SYSTEM_INCLUDE_PATH);
+            append_path(system_includes, getenv("CPATH"));
+            append_path(system_includes, getenv("C_INCLUDE_PATH"));
+            append_path(system_includes, getenv("CPLUS_INCLUDE_PATH"));
+            append_path(system_includes, getenv("OBJC_INCLUDE_PATH"));
+
+            char const* libdirs = getenv("PKG_CONFIG_SYSTEM_LIBRARY_PATH");
+            append_path(system_libdirs, libdirs ? libdirs : UTILMM_PKGCONFIG_SYSTEM_LIBRARY_PATH);
+            append_path(system_libdirs, getenv("LIBRARY_PATH"));
+
+            allow_system_cflags = getenv("PKG_CONFIG_ALLOW_SYSTEM_CFLAGS");
+            allow_system_libs   = getenv("PKG_CONFIG_ALLOW_SYSTEM_LIBS");
+            uninstalled         = !getenv("PKG_CONFIG_DISABLE_UNINSTALLED");
+        }
+    };
+
+    /** One compiler or linker flag. Flags of the form -Xdata have X as
+     * type, the others have a type of 0 and are kept whole in data */
+    struct pc_fragment
+    {
+        pc_fragment(char type, string const& data)
+            : type(type), data(data), merged(false) {}
+
+        char type;
+        string data;
+        /** True for flags which pkgconf glues to their argument, such as
+         * "-framework Foo" */
+        bool merged;
+
+        bool operator == (pc_fragment const& other) const
+        { return type == other.type && data == other.data; }
+    };
+    typedef vector<pc_fragment> fragment_list;
+
+    struct pc_dependency
+    {
+        string name;
+        string op;
+        string version;
+    };
+    typedef vector<pc_dependency> dependency_list;
+
+    struct pc_package
+    {
+        string path;
+        /** The modification time and size of the file when it was read */
+        string stamp;
+        string version;
+        std::map<string, string> variables;
+        fragment_list cflags, cflags_private;
+        fragment_list libs, libs_private;
+        dependency_list requires, requires_private;
+    };
+    typedef boost::shared_ptr<pc_package const> package_ptr;
+
+    /** Splits a .pc file in lines, removing the comments and joining
+     * the lines ending with a backslash */
+    vector<string> read_lines(string const& contents)
+    {
+        vector<string> lines;
+        string line;
+        bool comment = false;
+        for (string::size_type i = 0; i < contents.size(); ++i)
+        {
+            char c = contents[i];
+            if (c == '\\' && i + 1 < contents.size())
+            {
+                char next = contents[i + 1];
+                if (next == '\n' || (next == '\r' && i + 2 < contents.size() && contents[i + 2] == '\n'))
+                {
+                    i += (next == '\n') ? 1 : 2;
+                    continue;
+                }
+                if (next == '#' && !comment)
+                {
+                    line += '#';
+                    ++i;
+                    continue;
+                }
+            }
+
+            if (c == '\n')
+            {
+                lines.push_back(line);
+                line.clear();
+                comment = false;
+            }
+            else if (c == '#')
+                comment = true;
+            else if (!comment)
+                line += c;
+        }
+        if (!line.empty())
+            lines.push_back(line);
+        return lines;
+    }
+
+    /** Substitutes the ${name} references in \c value */
+    string expand_variables(string const& value, std::map<string, string> const& variables)
+    {
+        string result;
+        result.reserve(value.size());
+        for (string::size_type i = 0; i < value.size(); ++i)
+        {
+            if (value[i] != '$' || i + 1 == value.size() || value[i + 1] != '{')
+            {
+                result += value[i];
+                continue;
+            }
+
+            string::size_type end = value.find('}', i + 2);
+            if (end == string::npos)
+            {
+                result.append(value, i, string::npos);
+                break;
+            }
+
+            string name(value, i + 2, end - i - 2);
+            std::map<string, string>::const_iterator it = variables.find(name);
+            if (it != variables.end())
+                result += it->second;
+            else if (name == "pc_sysrootdir")
+                result += "/";
+            else if (name == "pc_top_builddir")
+                result += "$(top_builddir)";
+            i = end;
+        }
+        return result;
+    }
+
+    /** Splits \c value in arguments as a shell would, handling quotes
+     * and backslashes */
+    vector<string> split_arguments(string const& value)
+    {
+        vector<string> result;
+        string current;
+        bool in_argument = false, escaped = false;
+        char quote = 0;
+        for (string::size_type i = 0; i < value.size(); ++i)
+        {
+            char c = value[i];
+            if (escaped)
+            {
+                // Only \\ and \" are escapes inside double quotes
+                if (quote == '"' && c != '\\' && c != '"')
+                    current += '\\';
+                current += c;
+                escaped = false;
+            }
+            else if (quote)
+            {
+                if (c == quote)
+                    quote = 0;
+                else if (c == '\\' && quote != '\'')
+                    escaped = true;
+                else
+                    current += c;
+            }
+            else if (isspace(static_cast<unsigned char>(c)))
+            {
+                if (in_argument)
+                    result.push_back(current);
+                current.clear();
+                in_argument = false;
+                continue;
+            }
+            else if (c == '\\')
+                escaped = true;
+            else if (c == '"' || c == '\'')
+                quote = c;
+            else
+                current += c;
+
+            in_argument = true;
+        }
+        if (in_argument)
+            result.push_back(current);
+        return result;
+    }
+
+    bool has_prefix(string const& s, char const* prefix)
+    { return s.compare(0, strlen(prefix), prefix) == 0; }
+
+    /** True for the flags which take the next argument with them, and
+     * for the arguments which are not flags */
+    bool is_unmergeable(string const& arg)
+    {
+        static char const* const prefixes[] = {
+            "-framework", "-isystem", "-idirafter", "-pthread", "-Wa,", "-Wl,",
+            "-Wp,", "-trigraphs", "-pedantic", "-ansi", "-std=", "-stdlib=",
+            "-include", "-nostdinc", "-nostdlibinc", "-nobuiltininc", 0 };
+
+        if (arg.empty() || arg[0] != '-')
+            return true;
+        for (char const* const* prefix = prefixes; *prefix; ++prefix)
+            if (has_prefix(arg, *prefix))
+                return true;
+        return false;
+    }
+
+    bool is_special(string const& arg)
+    { return arg.empty() || arg[0] != '-' || has_prefix(arg, "-lib:") || is_unmergeable(arg); }
+
+    fragment_list parse_fragments(string const& value)
+    {
+        fragment_list result;
+        vector<string> args = split_arguments(value);
+        for (vector<string>::const_iterator it = args.begin(); it != args.end(); ++it)
+        {
+            if (it->size() > 1 && !is_special(*it))
+                result.push_back(pc_fragment((*it)[1], string(*it, 2)));
+            else if (!result.empty() && !result.back().type && is_unmergeable(result.back().data))
+            {
+                result.back().data += " " + *it;
+                result.back().merged = true;
+            }
+            else
+                result.push_back(pc_fragment(0, *it));
+        }
+        return result;
+    }
+
+    bool is_separator(char c) { return c == ',' || isspace(static_cast<unsigned char>(c)); }
+    bool is_operator(char c)  { return c == '<' || c == '>' || c == '=' || c == '!'; }
+
+    /** Parses a Requires list. An operator must be separated from the
+     * package name by a blank; the character following the operator is
+     * skipped as pkgconf does */
+    dependency_list parse_dependencies(string const& value)
+    {
+        dependency_list result;
+        string::size_type const size = value.size();
+        string::size_type i = 0;
+        while (true)
+        {
+            while (i < size && is_separator(value[i]))
+                ++i;
+            if (i == size)
+                break;
+
+            pc_dependency dep;
+            string::size_type start = i;
+            while (i < size && !is_separator(value[i]))
+                ++i;
+            dep.name = string(value, start, i - start);
+
+            string::size_type next = i;
+            while (next < size && isspace(static_cast<unsigned char>(value[next])))
+                ++next;
+            if (next < size && is_operator(value[next]))
+            {
+                start = next;
+                while (next < size && is_operator(value[next]))
+                    ++next;
+                dep.op = string(value, start, next - start);
+                if (next++ >= size)
+                    break;
+
+                while (next < size && isspace(static_cast<unsigned char>(value[next])))
+                    ++next;
+                if (next >= size)
+                    break;
+                start = next;
+                while (next < size && !is_separator(value[next]))
+                    ++next;
+                dep.version = string(value, start, next - start);
+                i = next;
+            }
+            result.push_back(dep);
+        }
+        return result;
+    }
+
+    /** Compares two version strings the way rpm does */
+    int compare_versions(string const& a, string const& b)
+    {
+        if (strcasecmp(a.c_str(), b.c_str()) == 0)
+            return 0;
+
+        char const* one = a.c_str();
+        char const* two = b.c_str();
+        while (*one || *two)
+        {
+            while (*one && !isalnum(static_cast<unsigned char>(*one)) && *one != '~') ++one;
+            while (*two && !isalnum(static_cast<unsigned char>(*two)) && *two != '~') ++two;
+
+            if (*one == '~' || *two == '~')
+            {
+                if (*one != '~') return 1;
+                if (*two != '~') return -1;
+                ++one; ++two;
+                continue;
+            }
+            if (!(*one && *two))
+                break;
+
+            char const* end_one = one;
+            char const* end_two = two;
+            bool numeric = isdigit(static_cast<unsigned char>(*one));
+            if (numeric)
+            {
+                while (isdigit(static_cast<unsigned char>(*end_one))) ++end_one;
+                while (isdigit(static_cast<unsigned char>(*end_two))) ++end_two;
+            }
+            else
+            {
+                while (isalpha(static_cast<unsigned char>(*end_one))) ++end_one;
+                while (isalpha(static_cast<unsigned char>(*end_two))) ++end_two;
+            }
+
+            if (one == end_one) return -1;
+            if (two == end_two) return numeric ? 1 : -1;
+
+            if (numeric)
+            {
+                while (*one == '0' && one + 1 < end_one) ++one;
+                while (*two == '0' && two + 1 < end_two) ++two;
+                if (end_one - one > end_two - two) return 1;
+                if (end_two - two > end_one - one) return -1;
+            }
+
+            int cmp = string(one, end_one).compare(string(two, end_two));
+            if (cmp)
+                return cmp < 0 ? -1 : 1;
+            one = end_one;
+            two = end_two;
+        }
+        if (!*one && !*two) return 0;
+        return *one ? 1 : -1;
+    }
+
+    bool version_matches(string const& version, pc_dependency const& dep)
+    {
+        if (dep.op.empty())
+            return true;
+
+        int cmp = compare_versions(version, dep.version);
+        if (dep.op == "<")  return cmp < 0;
+        if (dep.op == "<=") return cmp <= 0;
+        if (dep.op == "=")  return cmp == 0;
+        if (dep.op == "!=") return cmp != 0;
+        if (dep.op == ">=") return cmp >= 0;
+        if (dep.op == ">")  return cmp > 0;
+        return true;
+    }
+
+    bool is_file(string const& path)
+    {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode);
+    }
+
+    /** The modification time and size of \c path, or an empty string if
+     * it does not exist */
+    string file_stamp(string const& path)
+    {
+        struct stat info;
+        if (stat(path.c_str(), &info) == -1)
+            return string();
+        std::ostringstream stamp;
+        stamp << info.st_mtim.tv_sec << '.' << info.st_mtim.tv_nsec << ' ' << info.st_size;
+        return stamp.str();
+    }
+
+    package_ptr load_package(string const& path, string const& directory)
+    {
+        string stamp = file_stamp(path);
+        std::ifstream file(path.c_str());
+        if (!file)
+            return package_ptr();
+        string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        boost::shared_ptr<pc_package> pkg(new pc_package);
+        pkg->path = path;
+        pkg->stamp = stamp;
+        pkg->variables["pcfiledir"] = directory;
+
+        vector<string> lines = read_lines(contents);
+        for (vector<string>::const_iterator line = lines.begin(); line != lines.end(); ++line)
+        {
+            string::size_type const size = line->size();
+            string::size_type i = 0;
+            while (i < size && isspace(static_cast<unsigned char>((*line)[i])))
+                ++i;
+            string::size_type const key_start = i;
+            while (i < size && (isalnum(static_cast<unsigned char>((*line)[i])) || (*line)[i] == '_' || (*line)[i] == '.'))
+                ++i;
+            if (i == key_start)
+                continue;
+            string key(*line, key_start, i - key_start);
+
+            while (i < size && isspace(static_cast<unsigned char>((*line)[i])))
+                ++i;
+            if (i == size || ((*line)[i] != ':' && (*line)[i] != '='))
+                continue;
+            char op = (*line)[i++];
+
+            while (i < size && isspace(static_cast<unsigned char>((*line)[i])))
+                ++i;
+            string::size_type end = size;
+            while (end > i && isspace(static_cast<unsigned char>((*line)[end - 1])))
+                --end;
+            string value = expand_variables(string(*line, i, end - i), pkg->variables);
+
+            if (op == '=')
+            {
+                pkg->variables[key] = value;
+                continue;
+            }
+
+            if (!strcasecmp(key.c_str(), "Version"))
+                pkg->version = value;
+            else if (!strcasecmp(key.c_str(), "Cflags"))
+                pkg->cflags = parse_fragments(value);
+            else if (!strcasecmp(key.c_str(), "Cflags.private"))
+                pkg->cflags_private = parse_fragments(value);
+            else if (!strcasecmp(key.c_str(), "Libs"))
+                pkg->libs = parse_fragments(value);
+            else if (!strcasecmp(key.c_str(), "Libs.private"))
+                pkg->libs_private = parse_fragments(value);
+            else if (!strcasecmp(key.c_str(), "Requires"))
+                pkg->requires = parse_dependencies(value);
+            else if (!strcasecmp(key.c_str(), "Requires.private"))
+                pkg->requires_private = parse_dependencies(value);
+        }
+        return pkg;
+    }
+
+    /** Adds \c fragment to \c list, removing or skipping duplicates.
+     * -I, -L and -F flags are kept at their first position. For the
+     * others, the last copy already in the list is moved to the end,
+     * unless the flag before it could be using it as argument. Private flags, i.e. the ones needed only for static
+     * linking, are always added. */
+    void add_fragment(fragment_list& list, pc_fragment const& fragment, bool is_private)
+    {
+        // Duplicates are looked for from the end
+        fragment_list::iterator existing = list.end();
+        if (!is_private)
+        {
+            fragment_list::reverse_iterator last = std::find(list.rbegin(), list.rend(), fragment);
+            if (last != list.rend())
+                existing = last.base() - 1;
+        }
+        if (existing != list.end())
+        {
+            char type = fragment.type;
+            if (type == 'I' || type == 'L' || type == 'F')
+                return;
+
+            bool merge = true;
+            if (existing != list.begin())
+            {
+                char previous = (existing - 1)->type;
+                if (previous != 'l' && previous != 'L' && previous != 'I')
+                    merge = !type || previous == type;
+            }
+            if (merge)
+                list.erase(existing);
+        }
+        list.push_back(fragment);
+    }
+
+    bool needs_escape(unsigned char c, bool merged)
+    {
+        return c < ' '
+            || (c >= (merged ? '!' : ' ') && c < '$')
+            || (c > '$' && c < '(')
+            || (c > ')' && c < '+')
+            || (c > ':' && c < '=')
+            || (c > '=' && c < '@')
+            || (c > 'Z' && c < '^')
+            || c == '`'
+            || (c > 'z' && c < '~')
+            || c > '~';
+    }
+
+    enum FlagQuery
+    {
+        CflagsAll, CflagsPath, CflagsOther,
+        LibsAll, LibsPath, LibsOther, LibsStatic, LibsNames
+    };
+
+    bool wanted(FlagQuery query, pc_fragment const& fragment, search_environment const& env)
+    {
+        if (fragment.type == 'I' && !env.allow_system_cflags
+                && std::find(env.system_includes.begin(), env.system_includes.end(), fragment.data) != env.system_includes.end())
+            return false;
+        if (fragment.type == 'L' && !env.allow_system_libs
+                && std::find(env.system_libdirs.begin(), env.system_libdirs.end(), fragment.data) != env.system_libdirs.end())
+            return false;
+
+        switch (query)
+        {
+            case CflagsPath:  return fragment.type == 'I';
+            case CflagsOther: return fragment.type != 'I';
+            case LibsPath:    return fragment.type == 'L';
+            case LibsNames:   return fragment.type == 'l';
+            case LibsOther:   return fragment.type != 'L' && fragment.type != 'l';
+            default: return true;
+        }
+    }
+
+    /** The .pc files read so far and the results computed from them.
+     * Everything is flushed when the search environment changes */
+    class package_cache
+    {
+        boost::mutex m_mutex;
+        string m_environment_key;
+        boost::shared_ptr<search_environment> m_environment;
+
+        typedef boost::unordered_map<string, package_ptr> package_map;
+        package_map m_packages;
+        typedef boost::unordered_map<string, string> result_map;
+        result_map m_results;
+
+        typedef vector<pc_package const*> package_stack;
+
+    public:
+        static package_cache& instance()
+        {
+            static package_cache cache;
+            return cache;
+        }
+
+        bool exists(string const& name)
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            refresh();
 
-pkgconfig::pkgconfig(string const& name_)
-    : m_name(name_)
+            string key = name + '\0' + 'e';
+            result_map::const_iterator cached = m_results.find(key);
+            if (cached != m_results.end())
+                return !cached->second.empty();
+
+            bool result = false;
+            if (package_ptr pkg = find(name))
+            {
+                try
+                {
+                    std::set<pc_package const*> checked;
+                    check_dependencies(*pkg, checked);
+                    result = true;
+                }
+                catch(not_found const&) { }
+            }
+            m_results[key] = result ? "1" : "";
+            return result;
+        }
+
+        string version(string const& name)
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            refresh();
+            return get(name).version;
+        }
+
+        string variable(string const& name, string const& var)
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            refresh();
+            pc_package const& pkg = get(name);
+            std::map<string, string>::const_iterator it = pkg.variables.find(var);
+            if (it != pkg.variables.end())
+                return it->second;
+            else if (var == "pc_sysrootdir")
+                return "/";
+            else if (var == "pc_top_builddir")
+                return "$(top_builddir)";
+            return string();
+        }
+
+        string flags(string const& name, FlagQuery query)
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            refresh();
+
+            string key = name + '\0' + static_cast<char>('0' + query);
+            result_map::const_iterator cached = m_results.find(key);
+            if (cached != m_results.end())
+                return cached->second;
+
+            bool cflags = (query <= CflagsOther);
+            bool is_static = (query == LibsStatic);
+            fragment_list fragments;
+            collect_state state(cflags, is_static);
+            collect(get(name), state, fragments);
+
+            string result;
+            for (fragment_list::const_iterator it = fragments.begin(); it != fragments.end(); ++it)
+            {
+                if (!wanted(query, *it, *m_environment))
+                    continue;
+
+                if (!result.empty())
+                    result += ' ';
+                if (it->type)
+                {
+                    result += '-';
+                    result += it->type;
+                }
+                for (string::const_iterator c = it->data.begin(); c != it->data.end(); ++c)
+                {
+                    if (needs_escape(*c, it->merged))
+                        result += '\\';
+                    result += *c;
+                }
+            }
+            m_results[key] = result;
+            return result;
+        }
+
+        /** Appends to \c key the path and stamp of the .pc files of
+         * \c packages, a list as given to pkg-config, and of the packages
+         * they require. Returns false if one of them cannot be found */
+        bool sources(string const& packages, string& key)
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            refresh();
+
+            // add_sources flushes the cache if one of the files changed
+            // since it has been parsed. Try again with the new files
+            dependency_list dependencies = parse_dependencies(packages);
+            for (int attempt = 0; attempt < 2; ++attempt)
+            {
+                std::set<pc_package const*> visited;
+                string result = m_environment_key;
+                bool changed = false;
+                if (add_sources(dependencies, visited, result, changed))
+                {
+                    key += result;
+                    return true;
+                }
+                else if (!changed)
+                    return false;
+            }
+            return false;
+        }
+
+    private:
+        package_cache() {}
+
+        bool add_sources(dependency_list const& dependencies, std::set<pc_package const*>& visited, string& key, bool& changed)
+        {
+            for (dependency_list::const_iterator dep = dependencies.begin(); dep != dependencies.end(); ++dep)
+            {
+                package_ptr pkg = find(dep->name);
+                if (!pkg)
+                    return false;
+                if (!visited.insert(pkg.get()).second)
+                    continue;
+
+                // The parsed file is out of date: its Requires may have
+                // changed as well
+                string stamp = file_stamp(pkg->path);
+                if (stamp != pkg->stamp)
+                {
+                    m_packages.clear();
+                    m_results.clear();
+                    changed = true;
+                    return false;
+                }
+
+                key += pkg->path;
+                key += '\0';
+                key += stamp;
+                key += '\0';
+                if (!add_sources(pkg->requires, visited, key, changed)
+                        || !add_sources(pkg->requires_private, visited, key, changed))
+                    return false;
+            }
+            return true;
+        }
+
+        /** Flushes the cache if the environment changed. Must be called
+         * with m_mutex locked */
+        void refresh()
+        {
+            string key;
+            for (char const* const* var = environment_variables; *var; ++var)
+            {
+                char const* value = getenv(*var);
+                key += value ? "=" : "!";
+                if (value)
+                    key += value;
+                key += '\0';
+            }
+
+            if (m_environment && key == m_environment_key)
+                return;
+            m_environment_key = key;
+            m_environment.reset(new search_environment);
+            m_packages.clear();
+            m_results.clear();
+        }
+
+        /** Looks for the .pc file of \c name, or returns NULL */
+        package_ptr find(string const& name)
+        {
+            package_map::const_iterator it = m_packages.find(name);
+            if (it != m_packages.end())
+                return it->second;
+
+            package_ptr result;
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, ".pc") == 0 && is_file(name))
+            {
+                string::size_type slash = name.rfind('/');
+                result = load_package(name, slash == string::npos ? string(".") : string(name, 0, slash));
+            }
+
+            vector<string> const& path = m_environment->search_path;
+            for (vector<string>::const_iterator dir = path.begin(); !result && dir != path.end(); ++dir)
+            {
+                string base = *dir + "/" + name;
+                if (m_environment->uninstalled && is_file(base + "-uninstalled.pc"))
+                    result = load_package(base + "-uninstalled.pc", *dir);
+                else if (is_file(base + ".pc"))
+                    result = load_package(base + ".pc", *dir);
+            }
+
+            m_packages[name] = result;
+            return result;
+        }
+
+        pc_package const& get(string const& name)
+        {
+            package_ptr pkg = find(name);
+            if (!pkg)
+                throw not_found(name);
+            return *pkg;
+        }
+
+        pc_package const& resolve(pc_dependency const& dep)
+        {
+            pc_package const& pkg = get(dep.name);
+            if (!version_matches(pkg.version, dep))
+                throw not_found(dep.name);
+            return pkg;
+        }
+
+        /** Checks that all the packages \c pkg requires are available */
+        void check_dependencies(pc_package const& pkg, std::set<pc_package const*>& checked)
+        {
+            checked.insert(&pkg);
+            dependency_list const* lists[2] = { &pkg.requires, &pkg.requires_private };
+            for (int i = 0; i < 2; ++i)
+            {
+                for (dependency_list::const_iterator dep = lists[i]->begin(); dep != lists[i]->end(); ++dep)
+                {
+                    pc_package const& required = resolve(*dep);
+                    if (!checked.count(&required))
+                        check_dependencies(required, checked);
+                }
+            }
+        }
+
+        struct collect_state
+        {
+            collect_state(bool cflags, bool is_static)
+                : cflags(cflags), is_static(is_static), in_private(false) {}
+
+            bool cflags;
+            bool is_static;
+            /** Set while walking a Requires.private list. As in pkgconf,
+             * it is reset when the walk of a nested Requires.private
+             * list ends, not restored */
+            bool in_private;
+            package_stack stack;
+        };
+
+        /** Collects the flags of \c pkg and of the packages it requires,
+         * depth-first */
+        void collect(pc_package const& pkg, collect_state& state, fragment_list& result)
+        {
+            state.stack.push_back(&pkg);
+
+            fragment_list const& own = state.cflags ? pkg.cflags : pkg.libs;
+            bool own_private = !state.cflags && state.in_private;
+            for (fragment_list::const_iterator it = own.begin(); it != own.end(); ++it)
+                add_fragment(result, *it, own_private);
+            if (state.is_static)
+            {
+                for (fragment_list::const_iterator it = pkg.libs_private.begin(); it != pkg.libs_private.end(); ++it)
+                    add_fragment(result, *it, true);
+            }
+
+            collect(pkg.requires, state, result);
+            if (state.cflags || state.is_static)
+            {
+                state.in_private = true;
+                collect(pkg.requires_private, state, result);
+                state.in_private = false;
+            }
+            state.stack.pop_back();
+        }
+
+        void collect(dependency_list const& dependencies, collect_state& state, fragment_list& result)
+        {
+            for (dependency_list::const_iterator dep = dependencies.begin(); dep != dependencies.end(); ++dep)
+            {
+                pc_package const& required = resolve(*dep);
+                if (std::find(state.stack.begin(), state.stack.end(), &required) == state.stack.end())
+                    collect(required, state, result);
+            }
+        }
+    };
+
+    /** The results of pkgconfig_batch saved on disk, in the order they
+     * have been computed. Each line is a result, made of tab-separated
+     * fields: the format version, the query key, 1 if pkg-config
+     * succeeded and 0 otherwise, and its output. The key and output are
+     * escaped (see escape_field), so that they contain no tab, newline
+     * or NUL. The file is emptied when it grows larger than max_size */
+    class result_store
+    {
+        static const off_t max_size = 1 << 20;
+        static char const* const version;
+
+        boost::mutex m_mutex;
+        string m_path;
+        /** How much of the file has been read */
+        off_t m_loaded;
+
+        typedef std::pair<bool, string> result;
+        typedef boost::unordered_map<string, result> result_map;
+        result_map m_results;
+
+        static void escape_field(string const& field, string& out)
+        {
+            for (string::const_iterator c = field.begin(); c != field.end(); ++c)
+            {
+                if (*c == '\\')      out += "\\\\";
+                else if (*c == '\n') out += "\\n";
+                else if (*c == '\t') out += "\\t";
+                else if (*c == '\0') out += "\\0";
+                else out += *c;
+            }
+        }
+
+        static string unescape_field(string const& line, string::size_type begin, string::size_type end)
+        {
+            string field;
+            for (string::size_type i = begin; i < end; ++i)
+            {
+                if (line[i] == '\\' && i + 1 < end)
+                {
+                    char c = line[++i];
+                    field += (c == 'n') ? '\n' : (c == 't') ? '\t' : (c == '0') ? '\0' : c;
+                }
+                else field += line[i];
+            }
+            return field;
+        }
+
+    public:
+        static result_store& instance()
+        {
+            static result_store store;
+            return store;
+        }
+
+        /** Looks for the result of the query identified by \c key */
+        bool get(string const& key, bool& found, string& output)
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            load();
+            result_map::const_iterator it = m_results.find(key);
+            if (it == m_results.end())
+                return false;
+            found  = it->second.first;
+            output = it->second.second;
+            return true;
+        }
+
+        /** Saves a list of results. The errors are ignored, as the
+         * results can always be computed again */
+        void put(vector<string> const& keys, vector<result> const& results)
+        {
+            if (keys.empty())
+                return;
+
+            boost::mutex::scoped_lock lock(m_mutex);
+            load();
+
+            string lines;
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                m_results[keys[i]] = results[i];
+
+                lines += version;
+                lines += '\t';
+                escape_field(keys[i], lines);
+                lines += results[i].first ? "\t1\t" : "\t0\t";
+                escape_field(results[i].second, lines);
+                lines += '\n';
+            }
+
+            if (m_path.empty())
+                return;
+            try { boost::filesystem::create_directories(boost::filesystem::path(m_path).parent_path()); }
+            catch(boost::filesystem::filesystem_error const&) { return; }
+
+            int fd = open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+            if (fd == -1)
+                return;
+            auto_close guard(fd);
+
+            struct stat info;
+            if (fstat(fd, &info) == -1)
+                return;
+            if (info.st_size > max_size && ftruncate(fd, 0) == 0)
+                info.st_size = m_loaded = 0;
+
+            // A single write, so that concurrent programs do not mix
+            // their lines. If another one wrote since the last load(),
+            // our lines will be read again with its ones
+            if (write(fd, lines.data(), lines.size()) == static_cast<ssize_t>(lines.size())
+                    && m_loaded == info.st_size)
+                m_loaded += lines.size();
+        }
+
+    private:
+        result_store() : m_loaded(0) {}
+
+        /** Reads what other programs appended to the file since the last
+         * call. Must be called with m_mutex locked */
+        void load()
+        {
+            string directory = config_file::cache_directory();
+            string path;
+            if (! directory.empty())
+                path = (boost::filesystem::path(directory) / "pkgconfig.cache").string();
+            struct stat info;
+            bool exists = !path.empty() && (stat(path.c_str(), &info) == 0);
+            if (path != m_path || !exists || info.st_size < m_loaded)
+            {
+                m_path = path;
+                m_loaded = 0;
+                m_results.clear();
+            }
+            if (!exists || info.st_size == m_loaded)
+                return;
+
+            std::ifstream file(path.c_str());
+            file.seekg(m_loaded);
+            string line;
+            while (std::getline(file, line))
+            {
+                if (file.eof())
+                    break; // incomplete line, being written
+                m_loaded += line.size() + 1;
+
+                // Lines of other versions are ignored
+                string::size_type key_begin = line.find('\t');
+                if (key_begin == string::npos || line.compare(0, key_begin, version) != 0)
+                    continue;
+                ++key_begin;
+                string::size_type key_end = line.find('\t', key_begin);
+                if (key_end == string::npos || key_end + 3 > line.size()
+                        || line[key_end + 2] != '\t')
+                    continue;
+
+                string key = unescape_field(line, key_begin, key_end);
+                bool found = (line[key_end + 1] == '1');
+                m_results[key] = result(found, unescape_field(line, key_end + 3, line.size()));
+            }
+        }
+    };
+
+    char const* const result_store::version = "2";
+
+    /** Starts \c prs and reads its standard output until it finishes */
+    void read_output(process& prs, string& output)
+    {
+        prs.capture(process::Stdout);
+        prs.redirect_to(process::Stderr, "/dev/null");
+        prs.start();
+        prs.communicate();
+        prs.wait();
+        output = prs.output(process::Stdout);
+    }
+
+    /** A pkg-config run of pkgconfig_batch::run */
+    struct pending_query
+    {
+        vector<string> const* command;
+        bool found;
+        string output;
+    };
+
+    /** Runs pending queries from several threads */
+    class query_runner
+    {
+        vector<pending_query>& m_queries;
+        boost::mutex m_mutex;
+        size_t m_next;
+        boost::shared_ptr<unix_error> m_error;
+
+    public:
+        query_runner(vector<pending_query>& queries)
+            : m_queries(queries), m_next(0) {}
+
+        void run(unsigned int thread_count)
+        {
+            if (thread_count == 0)
+                thread_count = boost::thread::hardware_concurrency();
+            thread_count = std::min<size_t>(std::max(thread_count, 1U), m_queries.size());
+
+            boost::thread_group threads;
+            for (unsigned int i = 1; i < thread_count; ++i)
+                threads.create_thread(boost::bind(&query_runner::worker, this));
+            worker();
+            threads.join_all();
+
+            if (m_error)
+                throw *m_error;
+        }
+
+    private:
+        void worker()
+        {
+            while (true)
+            {
+                pending_query* query;
+                { boost::mutex::scoped_lock lock(m_mutex);
+                    if (m_error || m_next == m_queries.size())
+                        return;
+                    query = &m_queries[m_next++];
+                }
+
+                process prs;
+                prs << "pkg-config";
+                for (vector<string>::const_iterator it = query->command->begin(); it != query->command->end(); ++it)
+                    prs << *it;
+
+                string output;
+                try { read_output(prs, output); }
+                catch(unix_error const& e)
+                {
+                    boost::mutex::scoped_lock lock(m_mutex);
+                    m_error.reset(new unix_error(e));
+                    return;
+                }
+
+                query->found  = prs.exit_normal() && prs.exit_status() == 0;
+                if (query->found)
+                    query->output = strip(output);
+            }
+        }
+    };
+}
+
+pkgconfig::pkgconfig(string const& name_, Backend backend)
+    : m_name(name_), m_backend(backend)
 {
-    if(!exists(name_))
+    if (m_backend == Native && !native_supported())
+        m_backend = External;
+    if(!exists(name_, m_backend))
         throw not_found(name_);
 }
 
@@ -21,30 +1164,38 @@ std::list<string> pkgconfig::packages()
 {
     process prs;
     prs << "pkg-config" << "--list-all";
-    string output = run(prs);
-    // strip output
-    string::size_type first = output.find_first_not_of(" \t\n");
-    if (first == string::npos) output = string();
-    string::size_type last  = output.find_last_not_of(" \t\n");
-    if (last == string::npos) output = string(output, first);
+    string out = run(prs);
 
-    string out = string(output, first, last - first + 1);
-    std::list<string> lines = split(out, "\n");
-    // remove the package descriptions
-    for (list<string>::iterator it = lines.begin(); it != lines.end(); ++it)
+    // Keep the first word of each line, the package name
+    std::list<string> names;
+    string::const_iterator it = out.begin(), end = out.end();
+    while (it != end)
     {
-        list<string> fields = split(*it, " ");
-        *it = fields.front();
+        string::const_iterator name = it;
+        while (it != end && *it != ' ' && *it != '\t' && *it != '\n')
+            ++it;
+        if (it != name)
+            names.push_back(string(name, it));
+        it = std::find(it, end, '\n');
+        if (it != end)
+            ++it;
     }
-
-    return lines;
+    return names;
 }
 
 string pkgconfig::name() const { return m_name; }
-string pkgconfig::version() const { return run("--modversion"); }
+string pkgconfig::version() const
+{
+    if (m_backend == Native)
+        return strip(package_cache::instance().version(m_name));
+    return run("--modversion");
+}
 
-bool pkgconfig::exists(string const& name)
+bool pkgconfig::exists(string const& name, Backend backend)
 {
+    if (backend == Native && native_supported())
+        return package_cache::instance().exists(name);
+
     process prs;
     prs << "pkg-config" << "--exists" << name;
 
@@ -54,6 +1205,9 @@ bool pkgconfig::exists(string const& name)
 
 string pkgconfig::get(string const& varname, string const& defval) const
 {
+    if (m_backend == Native)
+        return strip(package_cache::instance().variable(m_name, varname));
+
     try { return run("--variable=" + varname); }
     catch(pkgconfig_error) { return defval; } // pkg-config 0.19 crashes when varname does not exist ...
     catch(not_found) { return defval; }
@@ -61,49 +1215,38 @@ string pkgconfig::get(string const& varname, string const& defval) const
 
 static const char* const compiler_flags[] = { "--cflags", "--cflags-only-I", "--cflags-only-other" };
 string pkgconfig::compiler(Modes mode) const
-{ return run(compiler_flags[mode]); }
+{
+    if (m_backend == Native)
+        return package_cache::instance().flags(m_name, static_cast<FlagQuery>(CflagsAll + mode));
+    return run(compiler_flags[mode]);
+}
 
-static const char* const linker_flags[] = { "--libs", "--libs-only-L", "--libs-only-other", "--static", "--libs-only-l",  };
+static const char* const linker_flags[] = { "--libs", "--libs-only-L", "--libs-only-other", "--libs --static", "--libs-only-l",  };
 string pkgconfig::linker(Modes mode) const
-{ return run(linker_flags[mode]); }
+{
+    if (m_backend == Native)
+        return package_cache::instance().flags(m_name, static_cast<FlagQuery>(LibsAll + mode));
+    return run(linker_flags[mode]);
+}
 
 
 
 
-#include <iostream>
-string pkgconfig::run(string const& argument) const
+string pkgconfig::run(string const& arguments) const
 {
     process prs;
-    prs << "pkg-config" << argument << m_name;
-    string output = run(prs);
-    // strip output
-    string::size_type first = output.find_first_not_of(" \t\n");
-    if (first == string::npos) return string();
-    string::size_type last  = output.find_last_not_of(" \t\n");
-    if (last == string::npos) return string(output, first);
-    return string(output, first, last - first + 1);
+    prs << "pkg-config";
+    stringlist args = split(arguments, " ");
+    for (stringlist::const_iterator it = args.begin(); it != args.end(); ++it)
+        prs << *it;
+    prs << m_name;
+    return strip(run(prs));
 }
 
 string pkgconfig::run(process& prs)
 {
-    int pipeno[2];
-    pipe(pipeno);
-
-    prs.redirect_to(process::Stdout, pipeno[1]);
-    prs.redirect_to(process::Stderr, "/dev/null");
-    prs.start();
-
     string output;
-    while(true) 
-    {
-        char buffer[256];
-        int read_count = read(pipeno[0], buffer, 256);
-        if (read_count == -1)
-            throw unix_error();
-        if (read_count == 0)  break;
-        output += string(buffer, read_count);
-    }
-    prs.wait();
+    read_output(prs, output);
 
     if (!prs.exit_normal()) 
         throw pkgconfig_error();
@@ -113,4 +1256,99 @@ string pkgconfig::run(process& prs)
     return output;
 }
 
+pkgconfig_batch::pkgconfig_batch()
+    : m_process_count(0) {}
+pkgconfig_batch::~pkgconfig_batch() {}
+
+std::size_t pkgconfig_batch::add(string const& packages, Query query, pkgconfig::Modes mode)
+{
+    switch (query)
+    {
+        case Exists:   return add(packages, "--exists");
+        case Version:  return add(packages, "--modversion");
+        case Compiler: return add(packages, compiler_flags[mode]);
+        default:       return add(packages, linker_flags[mode]);
+    }
+}
+
+std::size_t pkgconfig_batch::variable(string const& packages, string const& name)
+{ return add(packages, "--variable=" + name); }
+
+std::size_t pkgconfig_batch::add(string const& packages, string const& arguments)
+{
+    entry query;
+    stringlist words = split(arguments + " " + packages, " ");
+    query.command.assign(words.begin(), words.end());
+    query.packages = packages;
+    query.done  = false;
+    query.found = false;
+
+    string key = join(words, string(1, '\0'));
+    boost::unordered_map<string, size_t>::const_iterator it = m_index.find(key);
+    if (it != m_index.end())
+        return it->second;
+
+    m_entries.push_back(query);
+    m_index[key] = m_entries.size() - 1;
+    return m_entries.size() - 1;
+}
+
+void pkgconfig_batch::run(unsigned int thread_count)
+{
+    result_store& store = result_store::instance();
+    bool cached = native_supported();
+
+    // Look for the results in the cache first
+    vector<entry*> entries;
+    vector<string> keys;
+    vector<pending_query> pending;
+    for (vector<entry>::iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+        if (it->done)
+            continue;
+
+        string key;
+        for (vector<string>::const_iterator word = it->command.begin(); word != it->command.end(); ++word)
+            key += *word + '\0';
+        if (!cached || !package_cache::instance().sources(it->packages, key))
+            key.clear();
+        else if (store.get(key, it->found, it->result))
+        {
+            it->done = true;
+            continue;
+        }
+
+        pending_query query;
+        query.command = &it->command;
+        query.found   = false;
+        pending.push_back(query);
+        entries.push_back(&*it);
+        keys.push_back(key);
+    }
+
+    m_process_count = pending.size();
+    if (pending.empty())
+        return;
+    query_runner(pending).run(thread_count);
+
+    vector<string> saved_keys;
+    vector< std::pair<bool, string> > saved_results;
+    for (size_t i = 0; i < pending.size(); ++i)
+    {
+        entry& e = *entries[i];
+        e.done   = true;
+        e.found  = pending[i].found;
+        e.result = pending[i].output;
+        if (!keys[i].empty())
+        {
+            saved_keys.push_back(keys[i]);
+            saved_results.push_back(std::make_pair(e.found, e.result));
+        }
+    }
+    store.put(saved_keys, saved_results);
+}
 
+std::size_t pkgconfig_batch::size() const { return m_entries.size(); }
+bool pkgconfig_batch::found(std::size_t query) const { return m_entries[query].found; }
+string const& pkgconfig_batch::result(std::size_t query) const { return m_entries[query].result; }
+std::size_t pkgconfig_batch::process_count() const { return m_process_count; }
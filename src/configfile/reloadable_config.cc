@@ -0,0 +1,192 @@
+#include "utilmm/configfile/reloadable_config.hh"
+
+#include <boost/bind.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+using std::string;
+using namespace utilmm;
+
+namespace
+{
+    typedef std::map< string, std::vector<boost::string_view> > flat_config;
+
+    /** Lists the values of \c set and its children by path */
+    void flatten(config_set const& set, string const& prefix, flat_config& result)
+    {
+        config_set::value_range values = set.values_range();
+        for (config_set::value_iterator it = values.begin(); it != values.end(); ++it)
+            result[prefix + string(it->first.view())].push_back(it->second.view());
+
+        config_set::child_range children = set.children_range();
+        boost::string_view last_name;
+        int index = 0;
+        for (config_set::child_iterator it = children.begin(); it != children.end(); ++it)
+        {
+            index = (it.name() == last_name) ? index + 1 : 0;
+            last_name = it.name();
+
+            string path = prefix + string(it.name());
+            if (index)
+                path += "[" + boost::lexical_cast<string>(index) + "]";
+            flatten(*it, path + "/", result);
+        }
+    }
+}
+
+reloadable_config::reloadable_config(std::string const& name)
+    : m_path(name)
+    , m_current(new config_file(name))
+    , m_next_id(0)
+    , m_inotify(-1), m_stop(-1)
+{
+    // Watch the directory, as editors often replace the file instead of
+    // modifying it
+    boost::filesystem::path dir = boost::filesystem::path(name).parent_path();
+    if (dir.empty())
+        dir = ".";
+
+    m_inotify = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    m_stop    = eventfd(0, EFD_CLOEXEC);
+    if (m_inotify == -1 || m_stop == -1
+            || inotify_add_watch(m_inotify, dir.string().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+    {
+        if (m_inotify != -1) close(m_inotify);
+        if (m_stop != -1) close(m_stop);
+        throw not_found(dir.string());
+    }
+
+    m_thread.reset(new boost::thread(boost::bind(&reloadable_config::watch, this)));
+}
+
+reloadable_config::~reloadable_config()
+{
+    // Writing to an eventfd only fails if interrupted. The thread uses
+    // this object, so it must be joined in all cases
+    uint64_t one = 1;
+    while (write(m_stop, &one, sizeof(one)) == -1 && errno == EINTR)
+        ;
+    m_thread->join();
+
+    close(m_inotify);
+    close(m_stop);
+}
+
+std::string const& reloadable_config::path() const { return m_path; }
+reloadable_config::snapshot reloadable_config::current() const
+{ return boost::atomic_load(&m_current); }
+
+int reloadable_config::subscribe(subscriber const& callback)
+{
+    boost::mutex::scoped_lock lock(m_subscribers_mutex);
+    int id = m_next_id++;
+    m_subscribers[id] = callback;
+    return id;
+}
+void reloadable_config::unsubscribe(int id)
+{
+    boost::mutex::scoped_lock lock(m_subscribers_mutex);
+    m_subscribers.erase(id);
+}
+
+reloadable_config::key_list reloadable_config::diff(config_set const& a, config_set const& b)
+{
+    flat_config flat_a, flat_b;
+    flatten(a, string(), flat_a);
+    flatten(b, string(), flat_b);
+
+    key_list result;
+    flat_config::const_iterator it_a = flat_a.begin(), it_b = flat_b.begin();
+    while (it_a != flat_a.end() || it_b != flat_b.end())
+    {
+        if (it_b == flat_b.end() || (it_a != flat_a.end() && it_a->first < it_b->first))
+            result.push_back((it_a++)->first);
+        else if (it_a == flat_a.end() || it_b->first < it_a->first)
+            result.push_back((it_b++)->first);
+        else
+        {
+            if (it_a->second != it_b->second)
+                result.push_back(it_a->first);
+            ++it_a; ++it_b;
+        }
+    }
+    return result;
+}
+
+reloadable_config::key_list reloadable_config::reload()
+{
+    snapshot new_config;
+    key_list changed;
+    { boost::mutex::scoped_lock lock(m_reload_mutex);
+        new_config.reset(new config_file(m_path));
+        snapshot old_config = current();
+        changed = diff(*old_config, *new_config);
+        if (changed.empty())
+            return changed;
+
+        boost::atomic_store(&m_current, new_config);
+    }
+
+    // The subscribers are called without any lock held, so that they
+    // can call reload() or wait for a thread which does
+
+    std::vector<subscriber> subscribers;
+    { boost::mutex::scoped_lock lock(m_subscribers_mutex);
+        for (std::map<int, subscriber>::const_iterator it = m_subscribers.begin(); it != m_subscribers.end(); ++it)
+            subscribers.push_back(it->second);
+    }
+    for (std::size_t i = 0; i < subscribers.size(); ++i)
+        subscribers[i](new_config, changed);
+
+    return changed;
+}
+
+void reloadable_config::watch()
+{
+    string const file_name = boost::filesystem::path(m_path).filename().string();
+
+    pollfd fds[2];
+    fds[0].fd = m_inotify;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_stop;
+    fds[1].events = POLLIN;
+
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    while (true)
+    {
+        if (poll(fds, 2, -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (fds[1].revents)
+            return;
+
+        bool changed = false;
+        ssize_t size;
+        while ((size = read(m_inotify, buffer, sizeof(buffer))) > 0)
+        {
+            for (char* ptr = buffer; ptr < buffer + size; )
+            {
+                inotify_event const* event = reinterpret_cast<inotify_event const*>(ptr);
+                if (event->len && file_name == event->name)
+                    changed = true;
+                ptr += sizeof(inotify_event) + event->len;
+            }
+        }
+
+        if (changed)
+        {
+            try { reload(); }
+            catch(std::exception const&) { } // keep the current configuration
+        }
+    }
+}
@@ -1,42 +1,194 @@
 #include "utilmm/configfile/shell_expand.hh"
 
-#include <boost/regex.hpp>
-#include <iterator>
-#include <sstream>
+#include <stdlib.h>
+#include <string.h>
 
-using namespace std;
-using boost::regex;
-using boost::smatch;
+extern char** environ;
 
+using std::string;
+using boost::string_view;
+using utilmm::environment;
 
-#include <iostream>
+namespace
+{
+    bool is_name_char(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+            || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    /** Resolves variables through getenv() */
+    struct process_environment
+    {
+        bool operator()(string_view name, string_view& value) const
+        {
+            // getenv() needs a NUL-terminated name
+            char buffer[256];
+            string long_name;
+            char const* c_name = buffer;
+            if (name.size() < sizeof(buffer))
+            {
+                memcpy(buffer, name.data(), name.size());
+                buffer[name.size()] = 0;
+            }
+            else
+            {
+                long_name = string(name);
+                c_name = long_name.c_str();
+            }
+
+            char const* result = getenv(c_name);
+            if (!result)
+                return false;
+            value = string_view(result);
+            return true;
+        }
+    };
+
+    /** Resolves variables in an environment object */
+    struct snapshot_environment
+    {
+        environment const& env;
+        explicit snapshot_environment(environment const& env) : env(env) {}
+
+        bool operator()(string_view name, string_view& value) const
+        {
+            string const* result = env.get(name);
+            if (!result)
+                return false;
+            value = *result;
+            return true;
+        }
+    };
+
+    /** Returns the position of the '}' closing the brace at
+     * <tt>text[start - 1]</tt>, or npos */
+    size_t find_closing_brace(string_view text, size_t start)
+    {
+        int depth = 1;
+        for (size_t i = start; i < text.size(); ++i)
+        {
+            if (text[i] == '{')
+                ++depth;
+            else if (text[i] == '}' && --depth == 0)
+                return i;
+        }
+        return string_view::npos;
+    }
+
+    template<typename Resolver>
+    void expand(string_view text, Resolver const& resolve, string& output)
+    {
+        size_t const size = text.size();
+        size_t copied = 0;
+        size_t i = 0;
+        while ((i = text.find('$', i)) != string_view::npos)
+        {
+            size_t const start = i++;
+            string_view name, default_value;
+            bool has_default = false;
 
-string utilmm::shell_expand(string const& text)
+            if (i < size && text[i] == '{')
+            {
+                size_t name_end = ++i;
+                while (name_end < size && is_name_char(text[name_end]))
+                    ++name_end;
+                if (name_end == i)
+                    continue;
+
+                size_t end;
+                if (name_end < size && text[name_end] == '}')
+                    end = name_end;
+                else if (text.substr(name_end, 2) == ":-")
+                {
+                    end = find_closing_brace(text, name_end + 2);
+                    if (end == string_view::npos)
+                        continue;
+                    has_default = true;
+                    default_value = text.substr(name_end + 2, end - name_end - 2);
+                }
+                else
+                    continue;
+
+                name = text.substr(i, name_end - i);
+                i = end + 1;
+            }
+            else
+            {
+                size_t name_end = i;
+                while (name_end < size && is_name_char(text[name_end]))
+                    ++name_end;
+                if (name_end == i)
+                    continue;
+                name = text.substr(i, name_end - i);
+                i = name_end;
+            }
+
+            output.append(text.data() + copied, start - copied);
+            copied = i;
+
+            string_view value;
+            bool found = resolve(name, value);
+            if (has_default && (!found || value.empty()))
+                expand(default_value, resolve, output);
+            else if (found)
+                output.append(value.data(), value.size());
+        }
+        output.append(text.data() + copied, size - copied);
+    }
+}
+
+namespace utilmm
 {
-    static regex const 
-        rx_shellvalue("\\$(\\w+)");
+    environment::environment() {}
 
-    smatch result;
-    if (! regex_search(text, result, rx_shellvalue))
-        return text;
-    
-    string::const_iterator last_match;
-    string::const_iterator const end = text.end();
+    environment environment::capture()
+    {
+        environment result;
+        for (char** var = environ; *var; ++var)
+        {
+            char const* separator = strchr(*var, '=');
+            if (!separator)
+                continue;
+            // Keep the first definition, as getenv() does
+            result.m_variables.insert(std::make_pair(string(*var, separator - *var), string(separator + 1)));
+        }
+        return result;
+    }
+
+    void environment::set(string const& name, string const& value)
+    { m_variables[name] = value; }
 
-    ostringstream expanded;
-    do
+    string const* environment::get(string_view name) const
     {
-        expanded << result.prefix();
+        VariableMap::const_iterator it = m_variables.find(name, name_hash(), name_equal());
+        if (it == m_variables.end())
+            return 0;
+        return &it->second;
+    }
+
+    size_t environment::size() const { return m_variables.size(); }
 
-        std::string env_key = result[1];
-        char const* env_value = getenv(env_key.c_str());
-        if (env_value)
-            expanded << env_value;
+    string shell_expand(string const& text)
+    {
+        string output;
+        output.reserve(text.size());
+        expand(text, process_environment(), output);
+        return output;
+    }
 
-        last_match = result.suffix().first;
-    } while(regex_search(last_match, end, result, rx_shellvalue));
+    string shell_expand(string_view text, environment const& env)
+    {
+        string output;
+        output.reserve(text.size());
+        expand(text, snapshot_environment(env), output);
+        return output;
+    }
 
-    copy(last_match, end, ostream_iterator<string::value_type>(expanded));
-    return expanded.str();
+    void shell_expand(string_view text, environment const& env, string& output)
+    {
+        output.reserve(output.size() + text.size());
+        expand(text, snapshot_environment(env), output);
+    }
 }
 
@@ -8,77 +8,359 @@
 #include <boost/filesystem/fstream.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
 
 namespace utilmm {
 
 const char* configEnv = "ROCK_CONFIG_PATH";
 
+namespace {
 
-std::string ConfigurationFinder::find( const std::string& configFile)
+/**
+* The listings of the directories searched so far, and the value of
+* ROCK_CONFIG_PATH split in directories
+*/
+class DirectoryIndex
 {
-	return find(configFile, "");
-}
+	/** The entries of a directory, and whether they are symbolic links */
+	typedef boost::unordered_map<std::string, bool> Listing;
+	typedef boost::unordered_map<std::string, Listing> ListingMap;
+	/** The directories watched by each inotify watch descriptor. A
+	* directory can be reached by several paths */
+	typedef boost::unordered_map<int, std::vector<std::string> > WatchMap;
 
-std::string ConfigurationFinder::find( const std::string& configFile, const std::string& packagename)
-{
-	std::string configurationDir = getenv(configEnv) ? getenv(configEnv) : "";
+	boost::mutex mMutex;
+	ConfigurationFinder::IndexMode mMode;
+	ListingMap mListings;
+	WatchMap mWatches;
+	int mInotify;
 
-	std::vector<std::string> searchDirectories;
-	if( configurationDir.empty() )
+	bool mPathSet;
+	std::string mPath;
+	std::vector<std::string> mDirectories;
+
+	DirectoryIndex()
+		: mMode(ConfigurationFinder::WatchedIndex), mInotify(-1), mPathSet(false) {}
+
+public:
+	static DirectoryIndex& instance()
 	{
-		fprintf(stderr, "WARNING: ConfigurationFinder: environment variable %s is not set\n", configEnv);
-	} else {
+		static DirectoryIndex index;
+		return index;
+	}
 
-		boost::split(searchDirectories, configurationDir, boost::is_any_of(":"));
+	ConfigurationFinder::IndexMode mode()
+	{
+		boost::mutex::scoped_lock lock(mMutex);
+		return mMode;
 	}
 
-	if(packagename != "")
+	void setMode(ConfigurationFinder::IndexMode mode)
 	{
-		// append packagename to configuration files, e.g. if packagename is my-package
-		// my-package/ will be appended to the searchDirectories
-		std::vector<std::string>::iterator it = searchDirectories.begin();
-		for(;it != searchDirectories.end(); it++)
+		boost::mutex::scoped_lock lock(mMutex);
+		reset();
+		mMode = mode;
+	}
+
+	void invalidate()
+	{
+		boost::mutex::scoped_lock lock(mMutex);
+		reset();
+	}
+
+	/**
+	* Looks for \c file in the current directory, then in the
+	* subdirectory \c package of the directories of ROCK_CONFIG_PATH. The
+	* variable is only split again when its value changes
+	*/
+	std::string find(const std::string& file, const std::string& package)
+	{
+		boost::mutex::scoped_lock lock(mMutex);
+		const char* value = getenv(configEnv);
+		if (!value || !*value)
+		{
+			fprintf(stderr, "WARNING: ConfigurationFinder: environment variable %s is not set\n", configEnv);
+			mDirectories.clear();
+			mPathSet = false;
+		}
+		else if (!mPathSet || mPath != value)
 		{
-			boost::filesystem::path directory(*it);
-			boost::filesystem::path searchPath = operator/(directory, packagename);
-			*it = searchPath.string();
+			mPath = value;
+			mPathSet = true;
+			mDirectories.clear();
+			boost::split(mDirectories, mPath, boost::is_any_of(":"));
 		}
+		return searchLocked(file, mDirectories, package);
 	}
 
-	return search(configFile, searchDirectories);
-}
+	/**
+	* Looks for \c file in the current directory, then in each of
+	* \c directories
+	*/
+	std::string search(const std::string& file, const std::vector<std::string>& directories)
+	{
+		boost::mutex::scoped_lock lock(mMutex);
+		return searchLocked(file, directories, std::string());
+	}
 
-std::string ConfigurationFinder::search(const std::string& file, const std::vector<std::string>& searchDirectories)
-{
-	std::string searchFile(file);
-	std::string result;
+private:
+	/**
+	* Looks for \c file in the current directory, then in the
+	* subdirectory \c package of each of \c directories
+	* \return the absolute path of the file, or an empty string
+	*/
+	std::string searchLocked(const std::string& file, const std::vector<std::string>& directories, const std::string& package)
+	{
+		if (file.empty())
+			return std::string();
+
+		processEvents();
+		const std::string cwd = boost::filesystem::current_path().string();
+
+		// The listings are looked up with the directory part of the file
+		// and its name. Absolute and special names are checked on the
+		// file system
+		std::string::size_type slash = file.rfind('/');
+		const std::string name(file, slash == std::string::npos ? 0 : slash + 1);
+		const std::string subdir(file, 0, slash == std::string::npos ? 0 : slash);
+		bool indexed = (mMode != ConfigurationFinder::NoIndex) && file[0] != '/'
+			&& !name.empty() && name != "." && name != "..";
+
+		std::string directory = cwd;
+		appendPath(directory, subdir);
+		if (indexed ? contains(directory, name) : boost::filesystem::exists(absolutePath(file, cwd)))
+			return absolutePath(file, cwd);
+
+		for (std::vector<std::string>::const_iterator it = directories.begin(); it != directories.end(); ++it)
+		{
+			if (indexed)
+			{
+				// Reuse the buffer of the previous directory
+				if (it->empty() || (*it)[0] != '/')
+					directory.assign(cwd);
+				else
+					directory.clear();
+				appendPath(directory, *it);
+				appendPath(directory, package);
+				appendPath(directory, subdir);
+				if (contains(directory, name))
+				{
+					appendPath(directory, name);
+					return directory;
+				}
+			}
+			else
+			{
+				std::string candidate = absolutePath(join(join(*it, package), file), cwd);
+				if (boost::filesystem::exists(candidate))
+					return candidate;
+			}
+		}
+		return std::string();
+	}
+
+	/** Appends \c name to \c path, as boost::filesystem::path's /= */
+	static void appendPath(std::string& path, const std::string& name)
+	{
+		if (name.empty())
+			return;
+		if (!path.empty() && path[path.size() - 1] != '/')
+			path += '/';
+		path += name;
+	}
+
+	/** Appends \c name to \c directory, as boost::filesystem::path's / */
+	static std::string join(const std::string& directory, const std::string& name)
+	{
+		std::string result(directory);
+		appendPath(result, name);
+		return result;
+	}
+
+	/** The absolute form of \c file, as boost::filesystem::system_complete */
+	static std::string absolutePath(const std::string& file, const std::string& cwd)
+	{
+		if (!file.empty() && file[0] == '/')
+			return file;
+		return join(cwd, file);
+	}
+
+	/**
+	* Checks if the absolute path \c directory contains \c name, using
+	* the listing of the directory
+	*/
+	bool contains(const std::string& directory, const std::string& name)
+	{
+		ListingMap::const_iterator it = mListings.find(directory);
+		if (it == mListings.end())
+		{
+			// Watch before listing, so that no change is missed
+			bool watched = (mMode == ConfigurationFinder::WatchedIndex);
+			bool keep = !watched || watch(directory);
+
+			Listing listing;
+			if (!list(directory, listing) && watched)
+				keep = false;
+			if (!keep)
+				return lookup(directory, listing, name);
+			it = mListings.insert(std::make_pair(directory, listing)).first;
+		}
+		return lookup(directory, it->second, name);
+	}
+
+	/**
+	* Checks if \c name is in the listing of \c directory. The target of a
+	* symbolic link can be created or removed without any change in the
+	* directory, so it is checked every time
+	*/
+	static bool lookup(const std::string& directory, const Listing& listing, const std::string& name)
+	{
+		Listing::const_iterator it = listing.find(name);
+		if (it == listing.end())
+			return false;
+		return !it->second || boost::filesystem::exists(join(directory, name));
+	}
 
-	if( searchFile != "")
+	/**
+	* Lists the entries of \c directory, including the symbolic links
+	* whose target does not exist
+	*/
+	static bool list(const std::string& directory, Listing& listing)
 	{
-		// Check current directory first
-		if(boost::filesystem::exists(searchFile))
+		boost::system::error_code error;
+		boost::filesystem::directory_iterator it(directory, error), end;
+		if (error)
+			return false;
+
+		for (; it != end; it.increment(error))
 		{
-			result =  boost::filesystem::system_complete( searchFile ).string();
+			if (error)
+				return false;
+			bool symlink = (it->symlink_status().type() == boost::filesystem::symlink_file);
+			listing[it->path().filename().string()] = symlink;
+		}
+		return true;
+	}
 
-		} else {
-			// search in given search directories
-			std::vector<std::string>::const_iterator it = searchDirectories.begin();
+	/** Drops the listings and the watches */
+	void reset()
+	{
+		mListings.clear();
+		mWatches.clear();
+#ifdef __linux__
+		if (mInotify != -1)
+			close(mInotify);
+		mInotify = -1;
+#endif
+	}
 
-			for(; it != searchDirectories.end(); it++)
+#ifdef __linux__
+	/** Watches \c directory for the files being added or removed */
+	bool watch(const std::string& directory)
+	{
+		if (mInotify == -1)
+		{
+			mInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (mInotify == -1)
+				return false;
+		}
+
+		int wd = inotify_add_watch(mInotify, directory.c_str(),
+				IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+				IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+		if (wd == -1)
+			return false;
+
+		std::vector<std::string>& directories = mWatches[wd];
+		if (std::find(directories.begin(), directories.end(), directory) == directories.end())
+			directories.push_back(directory);
+		return true;
+	}
+
+	/** Drops the listings of the directories that changed */
+	void processEvents()
+	{
+		if (mInotify == -1)
+			return;
+
+		char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+		while (true)
+		{
+			ssize_t length = read(mInotify, buffer, sizeof(buffer));
+			if (length == -1 && errno == EINTR)
+				continue;
+			if (length <= 0)
+				return;
+
+			for (char* ptr = buffer; ptr < buffer + length; )
 			{
-				boost::filesystem::path dir(*it);
-				boost::filesystem::path testPath = operator/(dir,searchFile);
+				const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(ptr);
+				ptr += sizeof(struct inotify_event) + event->len;
 
-				if( boost::filesystem::exists(testPath) )
+				// Some events have been lost
+				if (event->mask & IN_Q_OVERFLOW)
 				{
-					result = boost::filesystem::system_complete( testPath ).string();
-					break;
+					reset();
+					return;
 				}
+
+				WatchMap::iterator it = mWatches.find(event->wd);
+				if (it == mWatches.end())
+					continue;
+				for (size_t i = 0; i < it->second.size(); ++i)
+					mListings.erase(it->second[i]);
+				if (event->mask & IN_IGNORED)
+					mWatches.erase(it);
 			}
 		}
 	}
+#else
+	bool watch(const std::string& directory) { return true; }
+	void processEvents() {}
+#endif
+};
+
+}
+
+void ConfigurationFinder::setIndexMode(IndexMode mode)
+{
+	DirectoryIndex::instance().setMode(mode);
+}
+
+ConfigurationFinder::IndexMode ConfigurationFinder::getIndexMode()
+{
+	return DirectoryIndex::instance().mode();
+}
+
+void ConfigurationFinder::invalidateIndex()
+{
+	DirectoryIndex::instance().invalidate();
+}
 
-	return result;
+
+std::string ConfigurationFinder::find( const std::string& configFile)
+{
+	return find(configFile, "");
+}
+
+std::string ConfigurationFinder::find( const std::string& configFile, const std::string& packagename)
+{
+	// packagename is appended to the directories of the search path, e.g.
+	// if packagename is my-package, my-package/ is appended
+	return DirectoryIndex::instance().find(configFile, packagename);
+}
+
+std::string ConfigurationFinder::search(const std::string& file, const std::vector<std::string>& searchDirectories)
+{
+	return DirectoryIndex::instance().search(file, searchDirectories);
 }
 
 std::string ConfigurationFinder::findSystemConfig(const std::string& file, const std::string& systemId)
@@ -5,6 +5,12 @@
 
 using namespace utilmm::singleton;
 
+/*
+ * struct utilmm::singleton::details::type_key
+ */
+details::type_key::type_key(char const *type_name)
+  :name(type_name), hash(server::hash_name(type_name, std::strlen(type_name))) {}
+
 /*
  * class utilmm::singleton::dummy
  */
@@ -25,18 +31,19 @@ bool dummy::decr_ref() const {
 }
 
 // statics
-void dummy::attach(std::string const &name, details::dummy_factory const& inst) {
+void dummy::attach(details::type_key const &key, details::dummy_factory const& inst,
+                   details::instance_cache &cache) {
   server::lock_type locker(server::sing_mtx);
-  server::instance().attach(name, inst);
+  server::instance().attach(key, inst, cache);
 }
 
-void dummy::detach(std::string const &name) {
+void dummy::detach(details::type_key const &key, details::instance_cache &cache) {
   server::lock_type locker(server::sing_mtx);
-  if( server::instance().detach(name) )
+  if( server::instance().detach(key, cache) )
     delete server::the_instance;
 }
 
-dummy *dummy::instance(std::string const &name) {
+dummy *dummy::instance(details::type_key const &key) {
   server::lock_type locker(server::sing_mtx);
-  return server::instance().get(name);
+  return server::instance().get(key);
 }
@@ -24,20 +24,52 @@ server::~server() {
   the_instance = 0;
 }
 
+/*
+ * struct utilmm::singleton::server::entry
+ */
+void server::entry::add_cache(details::instance_cache &cache) {
+  cache_list::iterator i = caches.begin();
+  for( ; caches.end()!=i; ++i )
+    if( i->first==&cache ) {
+      ++(i->second);
+      return;
+    }
+  caches.push_back(cache_ref(&cache, 1ul));
+  cache.store(instance, boost::memory_order_release);
+}
+
+void server::entry::remove_cache(details::instance_cache &cache) {
+  cache_list::iterator i = caches.begin();
+  for( ; caches.end()!=i; ++i )
+    if( i->first==&cache ) {
+      if( 0==--(i->second) ) {
+        cache.store(0, boost::memory_order_release);
+        caches.erase(i);
+      }
+      return;
+    }
+}
+
 // modifiers
-void server::attach(std::string const &name, details::dummy_factory const& factory) {
-  single_map::iterator it = singletons.find(name);
-  if (it == singletons.end())
-    it = singletons.insert( single_map::value_type(name, factory.create()) ).first;
+void server::attach(details::type_key const &key, details::dummy_factory const& factory,
+                    details::instance_cache &cache) {
+  single_map::iterator it = singletons.find(key, key_hash(), key_equal());
+  if (it == singletons.end()) {
+    entry new_entry;
+    new_entry.instance = factory.create();
+    it = singletons.insert( single_map::value_type(key.name, new_entry) ).first;
+  }
 
-  it->second->incr_ref();
+  it->second.instance->incr_ref();
+  it->second.add_cache(cache);
 }
 
-bool server::detach(std::string const &name) {
-  single_map::iterator i = singletons.find(name);
+bool server::detach(details::type_key const &key, details::instance_cache &cache) {
+  single_map::iterator i = singletons.find(key, key_hash(), key_equal());
 
-  if( i->second->decr_ref() ) {
-    dummy *to_del = i->second;
+  i->second.remove_cache(cache);
+  if( i->second.instance->decr_ref() ) {
+    dummy *to_del = i->second.instance;
 
     singletons.erase(i);
     delete to_del;
@@ -47,11 +79,21 @@ bool server::detach(std::string const &name) {
 }
 
 // observers 
-dummy *server::get(std::string const &name) const {
-  return singletons.find(name)->second;
+dummy *server::get(details::type_key const &key) const {
+  return singletons.find(key, key_hash(), key_equal())->second.instance;
 }
 
 // statics
+size_t server::hash_name(char const *name, size_t length) {
+  // 64 bits FNV-1a, truncated on 32 bits platforms
+  unsigned long long h = 14695981039346656037ull;
+  for(size_t i=0; i<length; ++i) {
+    h ^= static_cast<unsigned char>(name[i]);
+    h *= 1099511628211ull;
+  }
+  return static_cast<size_t>(h);
+}
+
 server &server::instance() {
   if( 0==the_instance )
     new server;
@@ -4,9 +4,11 @@
 #ifndef UTILMM_SINGLETON_SERVER_HEADER
 # define UTILMM_SINGLETON_SERVER_HEADER
 
-# include <map>
+# include <cstring>
+# include <vector>
 
 # include "boost/thread/recursive_mutex.hpp"
+# include "boost/unordered_map.hpp"
 
 # include "utilmm/singleton/bits/dummy.hh"
 
@@ -23,23 +25,75 @@ namespace utilmm {
      * @author Frdric Py <fpy@laas.fr>
      */
     class server :public ::boost::noncopyable {
+    public:
+      /** @brief Hash of a singleton type name
+       *
+       * This is the hash stored in @c details::type_key. Registry
+       * lookups use the precomputed value so that they never have to
+       * build a @c std::string.
+       */
+      static size_t hash_name(char const *name, size_t length);
+
     private:
       server();
       ~server();
 
       static server &instance();
       
-      void attach(std::string const &name, details::dummy_factory const& factory);
-      bool detach(std::string const &name);
-
-      dummy *get(std::string const &name) const;
-
-      typedef std::map<std::string, dummy *> single_map;
+      void attach(details::type_key const &key, details::dummy_factory const& factory,
+                  details::instance_cache &cache);
+      bool detach(details::type_key const &key, details::instance_cache &cache);
+
+      dummy *get(details::type_key const &key) const;
+
+      /** @brief A registered singleton
+       *
+       * Along with the instance, we keep the client caches pointing to
+       * it and how many attachments each of them accounts for. A
+       * cache is cleared and forgotten as soon as its count drops to
+       * zero, so that we never write into the cache of an unloaded
+       * shared library.
+       */
+      struct entry {
+        typedef std::pair<details::instance_cache *, size_t> cache_ref;
+        typedef std::vector<cache_ref> cache_list;
+
+        dummy *instance;
+        cache_list caches;
+
+        void add_cache(details::instance_cache &cache);
+        void remove_cache(details::instance_cache &cache);
+      };
+
+      struct key_hash {
+        size_t operator()(std::string const &name) const {
+          return hash_name(name.data(), name.size());
+        }
+        size_t operator()(details::type_key const &key) const {
+          return key.hash;
+        }
+      };
+      struct key_equal {
+        bool operator()(std::string const &a, std::string const &b) const {
+          return a==b;
+        }
+        bool operator()(details::type_key const &a, std::string const &b) const {
+          return 0==std::strcmp(a.name, b.c_str());
+        }
+        bool operator()(std::string const &a, details::type_key const &b) const {
+          return 0==std::strcmp(a.c_str(), b.name);
+        }
+      };
+
+      typedef boost::unordered_map<std::string, entry,
+                                   key_hash, key_equal> single_map;
 
       single_map singletons;
 
       static server *the_instance;
 
+      // The mutex must be recursive: creating a singleton may attach
+      // the ones its constructor uses.
       typedef boost::recursive_mutex mutex_type;
       typedef mutex_type::scoped_lock lock_type;
 
@@ -2,9 +2,17 @@
 #include <utilmm/system/system.hh>
 
 #include "boost/thread/mutex.hpp"
+#include "boost/thread/condition_variable.hpp"
 
 #include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/time.h>
 #include <sys/wait.h>
+#ifdef HAVE_POSIX_SPAWN
+#include <spawn.h>
+#endif
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -14,6 +22,9 @@
 #include <stdio.h>
 
 #include <iostream>
+#include <sstream>
+#include <vector>
+#include <boost/lexical_cast.hpp>
 #include <boost/version.hpp>
 #include <boost/program_options.hpp>
 #include <boost/filesystem/exception.hpp>
@@ -48,48 +59,133 @@ namespace utilmm
     }
 }
 
+namespace utilmm { namespace details {
+    /** An element of the list of the running processes walked by
+     * killall(). A free slot has a pid of 0. The slots are never freed,
+     * so that the list can be walked from a signal handler while other
+     * threads add processes */
+    struct process_slot
+    {
+        boost::atomic<pid_t> pid;
+        process_slot* next;
+    };
+}}
+
 namespace
 {
-    char* const* stringlist_to_execlist(list<string>& strlist)
+    using utilmm::process;
+    using utilmm::details::process_slot;
+    using utilmm::unix_error;
+    using boost::mutex;
+
+    boost::atomic<process_slot*> process_slots(0);
+
+    /** Creates a pipe whose ends are closed on exec, so that they are
+     * not inherited by the processes other threads start */
+    void close_on_exec_pipe(int pipeno[2])
     {
-        char** ret = new char* [ strlist.size() + 1 ];
-        int i = 0;
-        for (list<string>::iterator it = strlist.begin(); it != strlist.end(); ++it)
-            ret[i++] = const_cast<char*>(it->c_str());
-        ret[ i ] = 0;
-        return ret;
+#ifdef __linux__
+        if (pipe2(pipeno, O_CLOEXEC) == -1)
+            throw unix_error();
+#else
+        if (pipe(pipeno) == -1)
+            throw unix_error();
+        fcntl(pipeno[0], F_SETFD, FD_CLOEXEC);
+        fcntl(pipeno[1], F_SETFD, FD_CLOEXEC);
+#endif
     }
 
-    using utilmm::process;
-    using boost::mutex;
-    
-    boost::mutex mtx_processes;
-    typedef std::list<process*> ProcessList;
-    typedef ProcessList::iterator       ProcessHandle;
-    std::list<process*> managed_processes;
-    
-    void register_process(process* process)
-    { 
-        sigset_t set, old_set;
-        sigemptyset(&set);
-        sigaddset(&set, SIGINT);
-        
-        sigprocmask(SIG_BLOCK, &set, &old_set);
-        managed_processes.push_back(process);
-        sigprocmask(SIG_SETMASK, &old_set, 0);
+    /** write() which fails with EPIPE instead of raising SIGPIPE if the
+     * reader closed the pipe */
+    ssize_t write_nosigpipe(int fd, char const* data, size_t size)
+    {
+        sigset_t sigpipe, old_mask, pending;
+        sigemptyset(&sigpipe);
+        sigaddset(&sigpipe, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &sigpipe, &old_mask);
+        sigpending(&pending);
+        bool was_pending = sigismember(&pending, SIGPIPE);
+
+        ssize_t result = write(fd, data, size);
+        if (result == -1 && errno == EPIPE && !was_pending)
+        {
+            // Discard the SIGPIPE raised by this write
+            sigpending(&pending);
+            int signo;
+            if (sigismember(&pending, SIGPIPE))
+                sigwait(&sigpipe, &signo);
+            errno = EPIPE;
+        }
+        pthread_sigmask(SIG_SETMASK, &old_mask, 0);
+        return result;
     }
-    
-    void deregister_process(process* process)
+
+    /** Finds a free slot for \c pid, or adds one */
+    process_slot* acquire_slot(pid_t pid)
+    {
+        for (process_slot* slot = process_slots.load(); slot; slot = slot->next)
+        {
+            pid_t expected = 0;
+            if (slot->pid.compare_exchange_strong(expected, pid))
+                return slot;
+        }
+
+        process_slot* slot = new process_slot;
+        slot->pid = pid;
+        slot->next = process_slots.load();
+        while (!process_slots.compare_exchange_weak(slot->next, slot));
+        return slot;
+    }
+
+    /** Wall-clock time in seconds since the epoch */
+    double wall_time()
+    {
+        timeval now;
+        gettimeofday(&now, 0);
+        return now.tv_sec + now.tv_usec * 1e-6;
+    }
+
+    void set_rusage(utilmm::resource_usage& usage, rusage const& from)
+    {
+        usage.user_time   = from.ru_utime.tv_sec + from.ru_utime.tv_usec * 1e-6;
+        usage.system_time = from.ru_stime.tv_sec + from.ru_stime.tv_usec * 1e-6;
+        usage.max_rss     = from.ru_maxrss;
+        // The block counts are in units of 512 bytes
+        usage.read_bytes  = static_cast<uint64_t>(from.ru_inblock) * 512;
+        usage.write_bytes = static_cast<uint64_t>(from.ru_oublock) * 512;
+    }
+
+    bool read_proc_file(string const& path, string& contents)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            return false;
+
+        char buffer[4096];
+        contents.clear();
+        ssize_t count;
+        while ((count = read(fd, buffer, sizeof(buffer))) > 0)
+            contents.append(buffer, count);
+        close(fd);
+        return count == 0;
+    }
+
+    /** The value following \c key in a /proc file made of "key: value"
+     * lines */
+    bool proc_value(string const& contents, char const* key, uint64_t& value)
     {
-        sigset_t set, old_set;
-        sigemptyset(&set);
-        sigaddset(&set, SIGINT);
-        
-        sigprocmask(SIG_BLOCK, &set, &old_set);
-        managed_processes.remove(process);
-        sigprocmask(SIG_SETMASK, &old_set, 0);
+        string::size_type pos = contents.find(key);
+        if (pos == string::npos)
+            return false;
+        value = strtoull(contents.c_str() + pos + strlen(key), 0, 10);
+        return true;
     }
 
+    /** Protects the exit status of the processes reaped by a
+     * process_manager */
+    boost::mutex mtx_reaped;
+    boost::condition_variable reaped_changed;
+
     RETSIGTYPE (*old_sigint_handler)(int) = 0;
     RETSIGTYPE sigint_handler(int signum)
     {
@@ -103,19 +199,25 @@ namespace
 
 using namespace utilmm;
 
+const int process::InvalidHandle;
+
 process::process()
-    : m_running(false), m_pid(0), m_normalexit(true), m_status(0), m_do_setpgid(false)
-{
-    register_process(this);
-}
+    : m_slot(0), m_running(false), m_managed(false), m_reaping(false), m_pid(0), m_normalexit(true), m_status(0)
+    , m_do_setpgid(false)
+#ifdef HAVE_POSIX_SPAWN
+    , m_launcher(Spawn)
+#else
+    , m_launcher(Fork)
+#endif
+{ }
 process::~process()
 {
-    deregister_process(this);
     if (m_running)
     {
         signal(); 
         wait(true);
     }
+    close_captures();
 }
 
 boost::filesystem::path process::workdir() const { return m_wdir; }
@@ -155,16 +257,25 @@ void process::install_sigint_handler()
 
 void process::killall()
 {
-    for (ProcessList::iterator it = managed_processes.begin(); it != managed_processes.end(); ++it)
-        kill((*it)->pid(), SIGINT);
+    for (process_slot* slot = process_slots.load(); slot; slot = slot->next)
+    {
+        pid_t pid = slot->pid.load();
+        if (pid > 0)
+            kill(pid, SIGINT);
+    }
+}
+void process::erase_redirection(Stream stream)
+{
+    get_stream(stream).close();
+    m_captured[stream].enabled = false;
 }
-void process::erase_redirection(Stream stream) { redirect_to(stream, ""); }
 void process::redirect_to( Stream stream, boost::filesystem::path const& file)
 {
+    int flags = (stream == Stdin) ? O_RDONLY : (O_WRONLY | O_CREAT | O_TRUNC);
 #if BOOST_VERSION >= 104600
-    int handle = open(file.string().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    int handle = open(file.string().c_str(), flags, 0666);
 #else
-    int handle = open(file.native_file_string().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    int handle = open(file.native_file_string().c_str(), flags, 0666);
 #endif
     if (handle == -1)
         throw unix_error();
@@ -188,12 +299,14 @@ void process::redirect_to( Stream stream, int handle, bool close_on_exit)
             throw unix_error();
     }
     get_stream(stream).reset(handle);
+    m_captured[stream].enabled = false;
 }
 
 process::output_file& process::get_stream(Stream stream)
 {
     switch(stream)
     {
+        case Stdin:  return m_stdin;
         case Stdout: return m_stdout;
         case Stderr: return m_stderr;
     }
@@ -209,18 +322,265 @@ void process::set_pgid(pid_t pgid)
     m_pgid = pgid;
 }
 
+void process::capture(Stream stream)
+{
+    get_stream(stream).close();
+    m_captured[stream].enabled = true;
+}
+int process::captured_fd(Stream stream) const { return m_captured[stream].fd; }
+void process::close_captured(Stream stream)
+{
+    captured_stream& captured = m_captured[stream];
+    if (captured.fd != InvalidHandle)
+        ::close(captured.fd);
+    captured.fd = InvalidHandle;
+}
+void process::set_input(std::string const& data)
+{
+    m_captured[Stdin].data = data;
+    capture(Stdin);
+}
+std::string const& process::output(Stream stream) const
+{ return m_captured[stream].data; }
+
+void process::open_captures()
+{
+    for (int stream = Stdin; stream <= Stderr; ++stream)
+    {
+        captured_stream& captured = m_captured[stream];
+        if (!captured.enabled)
+            continue;
+
+        int pipeno[2];
+        close_on_exec_pipe(pipeno);
+        // dup2() in the child clears FD_CLOEXEC on the child's end
+        int child_end  = (stream == Stdin) ? pipeno[0] : pipeno[1];
+        captured.fd    = (stream == Stdin) ? pipeno[1] : pipeno[0];
+        get_stream(Stream(stream)).reset(child_end);
+        fcntl(captured.fd, F_SETFL, O_NONBLOCK);
+    }
+}
+
+void process::close_captures()
+{
+    for (int stream = Stdin; stream <= Stderr; ++stream)
+    {
+        close_captured(Stream(stream));
+        if (stream != Stdin)
+            m_captured[stream].data.clear();
+        m_captured[stream].offset = 0;
+    }
+}
+
+bool process::write_input()
+{
+    captured_stream& input = m_captured[Stdin];
+    while (input.offset < input.data.size())
+    {
+        ssize_t count = write_nosigpipe(input.fd, input.data.data() + input.offset,
+                input.data.size() - input.offset);
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count == -1)
+            return errno == EAGAIN;
+        input.offset += count;
+    }
+    return false;
+}
+
+ssize_t process::read_captured(Stream stream, char* buffer, size_t size)
+{
+    ssize_t count;
+    do { count = read(m_captured[stream].fd, buffer, size); }
+    while (count == -1 && errno == EINTR);
+
+    if (count == -1)
+        return (errno == EAGAIN) ? -1 : 0;
+    return count;
+}
+
+void process::append_output(Stream stream, char const* data, size_t size)
+{ m_captured[stream].data.append(data, size); }
+
+void process::communicate()
+{
+    char buffer[65536];
+    while (true)
+    {
+        pollfd fds[3];
+        Stream streams[3];
+        int count = 0;
+        for (int stream = Stdin; stream <= Stderr; ++stream)
+        {
+            if (m_captured[stream].fd == InvalidHandle)
+                continue;
+            fds[count].fd      = m_captured[stream].fd;
+            fds[count].events  = (stream == Stdin) ? POLLOUT : POLLIN;
+            fds[count].revents = 0;
+            streams[count++]   = Stream(stream);
+        }
+        if (!count)
+            return;
+
+        if (poll(fds, count, -1) == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            throw unix_error();
+        }
+
+        for (int i = 0; i < count; ++i)
+        {
+            if (!fds[i].revents)
+                continue;
+
+            if (streams[i] == Stdin)
+            {
+                if (!write_input())
+                    close_captured(Stdin);
+                continue;
+            }
+
+            ssize_t read_count = read_captured(streams[i], buffer, sizeof(buffer));
+            if (read_count > 0)
+                append_output(streams[i], buffer, read_count);
+            else if (read_count == 0)
+                close_captured(streams[i]);
+        }
+    }
+}
+
+void process::set_launcher(Launcher launcher) { m_launcher = launcher; }
+process::Launcher process::launcher() const { return m_launcher; }
+
 static const int CHDIR_ERROR = 0;
 static const int EXEC_ERROR  = 1;
+static const int REDIRECT_ERROR = 2;
 void process::start()
 {
     if (running())
         throw already_running();
 
-    list<string> argv = m_cmdline;
-    Env          env  = m_env;
+    // Everything the child needs is prepared before it is created: the
+    // child of a multi-threaded program must not allocate memory
+    std::vector<char*> argv;
+    for (CommandLine::iterator it = m_cmdline.begin(); it != m_cmdline.end(); ++it)
+        argv.push_back(const_cast<char*>(it->c_str()));
+    argv.push_back(0);
+
+    // The environment of this process with the overriden variables
+    std::vector<string> env_strings;
+    std::vector<char*>  envp;
+    if (!m_env.empty())
+    {
+        for (char** var = environ; *var; ++var)
+        {
+            char const* equal = strchr(*var, '=');
+            string name = equal ? string(*var, equal - *var) : string(*var);
+            if (m_env.find(name) == m_env.end())
+                envp.push_back(*var);
+        }
+        for (Env::const_iterator it = m_env.begin(); it != m_env.end(); ++it)
+            env_strings.push_back(it->first + "=" + it->second);
+        for (size_t i = 0; i < env_strings.size(); ++i)
+            envp.push_back(const_cast<char*>(env_strings[i].c_str()));
+        envp.push_back(0);
+    }
+    char* const* env = m_env.empty() ? environ : &envp[0];
+
+    bool use_spawn = (m_launcher == Spawn) && m_env.find("PATH") == m_env.end();
+#ifndef HAVE_POSIX_SPAWN_ADDCHDIR
+    use_spawn = use_spawn && m_wdir.empty();
+#endif
+
+    close_captures();
+    try
+    {
+        open_captures();
+        if (use_spawn)
+            start_spawn(&argv[0], env);
+        else
+            start_fork(&argv[0], env);
+    }
+    catch(...)
+    {
+        close_captures();
+        throw;
+    }
+}
+
+#ifdef HAVE_POSIX_SPAWN
+namespace
+{
+    /** Destroys the posix_spawn() attributes */
+    struct spawn_guard
+    {
+        posix_spawn_file_actions_t actions;
+        posix_spawnattr_t attributes;
+
+        spawn_guard()
+        {
+            posix_spawn_file_actions_init(&actions);
+            posix_spawnattr_init(&attributes);
+        }
+        ~spawn_guard()
+        {
+            posix_spawn_file_actions_destroy(&actions);
+            posix_spawnattr_destroy(&attributes);
+        }
+    };
+}
+
+void process::start_spawn(char* const* argv, char* const* envp)
+{
+    spawn_guard spawn;
+    if (!m_stdin.is_null())
+        posix_spawn_file_actions_adddup2(&spawn.actions, m_stdin.handle<int>(), STDIN_FILENO);
+    if (!m_stdout.is_null())
+        posix_spawn_file_actions_adddup2(&spawn.actions, m_stdout.handle<int>(), STDOUT_FILENO);
+    if (!m_stderr.is_null())
+        posix_spawn_file_actions_adddup2(&spawn.actions, m_stderr.handle<int>(), STDERR_FILENO);
+#ifdef HAVE_POSIX_SPAWN_ADDCHDIR
+    string wdir = m_wdir.string();
+    if (!wdir.empty())
+        posix_spawn_file_actions_addchdir_np(&spawn.actions, wdir.c_str());
+#endif
+    if (m_do_setpgid)
+    {
+        posix_spawnattr_setflags(&spawn.attributes, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&spawn.attributes, m_pgid);
+    }
+
+    // The C library reports the errors of the file actions and of exec()
+    pid_t child_pid;
+    int error = posix_spawnp(&child_pid, argv[0], &spawn.actions, &spawn.attributes, argv, envp);
+
+    // close fds on the parent side
+    m_stdin.close();
+    m_stdout.close();
+    m_stderr.close();
+    if (error)
+        throw unix_error(error);
+
+    set_running(child_pid);
+}
+#else
+void process::start_spawn(char* const* argv, char* const* envp)
+{ start_fork(argv, envp); }
+#endif
+
+void process::start_fork(char* const* argv, char* const* envp)
+{
+#if BOOST_VERSION >= 104600
+    string wdir = m_wdir.string();
+#else
+    string wdir = m_wdir.native_file_string();
+#endif
 
+    // The pipe must not be inherited by the processes other threads
+    // start, or the read below would wait for them to finish
     int pc_comm[2];
-    pipe(pc_comm);
+    close_on_exec_pipe(pc_comm);
     auto_close read_guard(pc_comm[0]);
     auto_close write_guard(pc_comm[1]);
     
@@ -230,50 +590,43 @@ void process::start()
     else if (child_pid)
     {
         // close fds on the parent side
+        m_stdin.close();
         m_stdout.close();
         m_stderr.close();
         write_guard.close();
 
-        // wait for the exec() to happen
-        process_child_error(pc_comm[0]);
+        // wait for the exec() to happen. Reap the child if it failed
+        try { process_child_error(pc_comm[0]); }
+        catch(unix_error const&)
+        {
+            while (waitpid(child_pid, 0, 0) == -1 && errno == EINTR);
+            throw;
+        }
 
-        m_pid = child_pid;
-        m_running = true;
+        set_running(child_pid);
         return;
     }
     else
     {
         // in the child
-        char* const* exec_argv = stringlist_to_execlist(argv);
-        char* prog = exec_argv[0];
-
-        m_stdout.redirect(stdout);
-        m_stderr.redirect(stderr);
-        read_guard.close();
+        try
+        {
+            m_stdin.redirect(stdin);
+            m_stdout.redirect(stdout);
+            m_stderr.redirect(stderr);
+        }
+        catch(unix_error const&)
+        { send_child_error(pc_comm[1], REDIRECT_ERROR); }
 
 	if (m_do_setpgid)
 	    setpgid(0, m_pgid);
 
-        // must use execvp bec. we want exec to search for prog for us
-        // so, should set environment variables ourselves
-        for (Env::const_iterator it = env.begin(); it != env.end(); ++it)
-        {
-            std::string putenv_arg = (it->first + "=" + it->second);
-            putenv( strdup(putenv_arg.c_str()) );
-        }
-
-        if (!m_wdir.empty())
-        {
-#if BOOST_VERSION >= 104600
-            if (chdir(m_wdir.string().c_str()) == -1)
-#else
-            if (chdir(m_wdir.native_file_string().c_str()) == -1)
-#endif
-                send_child_error(pc_comm[1], CHDIR_ERROR);
-        }
+        if (!wdir.empty() && chdir(wdir.c_str()) == -1)
+            send_child_error(pc_comm[1], CHDIR_ERROR);
             
-        fcntl(pc_comm[1], F_SETFD, FD_CLOEXEC);
-        execvp(prog, exec_argv);
+        // execvp looks for the program in the PATH of the new environment
+        environ = const_cast<char**>(envp);
+        execvp(argv[0], argv);
 
         // Error if reached
         send_child_error(pc_comm[1], EXEC_ERROR);
@@ -296,17 +649,91 @@ void process::send_child_error(int fd, int error_type)
     int error = errno;
     write(fd, &error_type, sizeof(error_type));
     write(fd, &error, sizeof(error));
-    exit(1);
+    _exit(1);
 }
 
-void process::detach()
+void process::set_running(pid_t pid)
+{
+    // A process_pool starts the process from its worker thread, while
+    // signal() or pid() may be called from others
+    mutex::scoped_lock lock(mtx_reaped);
+    m_usage = resource_usage();
+    m_usage.start_time = wall_time();
+    m_reaping = false;
+    m_pid  = pid;
+    m_slot = acquire_slot(pid);
+    m_running = true;
+}
+
+void process::set_finished()
 {
+    if (m_slot)
+        m_slot->pid = 0;
+    m_slot = 0;
     m_running = false;
+}
+
+void process::reaped(int status, rusage const* usage)
+{
+    bool normal = WIFEXITED(status);
+    set_exit_status(normal, normal ? WEXITSTATUS(status) : 0, usage);
+}
+
+void process::set_exit_status(bool normal, int status, rusage const* usage)
+{
+    { mutex::scoped_lock lock(mtx_reaped);
+        m_normalexit = normal;
+        m_status  = status;
+        if (usage)
+            set_rusage(m_usage, *usage);
+        m_usage.exit_time = wall_time();
+        m_managed = false;
+        set_finished();
+    }
+    reaped_changed.notify_all();
+}
+
+void process::set_queued()
+{
+    close_captures();
+    mutex::scoped_lock lock(mtx_reaped);
+    m_pid = 0;
+    m_running = true;
+    m_managed = true;
+}
+
+void process::set_reaping()
+{
+    // killall() does not take the lock: the slot is released here so
+    // that it cannot signal the pid once it is reaped
+    mutex::scoped_lock lock(mtx_reaped);
+    m_reaping = true;
+    if (m_slot)
+        m_slot->pid = 0;
+    m_slot = 0;
+}
+
+void process::set_managed(bool managed)
+{
+    { mutex::scoped_lock lock(mtx_reaped);
+        m_managed = managed;
+    }
+    reaped_changed.notify_all();
+}
+
+void process::detach()
+{
+    mutex::scoped_lock lock(mtx_reaped);
+    set_finished();
     m_pid = 0;
 }
 void process::signal(int signo)
 { 
-    if (!running())
+    // A process queued in a process_pool has no pid yet. The lock makes
+    // sure that the pid is not reaped, and maybe reused, by another
+    // thread during the call (see set_reaping)
+    mutex::scoped_lock lock(mtx_reaped);
+    if (!running() || m_pid <= 0 || m_reaping)
         return;
 
     if (::kill(m_pid, signo) == 0)
@@ -319,11 +746,35 @@ void process::signal(int signo)
 void process::wait() { wait(true); }
 bool process::wait(bool hang)
 {
+    // The process_manager is the only one allowed to reap the process
+    if (m_managed)
+    {
+        boost::unique_lock<mutex> lock(mtx_reaped);
+        while (hang && m_running && m_managed)
+            reaped_changed.wait(lock);
+        if (m_managed || !m_running)
+            return !m_running;
+        // The manager has been destroyed: reap the process here
+    }
+
+    // Wait for the exit without reaping the process, so that signal()
+    // and sample_usage() in other threads stop using the pid first
+    siginfo_t info;
+    info.si_pid = 0;
+    int waitid_ret;
+    do
+    { waitid_ret = waitid(P_PID, m_pid, &info, WEXITED | WNOWAIT | (hang ? 0 : WNOHANG)); }
+    while (waitid_ret == -1 && errno == EINTR);
+    if (!hang && waitid_ret == 0 && info.si_pid == 0)
+        return false;
+    set_reaping();
+
     int status;
+    rusage usage;
 
     pid_t wait_ret = -1;
     do
-    { wait_ret = waitpid(m_pid, &status, (hang ? 0 : WNOHANG) ); }
+    { wait_ret = wait4(m_pid, &status, (hang ? 0 : WNOHANG), &usage); }
     while (wait_ret == -1 && errno == EINTR);
     
     if (!hang && wait_ret == 0)
@@ -333,10 +784,12 @@ bool process::wait(bool hang)
     // EINTR is taken care of
     // EINVAL is an internal error
 
-    m_running = false;
+    set_finished();
+    m_usage.exit_time = wall_time();
 
     if (wait_ret != -1) // no status information if wait_ret == -1
     {
+        set_rusage(m_usage, usage);
         m_normalexit = WIFEXITED(status);
         if (m_normalexit)
             m_status = WEXITSTATUS(status);
@@ -349,13 +802,68 @@ bool  process::exit_normal() const { return m_normalexit; }
 int   process::exit_status() const { return m_status; }
 bool  process::running()
 {
-    if (! m_running)
-        return false;
+    if (! m_running || m_managed)
+        return m_running;
 
     wait(false);
     return m_running; 
 }
-pid_t process::pid() const { return m_pid; }
+pid_t process::pid() const
+{
+    mutex::scoped_lock lock(mtx_reaped);
+    return m_pid;
+}
+resource_usage const& process::usage() const { return m_usage; }
+
+bool process::sample_usage(resource_usage& usage) const
+{
+#ifdef __linux__
+    // The lock is held while /proc is read, so that the process cannot be
+    // reaped and its pid reused meanwhile (see set_reaping)
+    mutex::scoped_lock lock(mtx_reaped);
+    if (!m_running || m_pid <= 0 || m_reaping)
+        return false;
+
+    string prefix = "/proc/" + boost::lexical_cast<string>(m_pid) + "/";
+    string contents;
+    if (!read_proc_file(prefix + "stat", contents))
+        return false;
+
+    // The command name may contain spaces and parenthesis. utime, stime,
+    // cutime and cstime are the fields 14 to 17, the state being the 3rd
+    string::size_type end = contents.rfind(')');
+    if (end == string::npos)
+        return false;
+    std::istringstream fields(contents.substr(end + 1));
+    string skipped;
+    for (int i = 3; i < 14; ++i)
+        fields >> skipped;
+    unsigned long utime, stime;
+    long cutime, cstime;
+    if (!(fields >> utime >> stime >> cutime >> cstime))
+        return false;
+
+    double ticks = sysconf(_SC_CLK_TCK);
+    usage = resource_usage();
+    usage.user_time   = (utime + cutime) / ticks;
+    usage.system_time = (stime + cstime) / ticks;
+    usage.start_time  = m_usage.start_time;
+
+    uint64_t value;
+    if (read_proc_file(prefix + "status", contents) && proc_value(contents, "VmHWM:", value))
+        usage.max_rss = value;
+    if (read_proc_file(prefix + "io", contents))
+    {
+        if (proc_value(contents, "\nread_bytes:", value))
+            usage.read_bytes = value;
+        if (proc_value(contents, "\nwrite_bytes:", value))
+            usage.write_bytes = value;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
 
 void process::set_environment(const std::string& key, const std::string& value)
 { m_env[key] = value; }
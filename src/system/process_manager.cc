@@ -0,0 +1,348 @@
+#include <utilmm/system/process_manager.hh>
+#include <utilmm/system/system.hh>
+
+#include <boost/bind.hpp>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace utilmm;
+
+namespace
+{
+    /** pidfd_open(2). The glibc wrapper only exists since 2.36 */
+    int pidfd_open(pid_t pid)
+    {
+#ifdef SYS_pidfd_open
+        return syscall(SYS_pidfd_open, pid, 0);
+#else
+        errno = ENOSYS;
+        return -1;
+#endif
+    }
+
+    /** The epoll data of the wakeup eventfd. The pidfd of a child uses
+     * its identifier, which is never zero, and its pipes stream_data() */
+    uint64_t const wakeup_data = 0;
+    uint64_t stream_data(uint32_t id, process::Stream stream)
+    { return static_cast<uint64_t>(id) | (static_cast<uint64_t>(stream + 1) << 32); }
+    /** The period at which the children without pidfd are checked, in ms */
+    int const polling_period = 10;
+}
+
+struct process_manager::child
+{
+    process_ptr process;
+    /** Only used to reap the child. The child may wait for its pipes long
+     * after, so the process stops using the pid before (see check()) */
+    pid_t pid;
+    exit_callback on_exit;
+    output_callback on_output;
+    int pidfd;
+    /** Set once the process is reaped, with its exit status */
+    bool exited;
+    int status;
+    rusage usage;
+    /** The count of captured streams which are still open */
+    int pipes;
+};
+
+process_manager::process_manager()
+    : m_next_id(0), m_polled(0), m_epoll(-1), m_wakeup(-1), m_stop(false)
+    , m_buffer(65536)
+{
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll == -1)
+        throw unix_error();
+    m_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_wakeup == -1)
+    {
+        int error = errno;
+        close(m_epoll);
+        throw unix_error(error);
+    }
+
+    epoll_event event = epoll_event();
+    event.events   = EPOLLIN;
+    event.data.u64 = wakeup_data;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &event);
+
+    m_thread = boost::thread(boost::bind(&process_manager::run, this));
+}
+
+process_manager::~process_manager()
+{
+    { boost::mutex::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    wakeup();
+    m_thread.join();
+
+    for (child_map::iterator it = m_children.begin(); it != m_children.end(); ++it)
+    {
+        // The pipes which are still open stay with the process
+        if (it->second->pidfd != -1)
+            close(it->second->pidfd);
+        if (it->second->exited)
+            it->second->process->reaped(it->second->status, &it->second->usage);
+        it->second->process->set_managed(false);
+    }
+    m_children.clear();
+    close(m_wakeup);
+    close(m_epoll);
+}
+
+void process_manager::start(process_ptr const& prs, exit_callback const& on_exit,
+        output_callback const& on_output)
+{
+    prs->set_managed(true);
+    try { prs->start(); }
+    catch(...)
+    {
+        prs->set_managed(false);
+        throw;
+    }
+
+    boost::shared_ptr<child> new_child(new child);
+    new_child->process = prs;
+    new_child->pid     = prs->pid();
+    new_child->on_exit = on_exit;
+    new_child->on_output = on_output;
+    new_child->exited  = false;
+    new_child->status  = 0;
+    new_child->pipes   = 0;
+
+    // A pidfd can be opened on a child which exited already, as long as
+    // it has not been reaped
+    new_child->pidfd = pidfd_open(new_child->pid);
+
+    bool polled = (new_child->pidfd == -1);
+    { boost::mutex::scoped_lock lock(m_mutex);
+        child_id id;
+        do { id = ++m_next_id; }
+        while (id == wakeup_data || m_children.count(id));
+        m_children[id] = new_child;
+        if (!polled)
+        {
+            epoll_event event = epoll_event();
+            event.events   = EPOLLIN;
+            event.data.u64 = id;
+            if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, new_child->pidfd, &event) == -1)
+            {
+                close(new_child->pidfd);
+                new_child->pidfd = -1;
+                polled = true;
+            }
+        }
+        if (polled)
+            ++m_polled;
+
+        for (int stream = process::Stdin; stream <= process::Stderr; ++stream)
+        {
+            int fd = prs->captured_fd(process::Stream(stream));
+            if (fd == process::InvalidHandle)
+                continue;
+
+            epoll_event event = epoll_event();
+            event.events   = (stream == process::Stdin) ? EPOLLOUT : EPOLLIN;
+            event.data.u64 = stream_data(id, process::Stream(stream));
+            if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) == -1)
+                prs->close_captured(process::Stream(stream));
+            else
+                ++new_child->pipes;
+        }
+    }
+
+    // Make the thread poll
+    if (polled)
+        wakeup();
+}
+
+std::size_t process_manager::size() const
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_children.size();
+}
+
+void process_manager::wait_all()
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (!m_children.empty())
+        m_changed.wait(lock);
+}
+
+void process_manager::signal_all(int signo)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    for (child_map::iterator it = m_children.begin(); it != m_children.end(); ++it)
+        it->second->process->signal(signo);
+}
+
+void process_manager::wakeup()
+{
+    uint64_t value = 1;
+    write(m_wakeup, &value, sizeof(value));
+}
+
+void process_manager::run()
+{
+    epoll_event events[64];
+    std::vector<child_id> polled;
+    while (true)
+    {
+        int timeout = -1;
+        { boost::mutex::scoped_lock lock(m_mutex);
+            if (m_stop)
+                return;
+            if (m_polled)
+                timeout = polling_period;
+        }
+
+        int count = epoll_wait(m_epoll, events, 64, timeout);
+        for (int i = 0; i < count; ++i)
+        {
+            if (events[i].data.u64 == wakeup_data)
+            {
+                uint64_t value;
+                read(m_wakeup, &value, sizeof(value));
+            }
+            else
+            {
+                child_id id = static_cast<child_id>(events[i].data.u64 & 0xffffffff);
+                int stream  = static_cast<int>(events[i].data.u64 >> 32) - 1;
+                if (stream < 0)
+                    check(id);
+                else
+                    transfer(id, process::Stream(stream));
+            }
+        }
+
+        if (timeout != -1)
+        {
+            polled.clear();
+            { boost::mutex::scoped_lock lock(m_mutex);
+                for (child_map::const_iterator it = m_children.begin(); it != m_children.end(); ++it)
+                {
+                    if (it->second->pidfd == -1 && !it->second->exited)
+                        polled.push_back(it->first);
+                }
+            }
+            for (size_t i = 0; i < polled.size(); ++i)
+                check(polled[i]);
+        }
+    }
+}
+
+void process_manager::check(child_id id)
+{
+    boost::shared_ptr<child> reaped;
+    { boost::mutex::scoped_lock lock(m_mutex);
+        child_map::const_iterator it = m_children.find(id);
+        if (it == m_children.end() || it->second->exited)
+            return;
+        reaped = it->second;
+    }
+
+    // The child is left a zombie until the process stops using its pid:
+    // it may otherwise be reused while the pipes are still open
+    siginfo_t info;
+    info.si_pid = 0;
+    int waited;
+    do { waited = waitid(P_PID, reaped->pid, &info, WEXITED | WNOHANG | WNOWAIT); }
+    while (waited == -1 && errno == EINTR);
+    if (waited == 0 && info.si_pid == 0)
+        return;
+    reaped->process->set_reaping();
+
+    int status = 0;
+    rusage usage;
+    pid_t result;
+    do { result = wait4(reaped->pid, &status, WNOHANG, &usage); }
+    while (result == -1 && errno == EINTR);
+    if (result == 0)
+        return;
+
+    // ECHILD means that someone else reaped the child: no status
+    // information is available then
+    if (result == -1)
+    {
+        status = 0;
+        memset(&usage, 0, sizeof(usage));
+    }
+    reaped->exited = true;
+    reaped->status = status;
+    reaped->usage  = usage;
+
+    { boost::mutex::scoped_lock lock(m_mutex);
+        if (reaped->pidfd != -1)
+        {
+            epoll_ctl(m_epoll, EPOLL_CTL_DEL, reaped->pidfd, 0);
+            close(reaped->pidfd);
+            reaped->pidfd = -1;
+        }
+        else
+            --m_polled;
+    }
+
+    if (!reaped->pipes)
+        finish(id, reaped);
+}
+
+void process_manager::transfer(child_id id, process::Stream stream)
+{
+    boost::shared_ptr<child> target;
+    { boost::mutex::scoped_lock lock(m_mutex);
+        child_map::const_iterator it = m_children.find(id);
+        if (it == m_children.end())
+            return;
+        target = it->second;
+    }
+
+    process& prs = *target->process;
+    int fd = prs.captured_fd(stream);
+    if (fd == process::InvalidHandle)
+        return;
+
+    bool open;
+    if (stream == process::Stdin)
+        open = prs.write_input();
+    else
+    {
+        ssize_t count = prs.read_captured(stream, &m_buffer[0], m_buffer.size());
+        if (count > 0)
+        {
+            if (target->on_output)
+                target->on_output(prs, stream, &m_buffer[0], count);
+            else
+                prs.append_output(stream, &m_buffer[0], count);
+        }
+        open = (count != 0);
+    }
+    if (open)
+        return;
+
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, 0);
+    prs.close_captured(stream);
+    if (!--target->pipes && target->exited)
+        finish(id, target);
+}
+
+void process_manager::finish(child_id id, boost::shared_ptr<child> const& finished)
+{
+    finished->process->reaped(finished->status, &finished->usage);
+    if (finished->on_exit)
+        finished->on_exit(*finished->process);
+
+    { boost::mutex::scoped_lock lock(m_mutex);
+        m_children.erase(id);
+    }
+    m_changed.notify_all();
+}
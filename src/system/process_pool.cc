@@ -0,0 +1,775 @@
+#include <utilmm/system/process_pool.hh>
+#include <utilmm/system/system.hh>
+
+#include <boost/bind.hpp>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+using namespace utilmm;
+using std::string;
+
+/* A job is sent to a helper as two uint32_t, the size of the payload and
+ * the count of strings in it, followed by the payload:
+ *
+ *   uint32_t flags, int32_t process group
+ *   uint32_t argc, then argc NUL-terminated strings
+ *   uint32_t envc, then envc NUL-terminated "NAME=value" strings
+ *   the NUL-terminated working directory, empty if there is none
+ *   uint32_t input size, then the input
+ *
+ * The file descriptors of the redirected streams are passed with the
+ * header. The helper answers with frames made of a uint32_t size, a
+ * frame_type and the data. The last frame is either Exited or Failed.
+ * Before reaping the command, the helper sends Exiting and waits for
+ * one byte from the pool, so that the pool stops signalling the pid
+ * before it can be reused.
+ *
+ * The helpers only use system calls and their own buffers: they are
+ * forked from a program which may have other threads, and never exec.
+ */
+
+namespace
+{
+    enum frame_type
+    {
+        /** The pid of the started command */
+        Started = 'p',
+        /** Data read from the standard output or error of the command */
+        Output  = 'o',
+        Error   = 'e',
+        /** The command exited, and is not reaped yet */
+        Exiting = 'z',
+        /** The wait() status of the command, followed by its rusage */
+        Exited  = 'x',
+        /** The errno value if the command could not be started */
+        Failed  = 'f'
+    };
+
+    /** The data of the Exited frame */
+    struct exit_frame
+    {
+        int status;
+        rusage usage;
+    };
+
+    /** The flags of a job. They are shifted by the stream number */
+    uint32_t const passed_fd   = 1;
+    uint32_t const captured    = 8;
+    uint32_t const set_pgid    = 64;
+
+    bool read_all(int fd, void* data, size_t size)
+    {
+        char* buffer = static_cast<char*>(data);
+        while (size)
+        {
+            ssize_t count = read(fd, buffer, size);
+            if (count == -1 && errno == EINTR)
+                continue;
+            if (count <= 0)
+                return false;
+            buffer += count;
+            size   -= count;
+        }
+        return true;
+    }
+
+    bool write_all(int fd, void const* data, size_t size)
+    {
+        char const* buffer = static_cast<char const*>(data);
+        while (size)
+        {
+            ssize_t count = write(fd, buffer, size);
+            if (count == -1 && errno == EINTR)
+                continue;
+            if (count == -1)
+                return false;
+            buffer += count;
+            size   -= count;
+        }
+        return true;
+    }
+
+    /** Creates a pipe whose ends are closed on exec. The helpers use it,
+     * so it reports errors through errno */
+    bool close_on_exec_pipe(int pipeno[2])
+    {
+#ifdef __linux__
+        return pipe2(pipeno, O_CLOEXEC) == 0;
+#else
+        if (pipe(pipeno) == -1)
+            return false;
+        fcntl(pipeno[0], F_SETFD, FD_CLOEXEC);
+        fcntl(pipeno[1], F_SETFD, FD_CLOEXEC);
+        return true;
+#endif
+    }
+
+    void append_u32(string& buffer, uint32_t value)
+    { buffer.append(reinterpret_cast<char const*>(&value), sizeof(value)); }
+
+    uint32_t take_u32(char*& cursor)
+    {
+        uint32_t value;
+        memcpy(&value, cursor, sizeof(value));
+        cursor += sizeof(value);
+        return value;
+    }
+
+    char* take_string(char*& cursor)
+    {
+        char* value = cursor;
+        cursor += strlen(cursor) + 1;
+        return value;
+    }
+
+    /** Sends a frame to the pool. The helper exits if the pool is gone */
+    void send_frame(int socket, char type, void const* data, uint32_t size)
+    {
+        char header[sizeof(uint32_t) + 1];
+        memcpy(header, &size, sizeof(size));
+        header[sizeof(size)] = type;
+        if (!write_all(socket, header, sizeof(header)) || !write_all(socket, data, size))
+            _exit(0);
+    }
+
+    /** Closes all the file descriptors except the standard streams and
+     * \c keep, which must be greater than 2 */
+    void close_other_fds(int keep)
+    {
+#if defined(__linux__) && defined(SYS_close_range)
+        if ((keep == 3 || syscall(SYS_close_range, 3, keep - 1, 0) == 0)
+                && syscall(SYS_close_range, keep + 1, ~0U, 0) == 0)
+            return;
+#endif
+        long max_fd = sysconf(_SC_OPEN_MAX);
+        if (max_fd < 0 || max_fd > 65536)
+            max_fd = 65536;
+        for (int fd = 3; fd < max_fd; ++fd)
+        {
+            if (fd != keep)
+                close(fd);
+        }
+    }
+
+    /** Reads the header of a job and the file descriptors passed with it
+     * @return false if the pool closed the socket */
+    bool receive_header(int socket, uint32_t* header, int* fds)
+    {
+        char control[CMSG_SPACE(3 * sizeof(int))];
+        iovec iov;
+        iov.iov_base = header;
+        iov.iov_len  = 2 * sizeof(uint32_t);
+        msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov        = &iov;
+        message.msg_iovlen     = 1;
+        message.msg_control    = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t count;
+        do { count = recvmsg(socket, &message, 0); }
+        while (count == -1 && errno == EINTR);
+        if (count <= 0)
+            return false;
+
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg))
+        {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                continue;
+            size_t fd_count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cmsg), (fd_count > 3 ? 3 : fd_count) * sizeof(int));
+            for (size_t i = 0; i < fd_count && i < 3; ++i)
+                fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+        }
+
+        return read_all(socket, reinterpret_cast<char*>(header) + count,
+                2 * sizeof(uint32_t) - count);
+    }
+
+    /** The buffer in which the helpers read the outputs */
+    char output_buffer[65536];
+    /** The disposition of SIGPIPE in the program, restored in the commands */
+    struct sigaction program_sigpipe;
+
+    /** Runs the job in \c payload. \c strings has room for the argv and
+     * envp arrays, and \c passed holds the descriptors received with the
+     * job */
+    void run_job(int socket, char* payload, char** strings, int* passed)
+    {
+        char* cursor  = payload;
+        uint32_t flags = take_u32(cursor);
+        pid_t pgid     = static_cast<pid_t>(take_u32(cursor));
+
+        uint32_t argc = take_u32(cursor);
+        char** argv = strings;
+        for (uint32_t i = 0; i < argc; ++i)
+            argv[i] = take_string(cursor);
+        argv[argc] = 0;
+
+        uint32_t envc = take_u32(cursor);
+        char** envp = argv + argc + 1;
+        for (uint32_t i = 0; i < envc; ++i)
+            envp[i] = take_string(cursor);
+        envp[envc] = 0;
+
+        char* wdir = take_string(cursor);
+        uint32_t input_size = take_u32(cursor);
+        char const* input   = cursor;
+
+        // The ends of the pipes and descriptors given to the command, and
+        // the ends of the pipes kept by the helper
+        int child_fds[3] = { -1, -1, -1 };
+        int pipes[3]     = { -1, -1, -1 };
+        int error_pipe[2] = { -1, -1 };
+        int next_passed = 0;
+        int error = 0;
+        for (int stream = 0; stream < 3; ++stream)
+        {
+            if (flags & (passed_fd << stream))
+                child_fds[stream] = passed[next_passed++];
+            else if ((flags & (captured << stream)) && !error)
+            {
+                int pipeno[2];
+                if (!close_on_exec_pipe(pipeno))
+                {
+                    error = errno;
+                    continue;
+                }
+                child_fds[stream] = (stream == 0) ? pipeno[0] : pipeno[1];
+                pipes[stream]     = (stream == 0) ? pipeno[1] : pipeno[0];
+            }
+        }
+
+        pid_t pid = -1;
+        if (!error && !close_on_exec_pipe(error_pipe))
+            error = errno;
+        // The helper is small, but vfork() still saves copying its page
+        // tables. The child shares the memory of the helper until exec,
+        // and only makes system calls. Setting environ does not matter
+        // as the helper does not use it
+        if (!error)
+        {
+            pid = vfork();
+            if (pid == -1)
+                error = errno;
+        }
+
+        if (pid == 0)
+        {
+            sigaction(SIGPIPE, &program_sigpipe, 0);
+            for (int stream = 0; stream < 3; ++stream)
+            {
+                if (child_fds[stream] != -1 && dup2(child_fds[stream], stream) == -1)
+                    goto failed;
+            }
+            if (flags & set_pgid)
+                setpgid(0, pgid);
+            if (*wdir && chdir(wdir) == -1)
+                goto failed;
+
+            environ = envp;
+            execvp(argv[0], argv);
+
+        failed:
+            error = errno;
+            write(error_pipe[1], &error, sizeof(error));
+            _exit(127);
+        }
+
+        for (int stream = 0; stream < 3; ++stream)
+        {
+            if (child_fds[stream] != -1)
+                close(child_fds[stream]);
+        }
+        if (error_pipe[1] != -1)
+            close(error_pipe[1]);
+        if (pid != -1 && read_all(error_pipe[0], &error, sizeof(error)))
+            while (waitpid(pid, 0, 0) == -1 && errno == EINTR);
+        if (error_pipe[0] != -1)
+            close(error_pipe[0]);
+
+        if (error)
+        {
+            for (int stream = 0; stream < 3; ++stream)
+            {
+                if (pipes[stream] != -1)
+                    close(pipes[stream]);
+            }
+            send_frame(socket, Failed, &error, sizeof(error));
+            return;
+        }
+        send_frame(socket, Started, &pid, sizeof(pid));
+
+        // Write the input and forward the outputs until the command
+        // closes its streams
+        if (pipes[0] != -1)
+        {
+            if (input_size)
+                fcntl(pipes[0], F_SETFL, O_NONBLOCK);
+            else
+            {
+                close(pipes[0]);
+                pipes[0] = -1;
+            }
+        }
+
+        uint32_t written = 0;
+        while (pipes[0] != -1 || pipes[1] != -1 || pipes[2] != -1)
+        {
+            pollfd fds[3];
+            int streams[3];
+            int count = 0;
+            for (int stream = 0; stream < 3; ++stream)
+            {
+                if (pipes[stream] == -1)
+                    continue;
+                fds[count].fd      = pipes[stream];
+                fds[count].events  = (stream == 0) ? POLLOUT : POLLIN;
+                fds[count].revents = 0;
+                streams[count++]   = stream;
+            }
+            if (poll(fds, count, -1) == -1)
+                continue;
+
+            for (int i = 0; i < count; ++i)
+            {
+                if (!fds[i].revents)
+                    continue;
+
+                int stream = streams[i];
+                bool closed = false;
+                if (stream == 0)
+                {
+                    ssize_t result = write(pipes[0], input + written, input_size - written);
+                    if (result > 0)
+                        written += result;
+                    closed = (written == input_size)
+                        || (result == -1 && errno != EINTR && errno != EAGAIN);
+                }
+                else
+                {
+                    ssize_t result = read(pipes[stream], output_buffer, sizeof(output_buffer));
+                    if (result > 0)
+                        send_frame(socket, (stream == 1) ? Output : Error, output_buffer, result);
+                    closed = (result == 0) || (result == -1 && errno != EINTR);
+                }
+
+                if (closed)
+                {
+                    close(pipes[stream]);
+                    pipes[stream] = -1;
+                }
+            }
+        }
+
+        siginfo_t info;
+        while (waitid(P_PID, pid, &info, WEXITED | WNOWAIT) == -1 && errno == EINTR);
+        send_frame(socket, Exiting, 0, 0);
+        char acknowledged;
+        if (!read_all(socket, &acknowledged, 1))
+            _exit(0);
+
+        exit_frame exited;
+        while (wait4(pid, &exited.status, 0, &exited.usage) == -1 && errno == EINTR);
+        send_frame(socket, Exited, &exited, sizeof(exited));
+    }
+
+    /** The loop of a helper. It never returns */
+    void helper_main(int socket)
+    {
+        // The handlers of the program must not run in the helper. Ignored
+        // signals stay ignored, as in the children of process::start()
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = SIG_DFL;
+        for (int signo = 1; signo < NSIG; ++signo)
+        {
+            struct sigaction old_action;
+            if (sigaction(signo, 0, &old_action) == -1)
+                continue;
+            if ((old_action.sa_flags & SA_SIGINFO) || old_action.sa_handler != SIG_IGN)
+                sigaction(signo, &action, 0);
+        }
+        sigaction(SIGCHLD, &action, 0);
+        sigset_t no_signals;
+        sigemptyset(&no_signals);
+        sigprocmask(SIG_SETMASK, &no_signals, 0);
+
+        // See EPIPE instead of dying if the pool is destroyed
+        action.sa_handler = SIG_IGN;
+        sigaction(SIGPIPE, &action, &program_sigpipe);
+
+        if (socket < 3)
+        {
+            socket = fcntl(socket, F_DUPFD, 3);
+            fcntl(socket, F_SETFD, FD_CLOEXEC);
+        }
+        close_other_fds(socket);
+
+        while (true)
+        {
+            uint32_t header[2];
+            int passed[3] = { -1, -1, -1 };
+            if (!receive_header(socket, header, passed))
+                _exit(0);
+
+            size_t pointers = header[1] * sizeof(char*);
+            size_t size = pointers + header[0];
+            void* area = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (area == MAP_FAILED)
+                _exit(1);
+
+            char* payload = static_cast<char*>(area) + pointers;
+            if (!read_all(socket, payload, header[0]))
+                _exit(0);
+            run_job(socket, payload, static_cast<char**>(area), passed);
+            munmap(area, size);
+        }
+    }
+
+    struct run_state
+    {
+        bool done;
+        int  error;
+    };
+
+    void run_finished(boost::mutex* mtx, run_state* state, process&, int error)
+    {
+        boost::mutex::scoped_lock lock(*mtx);
+        state->done  = true;
+        state->error = error;
+    }
+}
+
+process_pool::process_pool(std::size_t helper_count, std::size_t max_queued)
+    : m_max_queued(max_queued), m_pending(0), m_stop(false)
+{
+    if (helper_count == 0)
+        helper_count = boost::thread::hardware_concurrency();
+    if (helper_count == 0)
+        helper_count = 1;
+
+    // The helpers are forked before the threads of the pool exist
+    m_helpers.resize(helper_count);
+    try
+    {
+        for (std::size_t i = 0; i < helper_count; ++i)
+            spawn(m_helpers[i]);
+    }
+    catch(...)
+    {
+        for (std::size_t i = 0; i < helper_count; ++i)
+            stop(m_helpers[i]);
+        throw;
+    }
+
+    for (std::size_t i = 0; i < helper_count; ++i)
+        m_threads.create_thread(boost::bind(&process_pool::worker, this, i));
+}
+
+process_pool::~process_pool()
+{
+    { boost::mutex::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_changed.notify_all();
+    m_threads.join_all();
+
+    for (std::size_t i = 0; i < m_helpers.size(); ++i)
+        stop(m_helpers[i]);
+}
+
+std::size_t process_pool::size() const { return m_helpers.size(); }
+
+void process_pool::spawn(helper& h)
+{
+    int sockets[2];
+#ifdef SOCK_CLOEXEC
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) == -1)
+        throw unix_error();
+#else
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == -1)
+        throw unix_error();
+    fcntl(sockets[0], F_SETFD, FD_CLOEXEC);
+    fcntl(sockets[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        int error = errno;
+        close(sockets[0]);
+        close(sockets[1]);
+        throw unix_error(error);
+    }
+    else if (pid == 0)
+        helper_main(sockets[1]);
+
+    close(sockets[1]);
+    h.pid    = pid;
+    h.socket = sockets[0];
+}
+
+void process_pool::stop(helper& h)
+{
+    // The helper exits when it reads end-of-file
+    if (h.socket != -1)
+        close(h.socket);
+    if (h.pid)
+        while (waitpid(h.pid, 0, 0) == -1 && errno == EINTR);
+    h.socket = -1;
+    h.pid    = 0;
+}
+
+void process_pool::enqueue(job const& new_job)
+{
+    process& prs = *new_job.prs;
+    if (prs.running())
+        throw process::already_running();
+    prs.set_queued();
+
+    { boost::unique_lock<boost::mutex> lock(m_mutex);
+        while (m_max_queued && m_queue.size() >= m_max_queued)
+            m_changed.wait(lock);
+        m_queue.push_back(new_job);
+        ++m_pending;
+    }
+    m_changed.notify_all();
+}
+
+void process_pool::submit(process_ptr const& prs, exit_callback const& on_exit)
+{
+    job new_job;
+    new_job.prs     = prs.get();
+    new_job.owner   = prs;
+    new_job.on_exit = on_exit;
+    enqueue(new_job);
+}
+
+void process_pool::run(process& prs)
+{
+    run_state state = { false, 0 };
+    job new_job;
+    new_job.prs     = &prs;
+    new_job.on_exit = boost::bind(run_finished, &m_mutex, &state, _1, _2);
+    enqueue(new_job);
+
+    { boost::unique_lock<boost::mutex> lock(m_mutex);
+        while (!state.done)
+            m_changed.wait(lock);
+    }
+    if (state.error)
+        throw unix_error(state.error);
+}
+
+void process_pool::wait_all()
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (m_pending)
+        m_changed.wait(lock);
+}
+
+bool process_pool::execute(helper& h, job const& current, int& error)
+{
+    process& prs = *current.prs;
+
+    uint32_t flags = 0;
+    int fds[3];
+    int fd_count = 0;
+    for (int stream = process::Stdin; stream <= process::Stderr; ++stream)
+    {
+        process::output_file& redirection = prs.get_stream(process::Stream(stream));
+        if (!redirection.is_null())
+        {
+            flags |= passed_fd << stream;
+            fds[fd_count++] = redirection.handle<int>();
+        }
+        else if (prs.m_captured[stream].enabled)
+            flags |= captured << stream;
+    }
+    if (prs.m_do_setpgid)
+        flags |= set_pgid;
+
+    string payload;
+    append_u32(payload, flags);
+    append_u32(payload, prs.m_do_setpgid ? static_cast<uint32_t>(prs.m_pgid) : 0);
+
+    append_u32(payload, prs.m_cmdline.size());
+    for (process::CommandLine::const_iterator it = prs.m_cmdline.begin(); it != prs.m_cmdline.end(); ++it)
+        payload.append(it->c_str(), it->size() + 1);
+
+    // The environment of this process with the overriden variables
+    string environment;
+    uint32_t envc = 0;
+    for (char** var = environ; *var; ++var, ++envc)
+    {
+        char const* equal = strchr(*var, '=');
+        string name = equal ? string(*var, equal - *var) : string(*var);
+        if (prs.m_env.find(name) == prs.m_env.end())
+            environment.append(*var, strlen(*var) + 1);
+        else
+            --envc;
+    }
+    for (process::Env::const_iterator it = prs.m_env.begin(); it != prs.m_env.end(); ++it, ++envc)
+        environment += it->first + "=" + it->second + '\0';
+    append_u32(payload, envc);
+    payload += environment;
+
+    string wdir = prs.m_wdir.string();
+    payload.append(wdir.c_str(), wdir.size() + 1);
+
+    string const& input = prs.m_captured[process::Stdin].data;
+    bool has_input = (flags & (captured << process::Stdin));
+    append_u32(payload, has_input ? input.size() : 0);
+    if (has_input)
+        payload += input;
+
+    uint32_t header[2] = { static_cast<uint32_t>(payload.size()),
+        static_cast<uint32_t>(prs.m_cmdline.size() + envc + 2) };
+    iovec iov;
+    iov.iov_base = header;
+    iov.iov_len  = sizeof(header);
+    char control[CMSG_SPACE(3 * sizeof(int))];
+    msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov    = &iov;
+    message.msg_iovlen = 1;
+    if (fd_count)
+    {
+        memset(control, 0, sizeof(control));
+        message.msg_control    = control;
+        message.msg_controllen = CMSG_SPACE(fd_count * sizeof(int));
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type  = SCM_RIGHTS;
+        cmsg->cmsg_len   = CMSG_LEN(fd_count * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds, fd_count * sizeof(int));
+    }
+
+    ssize_t sent;
+    do { sent = sendmsg(h.socket, &message, MSG_NOSIGNAL); }
+    while (sent == -1 && errno == EINTR);
+    if (sent == -1)
+        return false;
+    if (!write_all(h.socket, reinterpret_cast<char*>(header) + sent, sizeof(header) - sent)
+            || !write_all(h.socket, payload.data(), payload.size()))
+        return false;
+
+    // close fds on the parent side
+    prs.m_stdin.close();
+    prs.m_stdout.close();
+    prs.m_stderr.close();
+
+    std::vector<char> data;
+    while (true)
+    {
+        char frame[sizeof(uint32_t) + 1];
+        if (!read_all(h.socket, frame, sizeof(frame)))
+            return false;
+        uint32_t size;
+        memcpy(&size, frame, sizeof(size));
+        data.resize(size + 1);
+        if (!read_all(h.socket, &data[0], size))
+            return false;
+
+        switch (frame[sizeof(size)])
+        {
+            case Started:
+            {
+                pid_t pid;
+                memcpy(&pid, &data[0], sizeof(pid));
+                prs.set_running(pid);
+                break;
+            }
+            case Output:
+                prs.append_output(process::Stdout, &data[0], size);
+                break;
+            case Error:
+                prs.append_output(process::Stderr, &data[0], size);
+                break;
+            case Exiting:
+            {
+                prs.set_reaping();
+                char acknowledge = 0;
+                ssize_t result;
+                do { result = send(h.socket, &acknowledge, 1, MSG_NOSIGNAL); }
+                while (result == -1 && errno == EINTR);
+                if (result != 1)
+                    return false;
+                break;
+            }
+            case Exited:
+            {
+                exit_frame exited;
+                memcpy(&exited, &data[0], sizeof(exited));
+                prs.reaped(exited.status, &exited.usage);
+                return true;
+            }
+            case Failed:
+                memcpy(&error, &data[0], sizeof(error));
+                return true;
+        }
+    }
+}
+
+void process_pool::worker(std::size_t index)
+{
+    helper& h = m_helpers[index];
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    for (;;)
+    {
+        while (m_queue.empty() && !m_stop)
+            m_changed.wait(lock);
+        if (m_queue.empty())
+            return;
+
+        job current = m_queue.front();
+        m_queue.pop_front();
+        lock.unlock();
+        // submit() may be waiting for room in the queue
+        m_changed.notify_all();
+
+        int error = 0;
+        bool finished = false;
+        if (h.socket == -1)
+        {
+            try { spawn(h); }
+            catch(unix_error const& e)
+            {
+                error = e.error();
+                finished = true;
+            }
+        }
+
+        if (!finished && !execute(h, current, error))
+        {
+            // The helper died. It is replaced for the next job, which
+            // forks the whole program, and the command is reported as
+            // killed
+            stop(h);
+        }
+        if (current.prs->running())
+            current.prs->set_exit_status(false, 0);
+        if (current.on_exit)
+            current.on_exit(*current.prs, error);
+
+        lock.lock();
+        --m_pending;
+        m_changed.notify_all();
+    }
+}
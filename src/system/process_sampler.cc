@@ -0,0 +1,83 @@
+#include <utilmm/system/process_sampler.hh>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <algorithm>
+
+using namespace utilmm;
+
+process_sampler::process_sampler(double period, sample_callback const& callback)
+    : m_period(period), m_callback(callback), m_stop(false)
+{
+    m_thread = boost::thread(boost::bind(&process_sampler::run, this));
+}
+
+process_sampler::~process_sampler()
+{
+    { boost::mutex::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_changed.notify_all();
+    m_thread.join();
+}
+
+void process_sampler::add(process_ptr const& prs)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    if (std::find(m_processes.begin(), m_processes.end(), prs) == m_processes.end())
+        m_processes.push_back(prs);
+}
+
+void process_sampler::remove(process_ptr const& prs)
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    m_processes.erase(std::remove(m_processes.begin(), m_processes.end(), prs),
+            m_processes.end());
+}
+
+std::size_t process_sampler::size() const
+{
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_processes.size();
+}
+
+void process_sampler::run()
+{
+    boost::posix_time::time_duration period =
+        boost::posix_time::microseconds(static_cast<long>(m_period * 1e6));
+    boost::system_time next = boost::get_system_time();
+
+    std::vector<process_ptr> processes, finished;
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (true)
+    {
+        next += period;
+        while (!m_stop && m_changed.timed_wait(lock, next));
+        if (m_stop)
+            return;
+
+        processes = m_processes;
+        lock.unlock();
+
+        finished.clear();
+        resource_usage usage;
+        for (std::size_t i = 0; i < processes.size(); ++i)
+        {
+            if (processes[i]->sample_usage(usage))
+                m_callback(*processes[i], usage);
+            else
+                finished.push_back(processes[i]);
+        }
+        processes.clear();
+
+        lock.lock();
+        for (std::size_t i = 0; i < finished.size(); ++i)
+            m_processes.erase(std::remove(m_processes.begin(), m_processes.end(), finished[i]),
+                    m_processes.end());
+
+        // Do not try to catch up if the callbacks took too long
+        boost::system_time now = boost::get_system_time();
+        if (next < now)
+            next = now;
+    }
+}
@@ -0,0 +1,257 @@
+#include <utilmm/system/reactor.hh>
+#include <utilmm/system/socket.hh>
+#include <utilmm/system/system.hh>
+
+#include <cmath>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace utilmm;
+
+namespace
+{
+    double monotonic_time()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    /** The epoll data of the wakeup eventfd. The descriptors use their
+     * number and the generation of their handler */
+    uint64_t const wakeup_data = ~static_cast<uint64_t>(0);
+
+    uint32_t to_epoll(int events, bool edge_triggered)
+    {
+        uint32_t result = EPOLLRDHUP;
+        if (events & reactor::Read)
+            result |= EPOLLIN | EPOLLPRI;
+        if (events & reactor::Write)
+            result |= EPOLLOUT;
+        if (edge_triggered)
+            result |= EPOLLET;
+        return result;
+    }
+
+    int from_epoll(uint32_t events)
+    {
+        int result = 0;
+        if (events & (EPOLLIN | EPOLLPRI))
+            result |= reactor::Read;
+        if (events & EPOLLOUT)
+            result |= reactor::Write;
+        if (events & (EPOLLHUP | EPOLLRDHUP))
+            result |= reactor::Hangup;
+        if (events & EPOLLERR)
+            result |= reactor::Error;
+        return result;
+    }
+}
+
+reactor::reactor()
+    : m_epoll(-1), m_wakeup(-1), m_stop(false), m_count(0), m_generation(0)
+    , m_next_timer(0)
+{
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll == -1)
+        throw unix_error("cannot create the epoll descriptor");
+    m_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_wakeup == -1)
+    {
+        int error = errno;
+        close(m_epoll);
+        throw unix_error("cannot create the wakeup descriptor", error);
+    }
+
+    epoll_event event = epoll_event();
+    event.events   = EPOLLIN;
+    event.data.u64 = wakeup_data;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &event);
+}
+
+reactor::~reactor()
+{
+    close(m_wakeup);
+    close(m_epoll);
+}
+
+void reactor::control(int operation, int fd, handler const& h)
+{
+    epoll_event event = epoll_event();
+    event.events   = to_epoll(h.events, h.edge_triggered);
+    event.data.u64 = static_cast<uint32_t>(fd) | (static_cast<uint64_t>(h.generation) << 32);
+    if (epoll_ctl(m_epoll, operation, fd, &event) == -1)
+        throw unix_error("cannot watch the file descriptor");
+}
+
+void reactor::add(int fd, int events, io_callback const& callback, bool edge_triggered)
+{
+    if (fd < 0)
+        throw unix_error("cannot watch the file descriptor", EBADF);
+    if (contains(fd))
+        throw unix_error("cannot watch the file descriptor", EEXIST);
+
+    handler_ptr h(new handler);
+    h->callback       = callback;
+    h->events         = events;
+    h->edge_triggered = edge_triggered;
+    // 0xffffffff is the generation of the wakeup descriptor
+    if (++m_generation == 0xffffffff)
+        m_generation = 0;
+    h->generation     = m_generation;
+    control(EPOLL_CTL_ADD, fd, *h);
+
+    if (m_handlers.size() <= static_cast<std::size_t>(fd))
+        m_handlers.resize(fd + 1);
+    m_handlers[fd] = h;
+    ++m_count;
+}
+
+void reactor::add(base_socket const& socket, int events, io_callback const& callback, bool edge_triggered)
+{ add(socket.fd(), events, callback, edge_triggered); }
+
+void reactor::modify(int fd, int events)
+{
+    if (!contains(fd))
+        throw unix_error("cannot watch the file descriptor", ENOENT);
+    handler& h = *m_handlers[fd];
+    h.events = events;
+    control(EPOLL_CTL_MOD, fd, h);
+}
+
+void reactor::remove(int fd)
+{
+    if (!contains(fd))
+        return;
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, 0);
+    m_handlers[fd].reset();
+    --m_count;
+}
+
+bool reactor::contains(int fd) const
+{ return fd >= 0 && static_cast<std::size_t>(fd) < m_handlers.size() && m_handlers[fd]; }
+std::size_t reactor::size() const { return m_count; }
+
+reactor::timer_id reactor::add_timer(double delay, timer_callback const& callback, double period)
+{
+    timer_id id = ++m_next_timer;
+    timer& t = m_timers[id];
+    t.deadline = monotonic_time() + delay;
+    t.period   = period;
+    t.callback = callback;
+    m_deadlines.insert(std::make_pair(t.deadline, id));
+    return id;
+}
+
+void reactor::cancel_timer(timer_id id)
+{
+    timer_map::iterator it = m_timers.find(id);
+    if (it == m_timers.end())
+        return;
+    m_deadlines.erase(std::make_pair(it->second.deadline, id));
+    m_timers.erase(it);
+}
+
+std::size_t reactor::run_timers()
+{
+    double now = monotonic_time();
+    std::vector<timer_id> due;
+    for (std::set< std::pair<double, timer_id> >::const_iterator it = m_deadlines.begin();
+            it != m_deadlines.end() && it->first <= now; ++it)
+        due.push_back(it->second);
+
+    // The callbacks may cancel the timers which are due after them
+    std::size_t called = 0;
+    for (std::size_t i = 0; i < due.size(); ++i)
+    {
+        timer_map::iterator it = m_timers.find(due[i]);
+        if (it == m_timers.end())
+            continue;
+
+        timer_callback callback = it->second.callback;
+        m_deadlines.erase(std::make_pair(it->second.deadline, due[i]));
+        if (it->second.period > 0)
+        {
+            // Periodic timers do not try to catch up
+            timer& t = it->second;
+            t.deadline += t.period;
+            if (t.deadline <= now)
+                t.deadline = now + t.period;
+            m_deadlines.insert(std::make_pair(t.deadline, due[i]));
+        }
+        else
+            m_timers.erase(it);
+
+        callback();
+        ++called;
+    }
+    return called;
+}
+
+std::size_t reactor::run_once(double timeout)
+{
+    int wait_ms = -1;
+    if (!m_deadlines.empty())
+    {
+        double remaining = m_deadlines.begin()->first - monotonic_time();
+        wait_ms = (remaining <= 0) ? 0 : static_cast<int>(std::ceil(remaining * 1000));
+    }
+    if (timeout >= 0)
+    {
+        int timeout_ms = static_cast<int>(std::ceil(timeout * 1000));
+        if (wait_ms < 0 || timeout_ms < wait_ms)
+            wait_ms = timeout_ms;
+    }
+
+    epoll_event events[256];
+    int count = epoll_wait(m_epoll, events, 256, wait_ms);
+    if (count == -1)
+    {
+        if (errno != EINTR)
+            throw unix_error("error while waiting for events");
+        count = 0;
+    }
+
+    std::size_t called = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        uint64_t data = events[i].data.u64;
+        if (data == wakeup_data)
+        {
+            uint64_t value;
+            read(m_wakeup, &value, sizeof(value));
+            continue;
+        }
+
+        // The handler may have been removed or replaced by a callback
+        // called before in this iteration
+        int fd = static_cast<int>(data & 0xffffffff);
+        if (!contains(fd))
+            continue;
+        handler_ptr h = m_handlers[fd];
+        if (h->generation != static_cast<uint32_t>(data >> 32))
+            continue;
+
+        h->callback(fd, from_epoll(events[i].events));
+        ++called;
+    }
+
+    return called + run_timers();
+}
+
+void reactor::run()
+{
+    while (!m_stop)
+        run_once();
+    m_stop = false;
+}
+
+void reactor::stop()
+{
+    m_stop = true;
+    uint64_t value = 1;
+    write(m_wakeup, &value, sizeof(value));
+}
@@ -12,7 +12,9 @@
 #include <netinet/in.h> 
 #include <netinet/ip.h> 
 #include <sys/time.h>
-#include <sys/select.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 
 #include <iostream>
 
@@ -122,6 +124,32 @@ namespace utilmm
     }
 
     int base_socket::fd() const { return m_fd; }
+
+    void base_socket::set_nonblocking(bool enable)
+    {
+	int flags = fcntl(m_fd, F_GETFL);
+	if (flags == -1)
+	    throw unix_error("cannot get the socket flags");
+	flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+	if (fcntl(m_fd, F_SETFL, flags) == -1)
+	    throw unix_error("cannot set the socket flags");
+    }
+    bool base_socket::nonblocking() const
+    {
+	int flags = fcntl(m_fd, F_GETFL);
+	if (flags == -1)
+	    throw unix_error("cannot get the socket flags");
+	return flags & O_NONBLOCK;
+    }
+    int base_socket::pending_error() const
+    {
+	int error = 0;
+	socklen_t size = sizeof(error);
+	if (getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &error, &size) == -1)
+	    throw unix_error("cannot get the socket error");
+	return error;
+    }
+
     bool base_socket::try_wait(int what) const
     {
 	timeval tv = { 0, 0 };
@@ -130,28 +158,19 @@ namespace utilmm
     void base_socket::wait(int what) const { wait(what, 0); }
     int base_socket::wait(int what, timeval* tv) const
     {
-	fd_set rd_set, wr_set, exc_set;
-	fd_set *rd_p = 0, *wr_p = 0, *exc_p = 0;
+	pollfd pfd;
+	pfd.fd = m_fd;
+	pfd.events = 0;
+	pfd.revents = 0;
 	if (what & WaitRead)
-	{
-	    FD_ZERO(&rd_set);
-	    FD_SET(fd(), &rd_set);
-	    rd_p = &rd_set;
-	}
+	    pfd.events |= POLLIN;
 	if (what & WaitWrite)
-	{
-	    FD_ZERO(&wr_set);
-	    FD_SET(fd(), &wr_set);
-	    wr_p = &wr_set;
-	}
+	    pfd.events |= POLLOUT;
 	if (what & WaitException)
-	{
-	    FD_ZERO(&exc_set);
-	    FD_SET(fd(), &exc_set);
-	    exc_p = &exc_set;
-	}
+	    pfd.events |= POLLPRI;
 
-	int ret = select(m_fd + 1, rd_p, wr_p, exc_p, tv);
+	int timeout = tv ? tv->tv_sec * 1000 + tv->tv_usec / 1000 : -1;
+	int ret = poll(&pfd, 1, timeout);
 	if (ret == -1)
 	    throw unix_error("error while waiting for socket");
 	return ret;
@@ -166,25 +185,56 @@ namespace utilmm
     { connect(connect_to); }
     socket::socket(int _fd)
 	: base_socket(_fd) {}
+    socket::socket(Domain domain, Type type)
+	: base_socket(domain, type) {}
 
     void socket::connect(std::string const& to)
     {
 	vector<uint8_t> addr = to_sockaddr(to);
 	if (::connect(fd(), reinterpret_cast<sockaddr*>(&addr[0]), addr.size()) == -1)
+	{
+	    // The connection of non-blocking sockets is finished later. Unix
+	    // sockets fail with EAGAIN instead if the backlog of the server
+	    // is full, and the connection must be retried
+	    if (errno == EINPROGRESS)
+		return;
 	    throw unix_error("cannot connect to " + to);
+	}
     }
     int socket::read(void* buf, size_t size) const
     {
-	int read_bytes = ::read(fd(), buf, size);
+	int read_bytes;
+	do { read_bytes = ::read(fd(), buf, size); }
+	while (read_bytes == -1 && errno == EINTR);
 	if (read_bytes == -1)
+	{
+	    if (errno == EAGAIN || errno == EWOULDBLOCK)
+		return -1;
 	    throw unix_error("cannot read on socket");
+	}
 	return read_bytes;
     }
     int socket::write(void const* buf, size_t size) const
     {
-	int written = ::write(fd(), buf, size);
+	// A peer closing the connection makes write() fail with EPIPE
+	// instead of raising SIGPIPE. send() only works on sockets, fall
+	// back to write() on other file descriptors
+#ifdef MSG_NOSIGNAL
+	int const flags = MSG_NOSIGNAL;
+#else
+	int const flags = 0;
+#endif
+	int written;
+	do { written = ::send(fd(), buf, size, flags); }
+	while (written == -1 && errno == EINTR);
+	if (written == -1 && errno == ENOTSOCK)
+	    written = ::write(fd(), buf, size);
 	if (written == -1)
+	{
+	    if (errno == EAGAIN || errno == EWOULDBLOCK)
+		return -1;
 	    throw unix_error("cannot write on socket");
+	}
 	return written;
     }
 
@@ -214,11 +264,31 @@ namespace utilmm
 
     socket* server_socket::accept() const
     {
-	int sock_fd = ::accept(fd(), NULL, NULL);
+	bool is_nonblocking = nonblocking();
+	int sock_fd;
+	do
+	{
+#ifdef SOCK_NONBLOCK
+	    sock_fd = ::accept4(fd(), NULL, NULL, is_nonblocking ? SOCK_NONBLOCK : 0);
+#else
+	    sock_fd = ::accept(fd(), NULL, NULL);
+#endif
+	}
+	while (sock_fd == -1 && errno == EINTR);
+
 	if (sock_fd == -1)
+	{
+	    if (is_nonblocking && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return 0;
 	    throw unix_error("failed in accept()");
+	}
 
-	return new socket(sock_fd);
+	socket* result = new socket(sock_fd);
+#ifndef SOCK_NONBLOCK
+	if (is_nonblocking)
+	    result->set_nonblocking(true);
+#endif
+	return result;
     }
 }
 
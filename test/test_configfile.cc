@@ -3,9 +3,18 @@
 #include "testsuite.hh"
 #include <utilmm/configfile/configfile.hh>
 #include <utilmm/configfile/commandline.hh>
+#ifdef __linux__
+#include <utilmm/configfile/reloadable_config.hh>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/bind.hpp>
+#endif
 #include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
 #include <utilmm/stringtools.hh>
 #include <algorithm>
+#include <fstream>
+#include <boost/next_prior.hpp>
+#include <stdlib.h>
 
 using namespace utilmm;
 using namespace boost::filesystem;
@@ -82,6 +91,405 @@ BOOST_AUTO_TEST_CASE( test_child )
     BOOST_REQUIRE(not_a_child.empty());
 }
 
+/** Writes \c contents in a temporary file and parses it */
+auto_ptr<config_file> parse_string(string const& contents,
+        config_file::load_mode mode = config_file::ReadFile)
+{
+    path file = temp_directory_path() / unique_path("utilmm-%%%%-%%%%.config");
+    { ofstream out(file.string().c_str());
+        out << contents;
+    }
+
+    try
+    {
+        auto_ptr<config_file> result(new config_file(file.string(), mode));
+        remove(file);
+        return result;
+    }
+    catch(...)
+    {
+        remove(file);
+        throw;
+    }
+}
+
+/** Parses \c contents, expecting a parse error at \c line */
+void check_parse_error(string const& contents, int line, string const& message)
+{
+    config_file::load_mode modes[] = { config_file::ReadFile, config_file::MapFile };
+    for (int i = 0; i < 2; ++i)
+    {
+        try
+        {
+            parse_string(contents, modes[i]);
+            BOOST_FAIL("no parse error in " + contents);
+        }
+        catch(parse_error const& e)
+        {
+            BOOST_REQUIRE_EQUAL(line, e.line);
+            BOOST_REQUIRE_EQUAL(message, e.message);
+        }
+    }
+}
+
+void check_syntax(config_file::load_mode mode)
+{
+    auto_ptr<config_file> config = parse_string(
+            "\n"
+            "  # comment\n"
+            "\tkey_1-a:\tvalue # comment\n"
+            "trailing:  value  \n"
+            "blank:   \n"
+            "colon: a: b\n"
+            "inline_child {  # comment\n"
+            "  key: inline\n"
+            "  }\n"
+            "child\n"
+            "\n"
+            "{\n"
+            "  key: 1\n"
+            "  key: 2\n"
+            "  grandchild {\n"
+            "  }\n"
+            "}\n"
+            "last: no newline", mode);
+
+    BOOST_REQUIRE_EQUAL("value ", config->get<string>("key_1-a"));
+    // Trailing blanks are part of the value, and a blank-only value is
+    // its last blank
+    BOOST_REQUIRE_EQUAL("value  ", config->get<string>("trailing"));
+    BOOST_REQUIRE_EQUAL(" ", config->get<string>("blank"));
+    BOOST_REQUIRE_EQUAL("a: b", config->get<string>("colon"));
+    BOOST_REQUIRE_EQUAL("no newline", config->get<string>("last"));
+
+    BOOST_REQUIRE_EQUAL("inline", config->child("inline_child").get<string>("key"));
+    config_set const& child = config->child("child");
+    BOOST_REQUIRE_EQUAL(2UL, child.get< list<int> >("key").size());
+    BOOST_REQUIRE(child.exists("grandchild"));
+    BOOST_REQUIRE(child.child("grandchild").empty());
+    BOOST_REQUIRE(child.parent() == config.get());
+
+    BOOST_REQUIRE(parse_string("", mode).get()->empty());
+    BOOST_REQUIRE(parse_string("\n\n# only comments\n", mode).get()->empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_syntax )
+{
+    check_syntax(config_file::ReadFile);
+    check_syntax(config_file::MapFile);
+}
+
+BOOST_AUTO_TEST_CASE( test_mapped_file )
+{
+    path testdir = path(__FILE__).branch_path();
+    config_file config((testdir / "test_configfile.config").string(), config_file::MapFile);
+    BOOST_REQUIRE_EQUAL("a string", config.get<string>("str"));
+    BOOST_REQUIRE_EQUAL(10UL, config.get< list<int> >("list").size());
+    BOOST_REQUIRE_EQUAL("another string", config.child("child").get<string>("str"));
+
+    // Modified values are copied
+    {
+        string value("modified");
+        config.set("str", value);
+        config.insert("list", "10");
+    }
+    BOOST_REQUIRE_EQUAL("modified", config.get<string>("str"));
+    BOOST_REQUIRE_EQUAL(11UL, config.get< list<int> >("list").size());
+
+    BOOST_REQUIRE_THROW(config_file("does_not_exist.config", config_file::MapFile), not_found);
+}
+
+BOOST_AUTO_TEST_CASE( test_syntax_errors )
+{
+    check_parse_error("a: 1\nkey  \n", 2, "expected 'key: value', found key  ");
+    check_parse_error("key # comment", 1, "expected 'key: value', found key ");
+    check_parse_error("key:\n", 1, "expected 'key: value', found key:");
+    check_parse_error("key = 1\n", 1, "expected 'key: value', found key = 1");
+    check_parse_error("\n  = 1 # c\n", 2, "expected \"key: value\", found   = 1 # c");
+    check_parse_error("child\n\nkey: 1\n", 3, "expected '{', found key: 1");
+    check_parse_error("child\n", 2, "expected '{', got end of file");
+    check_parse_error("child", 1, "expected '{', got end of file");
+    check_parse_error("child {\n\n", 3, "expected '}' before end of file");
+    check_parse_error("a: 1\n} # c\n", 2, "unmatched bracket");
+    check_parse_error("a: 1\n} }\n", 2, "expected \"key: value\", found } }");
+}
+
+BOOST_AUTO_TEST_CASE( test_cached_file )
+{
+    path cache_dir = temp_directory_path() / unique_path("utilmm-cache-%%%%-%%%%");
+    setenv("UTILMM_CONFIG_CACHE", cache_dir.string().c_str(), 1);
+    path source = temp_directory_path() / unique_path("utilmm-%%%%-%%%%.config");
+    copy_file(path(__FILE__).branch_path() / "test_configfile.config", source);
+
+    string cache = config_file::cache_path(source.string());
+    BOOST_REQUIRE(path(cache).parent_path() == cache_dir);
+
+    // The first load parses the file and fills the cache
+    { config_file config(source.string(), config_file::Cached);
+        BOOST_REQUIRE_EQUAL("a string", config.get<string>("str"));
+    }
+    BOOST_REQUIRE(exists(cache));
+
+    // Check that the cache is used while the source does not change
+    { config_file config(source.string());
+        config.set("str", "from cache");
+        config.compile(cache);
+    }
+    { config_file config(source.string(), config_file::Cached);
+        BOOST_REQUIRE_EQUAL("from cache", config.get<string>("str"));
+        BOOST_REQUIRE_EQUAL(10UL, config.get< list<int> >("list").size());
+        BOOST_REQUIRE_EQUAL("another string", config.lookup("child")->get<string>("str"));
+        BOOST_REQUIRE_EQUAL(config.lookup("child")->parent(), &config);
+    }
+
+    // ... and is updated once it changes
+    last_write_time(source, last_write_time(source) + 10);
+    { config_file config(source.string(), config_file::Cached);
+        BOOST_REQUIRE_EQUAL("a string", config.get<string>("str"));
+    }
+    { config_file config(source.string(), config_file::Cached);
+        BOOST_REQUIRE_EQUAL("a string", config.get<string>("str"));
+    }
+
+    // Invalid cache files are ignored
+    resize_file(cache, file_size(cache) - 1);
+    { config_file config(source.string(), config_file::Cached);
+        BOOST_REQUIRE_EQUAL("a string", config.get<string>("str"));
+    }
+
+    remove(source);
+    BOOST_REQUIRE_THROW(config_file(source.string(), config_file::Cached), not_found);
+    remove_all(cache_dir);
+    unsetenv("UTILMM_CONFIG_CACHE");
+}
+
+BOOST_AUTO_TEST_CASE( test_cache_directory )
+{
+    char const* saved_home = getenv("HOME");
+    string home = saved_home ? saved_home : "";
+    char const* saved_xdg = getenv("XDG_CACHE_HOME");
+    string xdg = saved_xdg ? saved_xdg : "";
+
+    // Relative directories are not used
+    setenv("XDG_CACHE_HOME", "relative", 1);
+    setenv("HOME", "/home/user", 1);
+    BOOST_REQUIRE_EQUAL("/home/user/.cache/utilmm", config_file::cache_directory());
+    setenv("HOME", "relative", 1);
+    BOOST_REQUIRE(config_file::cache_directory().empty() || path(config_file::cache_directory()).is_absolute());
+    unsetenv("HOME");
+    BOOST_REQUIRE(config_file::cache_directory().empty() || path(config_file::cache_directory()).is_absolute());
+
+    if (saved_home) setenv("HOME", home.c_str(), 1);
+    if (saved_xdg) setenv("XDG_CACHE_HOME", xdg.c_str(), 1);
+    else unsetenv("XDG_CACHE_HOME");
+}
+
+BOOST_AUTO_TEST_CASE( test_config_set )
+{
+    config_set config;
+    config.insert("b", "1");
+    config.insert("a", "2");
+    config.insert("c", "3");
+    config.insert("b", "4");
+    config.insert("b", "5");
+
+    // Values of the same key are kept in insertion order, and the
+    // scalar get returns the first one
+    list<int> b = config.get< list<int> >("b");
+    BOOST_REQUIRE_EQUAL(3UL, b.size());
+    BOOST_REQUIRE_EQUAL(1, b.front());
+    BOOST_REQUIRE_EQUAL(5, b.back());
+    BOOST_REQUIRE_EQUAL(1, config.get<int>("b"));
+    BOOST_REQUIRE_EQUAL(2, config.get<int>("a"));
+    BOOST_REQUIRE_EQUAL(42, config.get<int>("d", 42));
+    BOOST_REQUIRE_EQUAL("3", config.get<string>(string("c")));
+    BOOST_REQUIRE_THROW(config.get<bool>("c"), boost::bad_lexical_cast);
+
+    config.set("b", "6");
+    BOOST_REQUIRE_EQUAL(1UL, config.get< list<int> >("b").size());
+    BOOST_REQUIRE_EQUAL(6, config.get<int>("b"));
+
+    config.erase("a");
+    BOOST_REQUIRE(!config.exists("a"));
+    BOOST_REQUIRE(config.exists("b"));
+    BOOST_REQUIRE(config.exists("c"));
+
+    config_set* first = new config_set(&config);
+    config_set* second = new config_set(&config);
+    config.insert("child", first);
+    config.insert("child", second);
+    config.insert("a_child", new config_set(&config));
+    BOOST_REQUIRE(config.exists("child"));
+    BOOST_REQUIRE_EQUAL(2UL, config.children("child").size());
+    BOOST_REQUIRE_EQUAL(first, &config.child("child"));
+    BOOST_REQUIRE_EQUAL(second, config.children("child").back());
+}
+
+BOOST_AUTO_TEST_CASE( test_child_traversal )
+{
+    auto_ptr<config_file> config = parse_string(
+            "a {\n"
+            "  b {\n"
+            "    c {\n"
+            "      value: 1\n"
+            "    }\n"
+            "  }\n"
+            "  b {\n"
+            "    value: 2\n"
+            "  }\n"
+            "  d {\n"
+            "  }\n"
+            "}\n");
+
+    config_set const* a = config->find_child("a");
+    BOOST_REQUIRE(a);
+    BOOST_REQUIRE(!config->find_child("b"));
+
+    config_set::child_range b = a->children_range("b");
+    BOOST_REQUIRE_EQUAL(2, std::distance(b.begin(), b.end()));
+    BOOST_REQUIRE(b.begin()->exists("c"));
+    BOOST_REQUIRE_EQUAL(2, boost::next(b.begin())->get<int>("value"));
+    BOOST_REQUIRE_EQUAL("b", b.begin().name());
+    BOOST_REQUIRE(a->children_range("none").empty());
+
+    vector<string> names;
+    config_set::child_range all = a->children_range();
+    for (config_set::child_iterator it = all.begin(); it != all.end(); ++it)
+    {
+        names.push_back(string(it.name()));
+        BOOST_REQUIRE(it->parent() == a);
+    }
+    BOOST_REQUIRE_EQUAL(3UL, names.size());
+    BOOST_REQUIRE_EQUAL("d", names.back());
+
+    config_set const* c = config->lookup("a/b/c");
+    BOOST_REQUIRE(c);
+    BOOST_REQUIRE_EQUAL(1, c->get<int>("value"));
+    BOOST_REQUIRE_EQUAL(c, config->lookup("/a//b/c/"));
+    BOOST_REQUIRE_EQUAL(c, a->lookup("b/c"));
+    BOOST_REQUIRE_EQUAL(config.get(), config->lookup(""));
+    BOOST_REQUIRE(!config->lookup("a/b/d"));
+    BOOST_REQUIRE(!config->lookup("a/d/c"));
+}
+
+BOOST_AUTO_TEST_CASE( test_config_binding )
+{
+    config_set config;
+    config.insert("int", "1");
+    config.insert("bool", "true");
+
+    config_set::binding<int> int_value = config.bind<int>("int");
+    config_set::binding<bool> bool_value = config.bind<bool>("bool");
+    config_set::binding<string> unknown = config.bind<string>("unknown", "default");
+    BOOST_REQUIRE_EQUAL(1, *int_value);
+    BOOST_REQUIRE_EQUAL(true, bool_value.get());
+    BOOST_REQUIRE_EQUAL("default", *unknown);
+    BOOST_REQUIRE_EQUAL(7UL, unknown->size());
+
+    config.set("int", "2");
+    BOOST_REQUIRE_EQUAL(2, *int_value);
+    config.erase("bool");
+    BOOST_REQUIRE_EQUAL(false, *bool_value);
+    config.insert("unknown", "known");
+    BOOST_REQUIRE_EQUAL("known", *unknown);
+
+    config.set("int", "invalid");
+    BOOST_REQUIRE_THROW(*int_value, boost::bad_lexical_cast);
+    config.set("int", "3");
+    BOOST_REQUIRE_EQUAL(3, *int_value);
+
+    // Binding an invalid value does not throw, reading it does
+    config.set("int", "invalid");
+    config_set::binding<int> invalid = config.bind<int>("int");
+    BOOST_REQUIRE_THROW(*invalid, boost::bad_lexical_cast);
+}
+
+#ifdef __linux__
+namespace
+{
+    void write_config(path const& file, string const& contents)
+    {
+        // Replace the file, as editors do
+        path tmp = file.string() + ".tmp";
+        { ofstream out(tmp.string().c_str());
+            out << contents;
+        }
+        rename(tmp, file);
+    }
+
+    struct reload_listener
+    {
+        boost::mutex mutex;
+        boost::condition_variable changed;
+        reloadable_config::key_list keys;
+        int count;
+
+        reload_listener() : count(0) {}
+        void operator ()(reloadable_config::snapshot const&, reloadable_config::key_list const& k)
+        {
+            boost::mutex::scoped_lock lock(mutex);
+            keys = k;
+            ++count;
+            changed.notify_all();
+        }
+    };
+}
+
+namespace
+{
+    void reload_from_subscriber(reloadable_config& config)
+    { config.reload(); }
+}
+
+BOOST_AUTO_TEST_CASE( test_reloadable_config )
+{
+    path source = temp_directory_path() / unique_path("utilmm-%%%%-%%%%.config");
+    write_config(source, "a: 1\nb: 2\nchild\n{\n c: 3\n}\nchild\n{\n c: 4\n}\n");
+
+    reloadable_config config(source.string());
+    reloadable_config::snapshot first = config.current();
+    BOOST_REQUIRE_EQUAL(1, first->get<int>("a"));
+
+    reload_listener listener;
+    config.subscribe(boost::ref(listener));
+
+    // Reloads in the background when the file is replaced
+    write_config(source, "a: 1\nb: 5\nchild\n{\n c: 3\n}\nchild\n{\n c: 6\n}\nd: 7\n");
+    { boost::mutex::scoped_lock lock(listener.mutex);
+        while (listener.count == 0)
+            BOOST_REQUIRE(listener.changed.timed_wait(lock, boost::posix_time::seconds(10)));
+    }
+    BOOST_REQUIRE_EQUAL(5, config.current()->get<int>("b"));
+    reloadable_config::key_list expected;
+    expected.push_back("b");
+    expected.push_back("child[1]/c");
+    expected.push_back("d");
+    BOOST_REQUIRE_EQUAL_COLLECTIONS(expected.begin(), expected.end(), listener.keys.begin(), listener.keys.end());
+
+    // The old snapshot is still valid
+    BOOST_REQUIRE_EQUAL(2, first->get<int>("b"));
+
+    // Nothing changed: no notification
+    BOOST_REQUIRE(config.reload().empty());
+
+    // Subscribers can reload
+    int id = config.subscribe(boost::bind(reload_from_subscriber, boost::ref(config)));
+    write_config(source, "a: 1\nb: 8\n");
+    config.reload();
+    BOOST_REQUIRE_EQUAL(8, config.current()->get<int>("b"));
+    config.unsubscribe(id);
+
+    // Parse errors keep the current configuration
+    { ofstream out(source.string().c_str());
+        out << "a: 1\n}\n";
+    }
+    BOOST_REQUIRE_THROW(config.reload(), parse_error);
+    BOOST_REQUIRE_EQUAL(8, config.current()->get<int>("b"));
+
+    remove(source);
+}
+#endif
+
 BOOST_AUTO_TEST_CASE( test_cmdline_option_parsing )
 {
     SETUP;
@@ -204,5 +612,25 @@ BOOST_AUTO_TEST_CASE( test_commandline )
     char const* overriding_default_value[] = { "--required=true", "--default-value=20" };
     BOOST_REQUIRE_NO_THROW( cmdline.parse(2, overriding_default_value, config) );
     BOOST_REQUIRE_EQUAL(20, config.get<int>("defval"));
+
+    char const* unknown_argument[] = { "--required=true", "--requiredx" };
+    BOOST_REQUIRE_THROW( cmdline.parse(2, unknown_argument, config), commandline_error );
+    char const* unknown_short[] = { "--required=true", "-" };
+    BOOST_REQUIRE_THROW( cmdline.parse(2, unknown_short, config), commandline_error );
+    char const* argument_to_flag[] = { "--required=true", "--quiet=1" };
+    BOOST_REQUIRE_THROW( cmdline.parse(2, argument_to_flag, config), commandline_error );
+
+    config_set all_forms;
+    char const* all_option_forms[] = { "--required=false", "-I", "/a", "file", "--include=/b", "-v", "--verbose=3", "--quiet" };
+    BOOST_REQUIRE_NO_THROW( cmdline.parse(8, all_option_forms, all_forms) );
+    list<string> includes = all_forms.get< list<string> >("include");
+    BOOST_REQUIRE_EQUAL(2U, includes.size());
+    BOOST_REQUIRE_EQUAL("/a", includes.front());
+    BOOST_REQUIRE_EQUAL("/b", includes.back());
+    BOOST_REQUIRE_EQUAL(3, all_forms.get<int>("vkey"));
+    BOOST_REQUIRE(all_forms.get<bool>("quiet"));
+    BOOST_REQUIRE(!all_forms.get<bool>("required", true));
+    BOOST_REQUIRE_EQUAL(1U, cmdline.remaining().size());
+    BOOST_REQUIRE_EQUAL("file", cmdline.remaining().front());
 }
 
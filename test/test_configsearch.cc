@@ -0,0 +1,79 @@
+#include <boost/test/auto_unit_test.hpp>
+
+#include "testsuite.hh"
+#include <utilmm/configsearch/configuration_finder.hh>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <string>
+#include <stdlib.h>
+
+using namespace utilmm;
+using namespace boost::filesystem;
+
+namespace
+{
+    void touch(path const& file)
+    { boost::filesystem::ofstream out(file); }
+}
+
+BOOST_AUTO_TEST_CASE( test_configuration_finder )
+{
+    path root = temp_directory_path() / unique_path("utilmm-search-%%%%-%%%%");
+    create_directories(root / "a");
+    create_directories(root / "b" / "pkg");
+    touch(root / "a" / "y.conf");
+    touch(root / "b" / "x.conf");
+    touch(root / "b" / "pkg" / "z.conf");
+
+    std::string search_path = (root / "missing").string() + ":" + (root / "a").string() + ":" + (root / "b").string();
+    setenv("ROCK_CONFIG_PATH", search_path.c_str(), 1);
+
+    BOOST_REQUIRE_EQUAL(ConfigurationFinder::WatchedIndex, ConfigurationFinder::getIndexMode());
+    ConfigurationFinder::IndexMode modes[] = {
+        ConfigurationFinder::NoIndex, ConfigurationFinder::StaticIndex, ConfigurationFinder::WatchedIndex };
+    for (int i = 0; i < 3; ++i)
+    {
+        ConfigurationFinder::setIndexMode(modes[i]);
+        BOOST_REQUIRE_EQUAL((root / "b" / "x.conf").string(), ConfigurationFinder::find("x.conf"));
+        BOOST_REQUIRE_EQUAL((root / "a" / "y.conf").string(), ConfigurationFinder::find("y.conf"));
+        BOOST_REQUIRE_EQUAL((root / "b" / "pkg" / "z.conf").string(), ConfigurationFinder::find("z.conf", "pkg"));
+        BOOST_REQUIRE_EQUAL((root / "b" / "pkg" / "z.conf").string(), ConfigurationFinder::find("pkg/z.conf"));
+        BOOST_REQUIRE_EQUAL("", ConfigurationFinder::find("z.conf"));
+        BOOST_REQUIRE_EQUAL("", ConfigurationFinder::find("none.conf"));
+    }
+
+#ifdef __linux__
+    // The watched index sees the changes right away
+    touch(root / "a" / "x.conf");
+    BOOST_REQUIRE_EQUAL((root / "a" / "x.conf").string(), ConfigurationFinder::find("x.conf"));
+    remove(root / "a" / "x.conf");
+    BOOST_REQUIRE_EQUAL((root / "b" / "x.conf").string(), ConfigurationFinder::find("x.conf"));
+    create_directory(root / "missing");
+    touch(root / "missing" / "x.conf");
+    BOOST_REQUIRE_EQUAL((root / "missing" / "x.conf").string(), ConfigurationFinder::find("x.conf"));
+    rename(root / "missing", root / "moved");
+    BOOST_REQUIRE_EQUAL((root / "b" / "x.conf").string(), ConfigurationFinder::find("x.conf"));
+
+    // Creating the target of a symbolic link changes nothing in the
+    // directory of the link
+    create_symlink(root / "target.conf", root / "a" / "link.conf");
+    BOOST_REQUIRE_EQUAL("", ConfigurationFinder::find("link.conf"));
+    touch(root / "target.conf");
+    BOOST_REQUIRE_EQUAL((root / "a" / "link.conf").string(), ConfigurationFinder::find("link.conf"));
+    remove(root / "target.conf");
+    BOOST_REQUIRE_EQUAL("", ConfigurationFinder::find("link.conf"));
+#endif
+
+    // ... while the static one needs to be invalidated
+    ConfigurationFinder::setIndexMode(ConfigurationFinder::StaticIndex);
+    BOOST_REQUIRE_EQUAL("", ConfigurationFinder::find("new.conf"));
+    touch(root / "a" / "new.conf");
+    BOOST_REQUIRE_EQUAL("", ConfigurationFinder::find("new.conf"));
+    ConfigurationFinder::invalidateIndex();
+    BOOST_REQUIRE_EQUAL((root / "a" / "new.conf").string(), ConfigurationFinder::find("new.conf"));
+
+    ConfigurationFinder::setIndexMode(ConfigurationFinder::WatchedIndex);
+    remove_all(root);
+    unsetenv("ROCK_CONFIG_PATH");
+}
@@ -0,0 +1,147 @@
+#include <boost/test/auto_unit_test.hpp>
+
+#include "testsuite.hh"
+#include <utilmm/singleton/use.hh>
+#include <utilmm/types/factory.hh>
+#include <utilmm/types/hashed_factory.hh>
+#include <utilmm/types/pooled_creator.hh>
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <vector>
+
+using namespace utilmm;
+using std::string;
+
+namespace
+{
+    struct product 
+    { 
+        virtual ~product() {}
+        virtual int id() const = 0; 
+    };
+    template<int I>
+    struct concrete : public product
+    { 
+        int id() const { return I; }
+        static product* create() { return new concrete<I>; }
+    };
+
+    typedef hashed_factory<product, string> string_factory;
+
+    void create_loop(string_factory const& factory, int* failures)
+    {
+        for (int i = 0; i < 10000; ++i)
+        {
+            product* p = factory.create( (i & 1) ? "one" : "two" );
+            if (p->id() != ((i & 1) ? 1 : 2))
+                ++*failures;
+            delete p;
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_hashed_factory )
+{
+    singleton::use<string_factory> factory;
+
+    BOOST_REQUIRE(!factory->frozen());
+    BOOST_REQUIRE(factory->add("one", &concrete<1>::create));
+    BOOST_REQUIRE(factory->add("two", &concrete<2>::create));
+    BOOST_REQUIRE(!factory->add("two", &concrete<1>::create));
+    BOOST_REQUIRE(factory->make_alias("deux", "two"));
+    for (int i = 0; i < 100; ++i)
+        BOOST_REQUIRE(factory->add("filler" + boost::lexical_cast<string>(i), &concrete<3>::create));
+    BOOST_REQUIRE(factory->remove("filler0"));
+    BOOST_REQUIRE(!factory->check_entry("filler0"));
+
+    std::auto_ptr<product> p(factory->create("deux"));
+    BOOST_REQUIRE_EQUAL(2, p->id());
+    BOOST_REQUIRE_THROW(factory->create("three"), string_factory::exception);
+
+    factory->freeze();
+    BOOST_REQUIRE(factory->frozen());
+    BOOST_REQUIRE(!factory->add("three", &concrete<3>::create));
+    BOOST_REQUIRE(!factory->remove("one"));
+
+    // Same content once frozen
+    BOOST_REQUIRE(factory->check_entry("one"));
+    BOOST_REQUIRE(factory->check_entry("deux"));
+    BOOST_REQUIRE(!factory->check_entry("three"));
+    BOOST_REQUIRE(!factory->check_entry("filler0"));
+    for (int i = 1; i < 100; ++i)
+        BOOST_REQUIRE(factory->check_entry("filler" + boost::lexical_cast<string>(i)));
+    BOOST_REQUIRE_EQUAL(&concrete<1>::create, factory->get_creator("one"));
+    BOOST_REQUIRE_THROW(factory->create("three"), string_factory::exception);
+
+    // Concurrent readers on the frozen table
+    int failures[4] = { 0, 0, 0, 0 };
+    boost::thread_group readers;
+    for (int i = 0; i < 4; ++i)
+        readers.create_thread(boost::bind(&create_loop, boost::cref(*factory), &failures[i]));
+    readers.join_all();
+    for (int i = 0; i < 4; ++i)
+        BOOST_REQUIRE_EQUAL(0, failures[i]);
+}
+
+BOOST_AUTO_TEST_CASE( test_create_n )
+{
+    typedef factory<product, int> int_factory;
+    singleton::use<int_factory> factory;
+    BOOST_REQUIRE(factory->add(1, &concrete<1>::create));
+
+    // Creation does not modify the factory
+    int_factory const& const_factory = *factory;
+    std::vector<product*> products;
+    const_factory.create_n(1, 10, std::back_inserter(products));
+    BOOST_REQUIRE_EQUAL(10U, products.size());
+    for (size_t i = 0; i < products.size(); ++i)
+    {
+        BOOST_REQUIRE_EQUAL(1, products[i]->id());
+        delete products[i];
+    }
+
+    std::vector<product*> none;
+    BOOST_REQUIRE_THROW(factory->create_n(2, 10, std::back_inserter(none)), int_factory::exception);
+    BOOST_REQUIRE(none.empty());
+}
+
+namespace
+{
+    struct pooled_product : public concrete<4>
+    {
+        static int instances;
+        pooled_product() { ++instances; }
+        ~pooled_product() { --instances; }
+    };
+    int pooled_product::instances = 0;
+}
+
+BOOST_AUTO_TEST_CASE( test_pooled_factory )
+{
+    typedef factory_toolbox::pooled<product> policy;
+    typedef hashed_factory<product, string, policy::result, policy::creator> pooled_factory;
+
+    {
+        singleton::use<pooled_factory> factory;
+        factory_toolbox::pooled_creator<pooled_product, product> creator;
+        creator.pool().reserve(8);
+        BOOST_REQUIRE_EQUAL(8, pooled_product::instances);
+        BOOST_REQUIRE(factory->add("pooled", creator));
+
+        std::vector<policy::result> products;
+        factory->create_n("pooled", 8, std::back_inserter(products));
+        BOOST_REQUIRE_EQUAL(4, products.front()->id());
+        BOOST_REQUIRE_EQUAL(0U, creator.pool().available());
+        // No new object has been constructed
+        BOOST_REQUIRE_EQUAL(8, pooled_product::instances);
+
+        product* recycled = products.back().get();
+        products.clear();
+        BOOST_REQUIRE_EQUAL(8U, creator.pool().available());
+        BOOST_REQUIRE_EQUAL(recycled, factory->create("pooled").get());
+        BOOST_REQUIRE_EQUAL(8, pooled_product::instances);
+    }
+    // The pool is destroyed along with the factory singleton
+    BOOST_REQUIRE_EQUAL(0, pooled_product::instances);
+}
@@ -2,7 +2,10 @@
 
 #include "testsuite.hh"
 #include <boost/filesystem/path.hpp>
+#include <boost/filesystem/operations.hpp>
 #include <utilmm/configfile/pkgconfig.hh>
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 
 using namespace utilmm;
@@ -34,3 +37,129 @@ BOOST_AUTO_TEST_CASE( test_exists )
     BOOST_REQUIRE( pc.linker(pkgconfig::Libraries) == "-lpkgconfig_test" );
 }
 
+BOOST_AUTO_TEST_CASE( test_native_parser )
+{
+    path testdir = path(__FILE__).branch_path();
+    setenv("PKG_CONFIG_PATH", testdir.string().c_str(), 1);
+
+    BOOST_REQUIRE(!pkgconfig::exists("doesnotexist"));
+    BOOST_REQUIRE(pkgconfig::exists("test_pkgconfig_dep"));
+
+    pkgconfig pc("test_pkgconfig_dep", pkgconfig::Native);
+    BOOST_REQUIRE_EQUAL("1.2", pc.version());
+    BOOST_REQUIRE_EQUAL("/opt/dep", pc.get("prefix"));
+    BOOST_REQUIRE_EQUAL(testdir.string(), pc.get("pcfiledir"));
+    BOOST_REQUIRE_EQUAL("-I/opt/dep/include -DDEP -I/opt/include/test -DB21R", pc.compiler());
+    BOOST_REQUIRE_EQUAL("-I/opt/dep/include -I/opt/include/test", pc.compiler(pkgconfig::Path));
+    BOOST_REQUIRE_EQUAL("-L/opt/dep/lib -ldep -Wl,-rpath,/opt/dep/my\\ lib -L/opt/i386-linux/lib -lpkgconfig_test", pc.linker());
+    BOOST_REQUIRE_EQUAL("-Wl,-rpath,/opt/dep/my\\ lib", pc.linker(pkgconfig::Other));
+    BOOST_REQUIRE_EQUAL("-ldep -lpkgconfig_test", pc.linker(pkgconfig::Libraries));
+    BOOST_REQUIRE_EQUAL("-L/opt/dep/lib -ldep -Wl,-rpath,/opt/dep/my\\ lib -lm -L/opt/i386-linux/lib -lpkgconfig_test",
+            pc.linker(pkgconfig::Static));
+
+    // The results are the ones of the pkg-config program
+    char const* packages[] = { "test_pkgconfig", "test_pkgconfig_dep", 0 };
+    for (char const** name = packages; *name; ++name)
+    {
+        pkgconfig native(*name, pkgconfig::Native);
+        pkgconfig external(*name, pkgconfig::External);
+        BOOST_REQUIRE_EQUAL(external.version(), native.version());
+        BOOST_REQUIRE_EQUAL(external.get("prefix"), native.get("prefix"));
+        BOOST_REQUIRE_EQUAL(external.get("bla"), native.get("bla"));
+        for (int mode = pkgconfig::All; mode <= pkgconfig::Other; ++mode)
+            BOOST_REQUIRE_EQUAL(external.compiler(pkgconfig::Modes(mode)), native.compiler(pkgconfig::Modes(mode)));
+        for (int mode = pkgconfig::All; mode <= pkgconfig::Libraries; ++mode)
+            BOOST_REQUIRE_EQUAL(external.linker(pkgconfig::Modes(mode)), native.linker(pkgconfig::Modes(mode)));
+    }
+
+    // Packages whose requirements cannot be met
+    path alone = temp_directory_path() / unique_path("utilmm-pc-%%%%-%%%%");
+    create_directory(alone);
+    copy_file(testdir / "test_pkgconfig_dep.pc", alone / "test_pkgconfig_dep.pc");
+    setenv("PKG_CONFIG_PATH", alone.string().c_str(), 1);
+    BOOST_REQUIRE(!pkgconfig::exists("test_pkgconfig_dep"));
+    BOOST_REQUIRE(!pkgconfig::exists("test_pkgconfig_dep", pkgconfig::External));
+    remove_all(alone);
+    unsetenv("PKG_CONFIG_PATH");
+}
+
+
+BOOST_AUTO_TEST_CASE( test_batch )
+{
+    path testdir = path(__FILE__).branch_path();
+    path pcdir = temp_directory_path() / unique_path("utilmm-pc-%%%%-%%%%");
+    path cache_dir = temp_directory_path() / unique_path("utilmm-cache-%%%%-%%%%");
+    create_directory(pcdir);
+    copy_file(testdir / "test_pkgconfig.pc", pcdir / "test_pkgconfig.pc");
+    copy_file(testdir / "test_pkgconfig_dep.pc", pcdir / "test_pkgconfig_dep.pc");
+    setenv("PKG_CONFIG_PATH", pcdir.string().c_str(), 1);
+    setenv("UTILMM_CONFIG_CACHE", cache_dir.string().c_str(), 1);
+
+    std::list<std::string> packages = pkgconfig::packages();
+    BOOST_REQUIRE(std::find(packages.begin(), packages.end(), "test_pkgconfig_dep") != packages.end());
+
+    pkgconfig pc("test_pkgconfig_dep", pkgconfig::External);
+    { pkgconfig_batch batch;
+        size_t version = batch.add("test_pkgconfig_dep", pkgconfig_batch::Version);
+        size_t cflags  = batch.add("test_pkgconfig_dep", pkgconfig_batch::Compiler);
+        size_t libs    = batch.add("test_pkgconfig_dep", pkgconfig_batch::Linker, pkgconfig::Static);
+        size_t prefix  = batch.variable("test_pkgconfig_dep", "prefix");
+        size_t both    = batch.add("test_pkgconfig test_pkgconfig_dep >= 1.0", pkgconfig_batch::Exists);
+        size_t missing = batch.add("test_pkgconfig doesnotexist", pkgconfig_batch::Compiler);
+        size_t old     = batch.add("test_pkgconfig_dep > 1.2", pkgconfig_batch::Exists);
+        BOOST_REQUIRE_EQUAL(cflags, batch.add("test_pkgconfig_dep", pkgconfig_batch::Compiler));
+        BOOST_REQUIRE_EQUAL(7U, batch.size());
+
+        batch.run(4);
+        BOOST_REQUIRE_EQUAL(7U, batch.process_count());
+        BOOST_REQUIRE_EQUAL(pc.version(), batch.result(version));
+        BOOST_REQUIRE_EQUAL(pc.compiler(), batch.result(cflags));
+        BOOST_REQUIRE_EQUAL(pc.linker(pkgconfig::Static), batch.result(libs));
+        BOOST_REQUIRE_EQUAL(pc.get("prefix"), batch.result(prefix));
+        BOOST_REQUIRE(batch.found(both));
+        BOOST_REQUIRE(!batch.found(missing));
+        BOOST_REQUIRE(!batch.found(old));
+
+        // Only the new queries are run
+        size_t versions = batch.add("test_pkgconfig test_pkgconfig_dep", pkgconfig_batch::Version);
+        batch.run();
+        BOOST_REQUIRE_EQUAL(1U, batch.process_count());
+        BOOST_REQUIRE_EQUAL("0.1\n1.2", batch.result(versions));
+    }
+    BOOST_REQUIRE(exists(cache_dir / "pkgconfig.cache"));
+    // The cache stores the whole query key, not a hash of it
+    { std::ifstream cache((cache_dir / "pkgconfig.cache").string().c_str());
+        std::string line;
+        BOOST_REQUIRE(std::getline(cache, line));
+        BOOST_REQUIRE_EQUAL(0U, line.find("2\t"));
+        BOOST_REQUIRE(line.find("test_pkgconfig_dep\\0") != std::string::npos);
+    }
+
+    // The results are read from the cache, except the ones of the
+    // missing packages
+    { pkgconfig_batch batch;
+        size_t cflags  = batch.add("test_pkgconfig_dep", pkgconfig_batch::Compiler);
+        size_t old     = batch.add("test_pkgconfig_dep > 1.2", pkgconfig_batch::Exists);
+        size_t missing = batch.add("test_pkgconfig doesnotexist", pkgconfig_batch::Compiler);
+        batch.run();
+        BOOST_REQUIRE_EQUAL(1U, batch.process_count());
+        BOOST_REQUIRE_EQUAL(pc.compiler(), batch.result(cflags));
+        BOOST_REQUIRE(!batch.found(old));
+        BOOST_REQUIRE(!batch.found(missing));
+    }
+
+    // ... until one of the .pc files changes, including the ones of the
+    // required packages
+    last_write_time(pcdir / "test_pkgconfig.pc", last_write_time(pcdir / "test_pkgconfig.pc") + 10);
+    { pkgconfig_batch batch;
+        size_t cflags = batch.add("test_pkgconfig_dep", pkgconfig_batch::Compiler);
+        batch.run();
+        BOOST_REQUIRE_EQUAL(1U, batch.process_count());
+        BOOST_REQUIRE_EQUAL(pc.compiler(), batch.result(cflags));
+    }
+
+    remove_all(pcdir);
+    remove_all(cache_dir);
+    unsetenv("UTILMM_CONFIG_CACHE");
+    unsetenv("PKG_CONFIG_PATH");
+}
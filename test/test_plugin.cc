@@ -0,0 +1,136 @@
+#include <boost/test/auto_unit_test.hpp>
+
+#include "testsuite.hh"
+#include "test_plugin.hh"
+#include <utilmm/plugin/plugin_factory.hh>
+#include <utilmm/plugin/loader.hh>
+#include <sstream>
+#include <memory>
+
+using namespace utilmm::plugin;
+
+BOOST_AUTO_TEST_CASE( test_plugin_create )
+{
+    dll module(TEST_PLUGIN_MODULE);
+    plugin_factory<test_plugin_base> factory(module);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        std::auto_ptr<test_plugin_base> first(factory.create("first"));
+        BOOST_REQUIRE_EQUAL("first", first->name());
+        std::auto_ptr<test_plugin_base> second(factory.create("second"));
+        BOOST_REQUIRE_EQUAL("second", second->name());
+    }
+    BOOST_REQUIRE_THROW(factory.create("third"), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE( test_plugin_dll )
+{
+    BOOST_REQUIRE_THROW(dll("does_not_exist.so").open(), std::logic_error);
+
+    dll first(TEST_PLUGIN_MODULE), second(TEST_PLUGIN_MODULE);
+    typedef std::map<std::string, boost::any>& (*list_function)();
+    boost::shared_ptr<std::map<std::string, boost::any>& ()> a =
+        first.get<list_function>("boost_exported_plugins_list");
+    boost::shared_ptr<std::map<std::string, boost::any>& ()> b =
+        second.get<list_function>("boost_exported_plugins_list");
+    BOOST_REQUIRE(a.get() == b.get());
+    BOOST_REQUIRE_EQUAL(2U, (*a)().size());
+
+    BOOST_REQUIRE_THROW(first.get<list_function>("does_not_exist"), std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE( test_plugin_collect )
+{
+    {
+        dll module(TEST_PLUGIN_MODULE);
+        plugin_factory<test_plugin_base> factory(module);
+        std::auto_ptr<test_plugin_base> first(factory.create("first"));
+        void* handle = dlopen(TEST_PLUGIN_MODULE, RTLD_LAZY | RTLD_NOLOAD);
+        BOOST_REQUIRE(handle);
+        dlclose(handle);
+    }
+
+    // The library is unloaded once the last object created from it is
+    // deleted and collect() is called
+    dll::collect();
+    BOOST_REQUIRE(!dlopen(TEST_PLUGIN_MODULE, RTLD_LAZY | RTLD_NOLOAD));
+}
+
+BOOST_AUTO_TEST_CASE( test_plugin_preload )
+{
+    boost::filesystem::path module_path(TEST_PLUGIN_MODULE);
+    std::vector<dll> loaded = preload<test_plugin_base>(module_path.parent_path(), 2);
+    BOOST_REQUIRE_EQUAL(1U, loaded.size());
+    BOOST_REQUIRE_EQUAL(module_path.string(), loaded.front().name());
+
+    plugin_factory<test_plugin_base> factory(loaded.front());
+    std::auto_ptr<test_plugin_base> first(factory.create("first"));
+    BOOST_REQUIRE_EQUAL("first", first->name());
+
+    // A class exported for another base type is not registered
+    BOOST_REQUIRE_EQUAL(0U, preload<int>(module_path.parent_path()).size());
+}
+
+BOOST_AUTO_TEST_CASE( test_plugin_loader )
+{
+    loader<test_plugin_base> plugins(2);
+
+    // Declared libraries are opened by the first create()
+    plugins.declare("first", TEST_PLUGIN_MODULE);
+    std::vector<library_statistics> stats = plugins.statistics();
+    BOOST_REQUIRE_EQUAL(1U, stats.size());
+    BOOST_REQUIRE(!stats[0].loaded);
+
+    std::auto_ptr<test_plugin_base> first(plugins.create("first"));
+    BOOST_REQUIRE_EQUAL("first", first->name());
+    // All the classes of the library are known once it is loaded
+    std::auto_ptr<test_plugin_base> second(plugins.create("second"));
+    BOOST_REQUIRE_EQUAL("second", second->name());
+
+    stats = plugins.statistics();
+    BOOST_REQUIRE(stats[0].loaded);
+    BOOST_REQUIRE_EQUAL(2U, stats[0].objects);
+    BOOST_REQUIRE(stats[0].open_time >= 0 && stats[0].symbol_time >= 0);
+
+    // Failures are reported by create() and in the statistics
+    plugins.declare("third", "does_not_exist.so");
+    BOOST_REQUIRE_THROW(plugins.create("third"), std::logic_error);
+    plugins.load("does_not_exist_either.so");
+    plugins.wait();
+    BOOST_REQUIRE_THROW(plugins.create("fourth"), std::logic_error);
+
+    stats = plugins.statistics();
+    BOOST_REQUIRE_EQUAL(3U, stats.size());
+    BOOST_REQUIRE(!stats[1].loaded && !stats[1].error.empty());
+    BOOST_REQUIRE(!stats[2].loaded && !stats[2].error.empty());
+
+    std::ostringstream report;
+    plugins.report(report);
+    BOOST_REQUIRE(report.str().find(TEST_PLUGIN_MODULE) != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE( test_plugin_loader_background )
+{
+    loader<test_plugin_base> plugins(2);
+    plugins.load(TEST_PLUGIN_MODULE);
+    // Waits for the library being loaded
+    std::auto_ptr<test_plugin_base> second(plugins.create("second"));
+    BOOST_REQUIRE_EQUAL("second", second->name());
+    BOOST_REQUIRE(plugins.statistics().front().loaded);
+}
+
+BOOST_AUTO_TEST_CASE( test_plugin_outlives_loader )
+{
+    std::auto_ptr<test_plugin_base> first;
+    { loader<test_plugin_base> plugins(1);
+        plugins.declare("first", TEST_PLUGIN_MODULE);
+        first.reset(plugins.create("first"));
+    }
+    // The object holds the last reference to its library
+    BOOST_REQUIRE_EQUAL("first", first->name());
+    first.reset();
+    // The library can be loaded again
+    dll module(TEST_PLUGIN_MODULE);
+    module.open();
+}
@@ -0,0 +1,12 @@
+#ifndef UTILMM_TEST_PLUGIN_HH
+#define UTILMM_TEST_PLUGIN_HH
+
+#include <string>
+
+struct test_plugin_base
+{
+    virtual ~test_plugin_base() {}
+    virtual std::string name() const = 0;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#include "test_plugin.hh"
+#include <utilmm/plugin/export_plugin.hh>
+
+namespace
+{
+    struct first_plugin : public test_plugin_base
+    { std::string name() const { return "first"; } };
+    struct second_plugin : public test_plugin_base
+    { std::string name() const { return "second"; } };
+}
+
+BOOST_EXPORT_PLUGIN(test_plugin_base, first_plugin, "first")
+BOOST_EXPORT_PLUGIN_LIST()
+
+namespace
+{
+    struct second_exporter
+    {
+        second_exporter()
+        {
+            static utilmm::plugin::concrete_factory<test_plugin_base, second_plugin> cf;
+            utilmm::plugin::abstract_factory<test_plugin_base>* w = &cf;
+            boost_exported_plugins_list().insert(std::make_pair("second", w));
+        }
+    } second_exporter_instance;
+}
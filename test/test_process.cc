@@ -2,6 +2,14 @@
 
 #include "testsuite.hh"
 #include <utilmm/system/process.hh>
+#include <utilmm/system/process_pool.hh>
+#ifdef __linux__
+#include <utilmm/system/process_manager.hh>
+#include <utilmm/system/process_sampler.hh>
+#endif
+#include <boost/filesystem/operations.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -116,3 +124,407 @@ BOOST_AUTO_TEST_CASE( test_redirect )
     BOOST_REQUIRE_EQUAL(source, output);
 }
 
+
+BOOST_AUTO_TEST_CASE( test_launchers )
+{
+    path wdir = canonical(temp_directory_path());
+    process::Launcher launchers[] = { process::Fork, process::Spawn };
+    for (int i = 0; i < 2; ++i)
+    {
+        process proc;
+        proc.set_launcher(launchers[i]);
+        BOOST_REQUIRE_EQUAL(launchers[i], proc.launcher());
+
+        // Environment and working directory
+        proc.set_environment("TESTVAR", "my_value");
+        check_var(proc, "TESTVAR", "my_value");
+
+        tempfile tmpfile("bla");
+        proc.clear();
+        proc.redirect_to(process::Stdout, fileno(tmpfile.handle()), false);
+        proc << "pwd";
+        proc.set_workdir(wdir);
+        proc.start();
+        proc.wait();
+        int read_fd = open(path_to_string(tmpfile.path()).c_str(), O_RDONLY);
+        BOOST_REQUIRE_EQUAL(path_to_string(wdir) + "\n", get_file_contents(read_fd));
+        close(read_fd);
+
+        // The errors in the child are reported by start()
+        proc.set_workdir(wdir / "does_not_exist");
+        BOOST_REQUIRE_THROW(proc.start(), unix_error);
+        BOOST_REQUIRE(!proc.running());
+        proc.set_workdir(wdir);
+
+        proc.clear();
+        proc << "utilmm_does_not_exist";
+        BOOST_REQUIRE_THROW(proc.start(), unix_error);
+
+        // The program is looked for in the new PATH
+        proc.clear();
+        proc << "true";
+        proc.start();
+        proc.wait();
+        BOOST_REQUIRE(proc.exit_normal() && !proc.exit_status());
+        proc.set_environment("PATH", path_to_string(wdir / "does_not_exist"));
+        BOOST_REQUIRE_THROW(proc.start(), unix_error);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_capture )
+{
+    // Both outputs are larger than a pipe buffer: the child would block
+    // if they were not read at the same time
+    process proc;
+    proc << "sh" << "-c" << "cat; head -c 200000 /dev/zero >&2; head -c 300000 /dev/zero";
+    std::string input(100000, 'a');
+    proc.set_input(input);
+    proc.capture(process::Stdout);
+    proc.capture(process::Stderr);
+    proc.start();
+    BOOST_REQUIRE(proc.captured_fd(process::Stdout) != process::InvalidHandle);
+    proc.communicate();
+    proc.wait();
+    BOOST_REQUIRE(proc.exit_normal() && !proc.exit_status());
+    BOOST_REQUIRE_EQUAL(process::InvalidHandle, proc.captured_fd(process::Stdout));
+    BOOST_REQUIRE_EQUAL(400000U, proc.output(process::Stdout).size());
+    BOOST_REQUIRE(input + std::string(300000, '\0') == proc.output(process::Stdout));
+    BOOST_REQUIRE_EQUAL(200000U, proc.output(process::Stderr).size());
+
+    // A child which does not read its input does not block the parent
+    proc.clear();
+    proc << "true";
+    proc.set_input(std::string(1000000, 'a'));
+    proc.erase_redirection(process::Stderr);
+    proc.start();
+    proc.communicate();
+    proc.wait();
+    BOOST_REQUIRE(proc.output(process::Stdout).empty());
+
+    // Captures are removed by redirections
+    proc.clear();
+    proc << "echo" << "redirected";
+    proc.erase_redirection(process::Stdin);
+    tempfile tmpfile("utilmm_test_capture");
+    proc.redirect_to(process::Stdout, fileno(tmpfile.handle()), false);
+    proc.start();
+    BOOST_REQUIRE_EQUAL(process::InvalidHandle, proc.captured_fd(process::Stdout));
+    proc.wait();
+    int read_fd = open(path_to_string(tmpfile.path()).c_str(), O_RDONLY);
+    BOOST_REQUIRE_EQUAL("redirected\n", get_file_contents(read_fd));
+    close(read_fd);
+}
+
+namespace
+{
+    void pool_exit(boost::mutex* mtx, int* count, process& prs, int error)
+    {
+        boost::mutex::scoped_lock lock(*mtx);
+        if (!error && prs.exit_normal() && prs.exit_status() == 7)
+            ++*count;
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_process_pool )
+{
+    process_pool pool(2);
+    BOOST_REQUIRE_EQUAL(2U, pool.size());
+
+    process proc;
+    proc << "sh" << "-c" << "exit 3";
+    pool.run(proc);
+    BOOST_REQUIRE(!proc.running());
+    BOOST_REQUIRE(proc.exit_normal());
+    BOOST_REQUIRE_EQUAL(3, proc.exit_status());
+
+    // Captured streams, environment and working directory
+    boost::filesystem::path wdir = boost::filesystem::current_path().parent_path();
+    proc.clear();
+    proc << "sh" << "-c" << "cat; echo $UTILMM_POOL; pwd; head -c 100000 /dev/zero >&2";
+    proc.set_environment("UTILMM_POOL", "pooled");
+    proc.set_workdir(wdir);
+    proc.set_input(std::string(100000, 'a'));
+    proc.capture(process::Stdout);
+    proc.capture(process::Stderr);
+    pool.run(proc);
+    BOOST_REQUIRE(proc.exit_normal() && !proc.exit_status());
+    BOOST_REQUIRE(std::string(100000, 'a') + "pooled\n" + path_to_string(wdir) + "\n"
+            == proc.output(process::Stdout));
+    BOOST_REQUIRE_EQUAL(100000U, proc.output(process::Stderr).size());
+
+    // Redirections are passed to the helper
+    tempfile tmpfile("utilmm_test_pool");
+    proc.clear();
+    proc.clear_environment();
+    proc << "echo" << "redirected";
+    proc.erase_redirection(process::Stdin);
+    proc.erase_redirection(process::Stderr);
+    proc.redirect_to(process::Stdout, fileno(tmpfile.handle()), false);
+    pool.run(proc);
+    int read_fd = open(path_to_string(tmpfile.path()).c_str(), O_RDONLY);
+    BOOST_REQUIRE_EQUAL("redirected\n", get_file_contents(read_fd));
+    close(read_fd);
+
+    proc.clear();
+    proc << "utilmm_does_not_exist";
+    BOOST_REQUIRE_THROW(pool.run(proc), unix_error);
+    BOOST_REQUIRE(!proc.running());
+
+    // Queued jobs
+    boost::mutex mtx;
+    int exited = 0;
+    std::vector<process_pool::process_ptr> processes;
+    for (int i = 0; i < 20; ++i)
+    {
+        process_pool::process_ptr prs(new process);
+        *prs << "sh" << "-c" << "exit 7";
+        pool.submit(prs, boost::bind(pool_exit, &mtx, &exited, _1, _2));
+        processes.push_back(prs);
+    }
+    processes.back()->wait();
+    BOOST_REQUIRE(!processes.back()->running());
+    pool.wait_all();
+    BOOST_REQUIRE_EQUAL(20, exited);
+
+    // Signals are sent to the command once it started
+    process_pool::process_ptr sleeper(new process);
+    *sleeper << "sleep" << "10";
+    pool.submit(sleeper);
+    BOOST_REQUIRE(sleeper->running());
+    // pid() is synchronized with the worker which starts the command
+    while (!sleeper->pid())
+        usleep(1000);
+    sleeper->signal(SIGTERM);
+    sleeper->wait();
+    BOOST_REQUIRE(!sleeper->exit_normal());
+
+    // The process can still be started directly
+    sleeper->clear();
+    *sleeper << "true";
+    sleeper->start();
+    sleeper->wait();
+    BOOST_REQUIRE(sleeper->exit_normal() && !sleeper->exit_status());
+}
+
+BOOST_AUTO_TEST_CASE( test_usage )
+{
+    char const* busy = "i=0; while [ $i -lt 30000 ]; do i=$((i+1)); done";
+
+    process proc;
+    proc << "sh" << "-c" << busy;
+    proc.start();
+    BOOST_REQUIRE(proc.usage().start_time > 0);
+    BOOST_REQUIRE_EQUAL(0, proc.usage().exit_time);
+    proc.wait();
+
+    resource_usage usage = proc.usage();
+    BOOST_REQUIRE(usage.user_time + usage.system_time > 0);
+    BOOST_REQUIRE(usage.max_rss > 0);
+    BOOST_REQUIRE(usage.exit_time >= usage.start_time);
+    BOOST_REQUIRE(!proc.sample_usage(usage));
+
+    // The processes run by a pool report the usage measured by the helper
+    process_pool pool(1);
+    proc.clear();
+    proc << "sh" << "-c" << busy;
+    pool.run(proc);
+    BOOST_REQUIRE(proc.usage().user_time + proc.usage().system_time > 0);
+    BOOST_REQUIRE(proc.usage().max_rss > 0);
+    BOOST_REQUIRE(proc.usage().exit_time >= proc.usage().start_time);
+}
+
+#ifdef __linux__
+namespace
+{
+    void count_exit(boost::mutex* mtx, int* count, process&)
+    {
+        boost::mutex::scoped_lock lock(*mtx);
+        ++*count;
+    }
+
+    void count_output(size_t* count, process&, process::Stream, char const*, size_t size)
+    { *count += size; }
+
+    void record_sample(boost::mutex* mtx, resource_usage* last, int* count,
+            process&, resource_usage const& usage)
+    {
+        boost::mutex::scoped_lock lock(*mtx);
+        *last = usage;
+        ++*count;
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_process_manager )
+{
+    boost::mutex mtx;
+    int exited = 0;
+    std::vector<process_manager::process_ptr> processes;
+    {
+        process_manager manager;
+        for (int i = 0; i < 5; ++i)
+        {
+            process_manager::process_ptr prs(new process);
+            *prs << "sh" << "-c" << "exit " + boost::lexical_cast<std::string>(i);
+            manager.start(prs, boost::bind(count_exit, &mtx, &exited, _1));
+            processes.push_back(prs);
+        }
+        manager.wait_all();
+        BOOST_REQUIRE_EQUAL(0U, manager.size());
+        BOOST_REQUIRE_EQUAL(5, exited);
+        for (int i = 0; i < 5; ++i)
+        {
+            BOOST_REQUIRE(!processes[i]->running());
+            BOOST_REQUIRE(processes[i]->exit_normal());
+            BOOST_REQUIRE_EQUAL(i, processes[i]->exit_status());
+        }
+
+        // wait() returns once the manager reaped the process
+        process_manager::process_ptr sleeper(new process);
+        *sleeper << "sleep" << "10";
+        manager.start(sleeper);
+        BOOST_REQUIRE(sleeper->running());
+        BOOST_REQUIRE_EQUAL(1U, manager.size());
+        manager.signal_all(SIGTERM);
+        sleeper->wait();
+        BOOST_REQUIRE(!sleeper->running());
+        BOOST_REQUIRE(!sleeper->exit_normal());
+
+        processes.clear();
+        processes.push_back(sleeper);
+        sleeper.reset(new process);
+        *sleeper << "sleep" << "10";
+        manager.start(sleeper);
+        processes.push_back(sleeper);
+    }
+
+    // The processes still running are reaped by wait() again once the
+    // manager is destroyed
+    BOOST_REQUIRE(processes[1]->running());
+    processes[1]->signal(SIGTERM);
+    processes[1]->wait();
+    BOOST_REQUIRE(!processes[1]->running());
+}
+
+BOOST_AUTO_TEST_CASE( test_process_manager_capture )
+{
+    std::vector<process_manager::process_ptr> processes;
+    size_t callback_output = 0;
+    {
+        process_manager manager;
+        for (int i = 0; i < 20; ++i)
+        {
+            process_manager::process_ptr prs(new process);
+            *prs << "sh" << "-c" << "cat; head -c 100000 /dev/zero >&2";
+            prs->set_input(std::string(200000, 'a' + i));
+            prs->capture(process::Stdout);
+            prs->capture(process::Stderr);
+            manager.start(prs);
+            processes.push_back(prs);
+        }
+
+        // The output can go to a callback instead
+        process_manager::process_ptr prs(new process);
+        *prs << "head" << "-c" << "300000" << "/dev/zero";
+        prs->capture(process::Stdout);
+        manager.start(prs, process_manager::exit_callback(),
+                boost::bind(count_output, &callback_output, _1, _2, _3, _4));
+
+        // The output is complete once wait() returns
+        processes[0]->wait();
+        BOOST_REQUIRE_EQUAL(200000U, processes[0]->output(process::Stdout).size());
+        manager.wait_all();
+        BOOST_REQUIRE(prs->output(process::Stdout).empty());
+    }
+
+    BOOST_REQUIRE_EQUAL(300000U, callback_output);
+    for (int i = 0; i < 20; ++i)
+    {
+        BOOST_REQUIRE(processes[i]->exit_normal() && !processes[i]->exit_status());
+        BOOST_REQUIRE(std::string(200000, 'a' + i) == processes[i]->output(process::Stdout));
+        BOOST_REQUIRE_EQUAL(100000U, processes[i]->output(process::Stderr).size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE( test_process_manager_orphan_pipe )
+{
+    // The child exits right away, but the background command keeps its
+    // standard output open. Other children are started meanwhile
+    process_manager manager;
+    process_manager::process_ptr parent(new process);
+    *parent << "sh" << "-c" << "(sleep 0.2; echo done) &";
+    parent->capture(process::Stdout);
+    manager.start(parent);
+
+    // Once reaped, the pid of the child may be reused by the others: it
+    // must not be signalled anymore
+    resource_usage usage;
+    while (parent->sample_usage(usage))
+        usleep(1000);
+
+    std::vector<process_manager::process_ptr> others;
+    for (int i = 0; i < 50; ++i)
+    {
+        process_manager::process_ptr prs(new process);
+        *prs << "echo" << "other";
+        prs->capture(process::Stdout);
+        manager.start(prs);
+        others.push_back(prs);
+        parent->signal(SIGKILL);
+    }
+    manager.wait_all();
+
+    BOOST_REQUIRE_EQUAL("done\n", parent->output(process::Stdout));
+    for (size_t i = 0; i < others.size(); ++i)
+        BOOST_REQUIRE_EQUAL("other\n", others[i]->output(process::Stdout));
+}
+
+BOOST_AUTO_TEST_CASE( test_process_manager_signal_exited )
+{
+    // The child exits, but the background command keeps its standard
+    // output open. Its pid may then be reaped and reused, and must not
+    // be signalled anymore
+    process_manager manager;
+    process_manager::process_ptr prs(new process);
+    *prs << "sh" << "-c" << "(sleep 0.3; echo done) &";
+    prs->capture(process::Stdout);
+    manager.start(prs);
+
+    resource_usage usage;
+    while (prs->sample_usage(usage))
+        usleep(1000);
+    BOOST_REQUIRE(prs->running());
+    prs->signal(SIGKILL);
+    manager.signal_all(SIGKILL);
+    prs->wait();
+
+    BOOST_REQUIRE(prs->exit_normal() && !prs->exit_status());
+    BOOST_REQUIRE_EQUAL("done\n", prs->output(process::Stdout));
+}
+
+BOOST_AUTO_TEST_CASE( test_process_sampler )
+{
+    boost::mutex mtx;
+    resource_usage last;
+    int samples = 0;
+    process_sampler sampler(0.01,
+            boost::bind(record_sample, &mtx, &last, &samples, _1, _2));
+
+    // The process is sampled while it runs, then removed
+    process_manager manager;
+    process_manager::process_ptr prs(new process);
+    *prs << "sh" << "-c" << "i=0; while [ $i -lt 100000 ]; do i=$((i+1)); done";
+    manager.start(prs);
+    sampler.add(prs);
+    resource_usage usage;
+    BOOST_REQUIRE(prs->sample_usage(usage));
+    prs->wait();
+    while (sampler.size())
+        usleep(1000);
+
+    boost::mutex::scoped_lock lock(mtx);
+    BOOST_REQUIRE(samples > 0);
+    BOOST_REQUIRE(last.max_rss > 0);
+    BOOST_REQUIRE_EQUAL(prs->usage().start_time, last.start_time);
+    BOOST_REQUIRE(last.user_time + last.system_time <= prs->usage().user_time + prs->usage().system_time + 0.02);
+}
+#endif
@@ -8,6 +8,7 @@
 #include <pwd.h>
 
 #include <string>
+#include <stdlib.h>
 
 static std::string get_home()
 {
@@ -35,3 +36,53 @@ BOOST_AUTO_TEST_CASE( test_expansion )
     BOOST_REQUIRE(home == expanded);
 }
 
+
+BOOST_AUTO_TEST_CASE( test_expansion_syntax )
+{
+    utilmm::environment env;
+    env.set("A", "a value");
+    env.set("EMPTY", "");
+    env.set("NESTED", "$A");
+
+    BOOST_REQUIRE_EQUAL("no variable", utilmm::shell_expand("no variable", env));
+    BOOST_REQUIRE_EQUAL("[a value]", utilmm::shell_expand("[$A]", env));
+    BOOST_REQUIRE_EQUAL("[a value]", utilmm::shell_expand("[${A}]", env));
+    BOOST_REQUIRE_EQUAL("[]", utilmm::shell_expand("[$UNSET]", env));
+    BOOST_REQUIRE_EQUAL("[a value-]", utilmm::shell_expand("[$A-$UNSET]", env));
+    // Values are not expanded again
+    BOOST_REQUIRE_EQUAL("$A", utilmm::shell_expand("$NESTED", env));
+
+    // Defaults, themselves expanded
+    BOOST_REQUIRE_EQUAL("a value", utilmm::shell_expand("${A:-default}", env));
+    BOOST_REQUIRE_EQUAL("default", utilmm::shell_expand("${UNSET:-default}", env));
+    BOOST_REQUIRE_EQUAL("default", utilmm::shell_expand("${EMPTY:-default}", env));
+    BOOST_REQUIRE_EQUAL("", utilmm::shell_expand("${UNSET:-}", env));
+    BOOST_REQUIRE_EQUAL("/a value/x", utilmm::shell_expand("${UNSET:-/$A/x}", env));
+    BOOST_REQUIRE_EQUAL("a value}", utilmm::shell_expand("${UNSET:-${A}}}", env));
+    BOOST_REQUIRE_EQUAL("{x}", utilmm::shell_expand("${UNSET:-{x}}", env));
+
+    // What is not a variable reference is kept as-is
+    BOOST_REQUIRE_EQUAL("$", utilmm::shell_expand("$", env));
+    BOOST_REQUIRE_EQUAL("$ $-", utilmm::shell_expand("$ $-", env));
+    BOOST_REQUIRE_EQUAL("${}", utilmm::shell_expand("${}", env));
+    BOOST_REQUIRE_EQUAL("${A", utilmm::shell_expand("${A", env));
+    BOOST_REQUIRE_EQUAL("${A:-x", utilmm::shell_expand("${A:-x", env));
+    BOOST_REQUIRE_EQUAL("${A-x}", utilmm::shell_expand("${A-x}", env));
+
+    std::string output = "prefix ";
+    utilmm::shell_expand("$A", env, output);
+    BOOST_REQUIRE_EQUAL("prefix a value", output);
+}
+
+BOOST_AUTO_TEST_CASE( test_environment_snapshot )
+{
+    setenv("UTILMM_TEST_VARIABLE", "before", 1);
+    utilmm::environment env = utilmm::environment::capture();
+    setenv("UTILMM_TEST_VARIABLE", "after", 1);
+
+    BOOST_REQUIRE(env.get("HOME"));
+    BOOST_REQUIRE_EQUAL("before", utilmm::shell_expand("${UTILMM_TEST_VARIABLE}", env));
+    BOOST_REQUIRE_EQUAL("after", utilmm::shell_expand("${UTILMM_TEST_VARIABLE}"));
+    BOOST_REQUIRE_EQUAL("x", utilmm::shell_expand("${UTILMM_TEST_UNSET:-x}"));
+    unsetenv("UTILMM_TEST_VARIABLE");
+}
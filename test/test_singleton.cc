@@ -0,0 +1,66 @@
+#include <boost/test/auto_unit_test.hpp>
+
+#include "testsuite.hh"
+#include <utilmm/singleton/use.hh>
+
+using namespace utilmm;
+
+namespace
+{
+    struct counted
+    {
+        static int instances;
+        int value;
+
+        counted() : value(0) { ++instances; }
+        ~counted() { --instances; }
+    };
+    int counted::instances = 0;
+}
+
+BOOST_AUTO_TEST_CASE( test_singleton_lifetime )
+{
+    BOOST_REQUIRE_EQUAL(0, counted::instances);
+    {
+        singleton::use<counted> first;
+        BOOST_REQUIRE_EQUAL(1, counted::instances);
+        first->value = 42;
+
+        {
+            singleton::use<counted> second(first);
+            BOOST_REQUIRE_EQUAL(1, counted::instances);
+            BOOST_REQUIRE_EQUAL(&first.instance(), &second.instance());
+            BOOST_REQUIRE_EQUAL(42, second->value);
+        }
+
+        // Dropping one client must not invalidate the others
+        BOOST_REQUIRE_EQUAL(1, counted::instances);
+        BOOST_REQUIRE_EQUAL(42, first->value);
+    }
+    BOOST_REQUIRE_EQUAL(0, counted::instances);
+
+    // The singleton is re-created once it gets a new client
+    singleton::use<counted> phoenix;
+    BOOST_REQUIRE_EQUAL(1, counted::instances);
+    BOOST_REQUIRE_EQUAL(0, phoenix->value);
+}
+
+namespace
+{
+    template<int I>
+    struct tagged { int id() const { return I; } };
+}
+
+BOOST_AUTO_TEST_CASE( test_singleton_distinct_types )
+{
+    singleton::use< tagged<0> > a;
+    singleton::use< tagged<1> > b;
+    singleton::use< tagged<2> > c;
+    singleton::use< tagged<1> > b2;
+
+    BOOST_REQUIRE_EQUAL(0, a->id());
+    BOOST_REQUIRE_EQUAL(1, b->id());
+    BOOST_REQUIRE_EQUAL(2, c->id());
+    BOOST_REQUIRE_EQUAL(&b.instance(), &b2.instance());
+    BOOST_REQUIRE(static_cast<void*>(&a.instance()) != static_cast<void*>(&b.instance()));
+}
@@ -4,8 +4,13 @@
 #include <utilmm/system/system.hh>
 #include <utilmm/system/socket.hh>
 #include <utilmm/system/endian.hh>
+#ifdef __linux__
+#include <utilmm/system/reactor.hh>
+#endif
 #include <boost/filesystem/operations.hpp>
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
 #include <iostream>
 #include <errno.h>
 using namespace utilmm;
@@ -97,3 +102,149 @@ BOOST_AUTO_TEST_CASE( test_socket )
     BOOST_REQUIRE(!client.try_wait(socket::WaitRead));
     BOOST_REQUIRE_EQUAL(std::string(buffer), std::string("blabla"));
 }
+
+BOOST_AUTO_TEST_CASE( test_socket_nonblocking )
+{
+    std::string path = "/tmp/utilmm_test_socket_" + boost::lexical_cast<std::string>(getpid());
+    unlink(path.c_str());
+    server_socket server(server_socket::Unix, server_socket::Stream, path);
+    server.set_nonblocking(true);
+    BOOST_REQUIRE(server.nonblocking());
+    BOOST_REQUIRE_EQUAL(server.accept(), (socket*) 0);
+
+    socket client(socket::Unix, socket::Stream);
+    client.set_nonblocking(true);
+    client.connect(path);
+    client.wait(socket::WaitWrite);
+    BOOST_REQUIRE_EQUAL(client.pending_error(), 0);
+
+    std::auto_ptr<socket> accepted(server.accept());
+    BOOST_REQUIRE(accepted.get());
+    BOOST_REQUIRE(accepted->nonblocking());
+
+    char buffer[7];
+    BOOST_REQUIRE_EQUAL(accepted->read(buffer, 7), -1);
+    BOOST_REQUIRE_EQUAL(client.write("blabla", 7), 7);
+    accepted->wait(socket::WaitRead);
+    BOOST_REQUIRE_EQUAL(accepted->read(buffer, 7), 7);
+    BOOST_REQUIRE_EQUAL(std::string(buffer), std::string("blabla"));
+
+    // Writing to a closed peer must not raise SIGPIPE
+    accepted.reset();
+    client.set_nonblocking(false);
+    BOOST_REQUIRE_THROW(client.write("blabla", 7), unix_error);
+    unlink(path.c_str());
+}
+
+#ifdef __linux__
+namespace
+{
+    struct echo_server
+    {
+        reactor& loop;
+        server_socket& server;
+        std::vector< boost::shared_ptr<socket> > connections;
+        std::string received;
+
+        echo_server(reactor& loop, server_socket& server)
+            : loop(loop), server(server) {}
+
+        void accept(int, int)
+        {
+            while (socket* s = server.accept())
+            {
+                connections.push_back(boost::shared_ptr<socket>(s));
+                loop.add(*s, reactor::Read, boost::bind(&echo_server::echo, this, s, _2));
+            }
+        }
+
+        void echo(socket* s, int events)
+        {
+            char buffer[256];
+            int count;
+            while ((count = s->read(buffer, sizeof(buffer))) > 0)
+                s->write(buffer, count);
+            if (count == 0 || (events & reactor::Hangup))
+                loop.remove(s->fd());
+        }
+
+        void reply(socket* s, int)
+        {
+            char buffer[256];
+            int count;
+            while ((count = s->read(buffer, sizeof(buffer))) > 0)
+                received += std::string(buffer, count);
+            if (received.size() == 12)
+                loop.stop();
+        }
+    };
+
+    void record(std::vector<int>& calls, int value) { calls.push_back(value); }
+    void cancel(reactor& loop, reactor::timer_id& id) { loop.cancel_timer(id); }
+}
+
+BOOST_AUTO_TEST_CASE( test_reactor )
+{
+    std::string path = "/tmp/utilmm_test_reactor_" + boost::lexical_cast<std::string>(getpid());
+    unlink(path.c_str());
+    server_socket server(server_socket::Unix, server_socket::Stream, path);
+    server.set_nonblocking(true);
+
+    reactor loop;
+    echo_server echo(loop, server);
+    loop.add(server, reactor::Read, boost::bind(&echo_server::accept, &echo, _1, _2));
+    BOOST_REQUIRE(loop.contains(server.fd()));
+    BOOST_REQUIRE_THROW(loop.add(server, reactor::Read, reactor::io_callback()), unix_error);
+
+    boost::shared_ptr<socket> clients[2];
+    for (int i = 0; i < 2; ++i)
+    {
+        clients[i].reset(new socket(socket::Unix, socket::Stream));
+        clients[i]->set_nonblocking(true);
+        clients[i]->connect(path);
+        loop.add(*clients[i], reactor::Read, boost::bind(&echo_server::reply, &echo, clients[i].get(), _2));
+    }
+    BOOST_REQUIRE_EQUAL(loop.size(), 3U);
+    clients[0]->write("blabla", 6);
+    clients[1]->write("bloblo", 6);
+
+    // run() returns once both echoes have been received
+    loop.add_timer(5, boost::bind(&reactor::stop, &loop));
+    loop.run();
+    BOOST_REQUIRE_EQUAL(echo.received.size(), 12U);
+    BOOST_REQUIRE_EQUAL(echo.connections.size(), 2U);
+
+    // Closing the clients removes the server side of the connections
+    for (int i = 0; i < 2; ++i)
+        loop.remove(clients[i]->fd());
+    BOOST_REQUIRE_EQUAL(loop.size(), 3U);
+    clients[0].reset();
+    clients[1].reset();
+    while (loop.size() > 1)
+        loop.run_once(1);
+    unlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( test_reactor_timers )
+{
+    reactor loop;
+    std::vector<int> calls;
+    loop.add_timer(0.02, boost::bind(record, boost::ref(calls), 2));
+    loop.add_timer(0.01, boost::bind(record, boost::ref(calls), 1));
+    reactor::timer_id periodic = loop.add_timer(0.005, boost::bind(record, boost::ref(calls), 0), 0.005);
+    reactor::timer_id cancelled = loop.add_timer(0.03, boost::bind(record, boost::ref(calls), 3));
+    loop.add_timer(0.025, boost::bind(cancel, boost::ref(loop), boost::ref(cancelled)));
+    loop.add_timer(0.04, boost::bind(&reactor::stop, &loop));
+    loop.run();
+    loop.cancel_timer(periodic);
+
+    BOOST_REQUIRE(std::find(calls.begin(), calls.end(), 3) == calls.end());
+    std::vector<int>::iterator first  = std::find(calls.begin(), calls.end(), 1);
+    std::vector<int>::iterator second = std::find(calls.begin(), calls.end(), 2);
+    BOOST_REQUIRE(first < second && second != calls.end());
+    BOOST_REQUIRE(std::count(calls.begin(), calls.end(), 0) >= 4);
+
+    // run_once returns after the timeout if nothing happens
+    BOOST_REQUIRE_EQUAL(loop.run_once(0.01), 0U);
+}
+#endif
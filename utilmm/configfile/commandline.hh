@@ -6,6 +6,9 @@
 #include <list>
 // #include <getopt.h>
 #include <iosfwd>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility/string_view.hpp>
 
 namespace utilmm
 {
@@ -167,6 +170,21 @@ namespace utilmm
     private:
         typedef std::vector<cmdline_option> Options;
 
+        /** Hash and equality of option names, allowing to look them up
+         * with a boost::string_view */
+        struct name_hash
+        {
+            std::size_t operator()(boost::string_view name) const
+            { return boost::hash_range(name.begin(), name.end()); }
+        };
+        struct name_equal
+        {
+            bool operator()(boost::string_view a, boost::string_view b) const
+            { return a == b; }
+        };
+        /** Option names to their index in m_options */
+        typedef boost::unordered_map<std::string, std::size_t, name_hash, name_equal> OptionIndex;
+
     public:
         /** Builds an object with a null-terminated string list
          * @param options the option list, null-terminated
@@ -201,11 +219,13 @@ namespace utilmm
 	void usage(std::ostream& out) const;
 
     private:
+        void build_index();
         void add_argument(config_set& config, cmdline_option const& optdesc, std::string const& value);
-	int option_match(config_set& config, cmdline_option const& opt, int argc, char const* const* argv, int i);
+	int option_match(config_set& config, int argc, char const* const* argv, int i);
 
 	std::string m_banner;
         Options    m_options;
+        OptionIndex m_short_options, m_long_options;
         std::list<std::string> m_remaining;
     };
 
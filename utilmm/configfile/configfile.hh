@@ -4,6 +4,8 @@
 #include <utilmm/configfile/exceptions.hh>
 #include <utilmm/configfile/configset.hh>
 #include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
 
 namespace utilmm
 {
@@ -22,16 +24,89 @@ namespace utilmm
      * as a top-level scope (ConfigSet) */
     class config_file : public config_set
     {
+    public:
+        /** How the file is loaded. In all cases, the keys and values
+         * read from the file refer to the file contents, which are owned
+         * by the config_file object. */
+        enum load_mode
+        {
+            /** Read the file in a buffer */
+            ReadFile,
+            /** Map the file in memory. The values keep referring to the
+             * mapping, so the file must not be truncated while the
+             * config_file object exists: accessing the pages past the
+             * new end of the file raises SIGBUS. Use ReadFile for files
+             * which may be rewritten in place */
+            MapFile,
+            /** Load the compiled form of the file from the cache (see
+             * cache_path) if it is up to date. Otherwise, map the file
+             * and update the cache, with the same restriction as
+             * MapFile */
+            Cached
+        };
+
     private:
+        /** What identifies a version of the source file in the cache */
+        struct source_info
+        {
+            std::string path;
+            boost::uint64_t mtime_sec;
+            boost::uint64_t mtime_nsec;
+            boost::uint64_t size;
+            /** False until the file has been looked at, which is only
+             * done when loading in Cached mode or by compile() */
+            bool known;
+        };
+
+        std::vector<char> m_buffer;
+        char const* m_mapping;
+        std::size_t m_mapping_size;
+        source_info m_source;
+
         void read(const std::string& name);
+        void map(const std::string& name);
+        bool map_file(const std::string& name);
+        void unmap();
+        /** Parses the file contents in [begin, end) */
+        void parse(char const* begin, char const* end);
+
+        static bool get_source_info(const std::string& name, source_info& info);
+        void load_cached(const std::string& name);
+        bool load_compiled(const std::string& path);
 
     public:
 
         /** Read a configuration file
          * @arg name the file path
+         * @arg mode how to load the file
          * @throw parse_error
          */
-        config_file(const std::string& name);
+        config_file(const std::string& name, load_mode mode = ReadFile);
+        ~config_file();
+
+        /** Writes the compiled form of this file to \c path. It is a
+         * binary form of the tree, with a table of sets and tables of
+         * values and children referring to a table of unique strings. It
+         * records the modification time and size the source file had when
+         * it was loaded in Cached mode, or has when compile() is called
+         * for the other modes.
+         *
+         * @throw std::runtime_error if the file cannot be written, or if
+         * the source file does not exist anymore
+         */
+        void compile(const std::string& path) const;
+
+        /** The path of the compiled form of \c source in the cache, used
+         * by the Cached mode. It is empty if there is no cache directory */
+        static std::string cache_path(const std::string& source);
+
+        /** The directory of the caches of the library: $UTILMM_CONFIG_CACHE
+         * if set, or utilmm/ in $XDG_CACHE_HOME or ~/.cache. The home
+         * directory is taken from the password database if $HOME is not
+         * set. Returns an empty string if none of these is an absolute
+         * path, and nothing is cached then. The directory is not created
+         * by this method */
+        static std::string cache_directory();
     };
 }
 
@@ -1,11 +1,15 @@
 #ifndef UTILMM_CONFIG_SET_HH
 #define UTILMM_CONFIG_SET_HH
 
-#include <map>
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <boost/noncopyable.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/utility/enable_if.hpp>
+#include <boost/utility/string_view.hpp>
+#include <boost/iterator/iterator_adaptor.hpp>
+#include <boost/range/iterator_range.hpp>
 
 #include <list>
 
@@ -20,27 +24,145 @@ namespace utilmm
         { static const bool value = true; };
     }
 
+    /** A key or value stored in a config_set. It either owns a copy of
+     * its contents or refers to a buffer owned by the enclosing
+     * config_file, see config_file::MapFile */
+    class config_string
+    {
+    public:
+        config_string() : m_data(""), m_size(0), m_owned(false) {}
+        /** Copies \c value */
+        config_string(std::string const& value) { assign(value.data(), value.size()); }
+        /** Refers to \c value, which must outlive this object */
+        explicit config_string(boost::string_view value)
+            : m_data(value.data()), m_size(value.size()), m_owned(false) {}
+        config_string(config_string const& other)
+        {
+            if (other.m_owned)
+                assign(other.m_data, other.m_size);
+            else
+            {
+                m_data  = other.m_data;
+                m_size  = other.m_size;
+                m_owned = false;
+            }
+        }
+        ~config_string()
+        {
+            if (m_owned)
+                delete[] m_data;
+        }
+        config_string& operator = (config_string const& other)
+        {
+            config_string copy(other);
+            swap(copy);
+            return *this;
+        }
+#if __cplusplus >= 201103L
+        // config_set keeps its strings in sorted vectors: do not copy
+        // owned strings when moving them around
+        config_string(config_string&& other) noexcept
+            : m_data(other.m_data), m_size(other.m_size), m_owned(other.m_owned)
+        { other.m_owned = false; }
+        config_string& operator = (config_string&& other) noexcept
+        {
+            swap(other);
+            return *this;
+        }
+#endif
+        void swap(config_string& other)
+        {
+            std::swap(m_data, other.m_data);
+            std::swap(m_size, other.m_size);
+            std::swap(m_owned, other.m_owned);
+        }
+
+        boost::string_view view() const { return boost::string_view(m_data, m_size); }
+        std::string str() const { return std::string(m_data, m_size); }
+
+        bool operator < (config_string const& other) const
+        { return view() < other.view(); }
+
+    private:
+        void assign(char const* data, std::size_t size)
+        {
+            m_size  = size;
+            m_owned = (size != 0);
+            if (m_owned)
+            {
+                char* copy = new char[size];
+                std::copy(data, data + size, copy);
+                m_data = copy;
+            }
+            else
+                m_data = "";
+        }
+
+        char const* m_data;
+        std::size_t m_size;
+        bool m_owned;
+    };
+
+    class config_file;
+
     /** A scope in configuration files */
     class config_set 
         : private boost::noncopyable
     {
-        friend class ConfigFile;
+        friend class config_file;
 
     private:
         typedef std::list<std::string> stringlist;
         template<typename T>
-        static T convert(std::string const& value);
-        
+        static T convert(boost::string_view value);
+
     protected:
         config_set* m_parent;
-        typedef std::multimap<std::string, std::string> ValueMap;
+        /** Values and children are sorted by key, and kept in insertion
+         * order for a given key */
+        typedef std::pair<config_string, config_string> ValueEntry;
+        typedef std::vector<ValueEntry> ValueMap;
         ValueMap m_values;
-        typedef std::multimap<std::string, const config_set*> ChildMap;
+        typedef std::pair<config_string, const config_set*> ChildEntry;
+        typedef std::vector<ChildEntry> ChildMap;
         ChildMap m_children;
+        /** Changed each time a value is modified, see binding */
+        unsigned long m_generation;
+
+        /** Compares the keys of ValueMap and ChildMap entries */
+        struct key_less
+        {
+            template<typename Entry>
+            bool operator()(Entry const& a, boost::string_view b) const
+            { return a.first.view() < b; }
+            template<typename Entry>
+            bool operator()(boost::string_view a, Entry const& b) const
+            { return a < b.first.view(); }
+            template<typename Entry>
+            bool operator()(Entry const& a, Entry const& b) const
+            { return a.first.view() < b.first.view(); }
+        };
+
+        /** The entries of \c map whose key is \c name */
+        template<typename Map>
+        static std::pair<typename Map::const_iterator, typename Map::const_iterator>
+            find_range(Map const& map, boost::string_view name)
+        { return std::equal_range(map.begin(), map.end(), name, key_less()); }
 
     protected:
         /** Clears this set */
         void clear();
+
+        /** Appends a value without copying \c name and \c value if they
+         * are views. The set is not sorted anymore until sort() is
+         * called. */
+        void append_value(config_string const& name, config_string const& value);
+        /** Appends a child without copying \c name if it is a view. The
+         * set is not sorted anymore until sort() is called. */
+        void append_child(config_string const& name, config_set const* child);
+        /** Sorts the values and children added by append_value and
+         * append_child */
+        void sort();
         
     public:
         explicit config_set(config_set* parent = 0);
@@ -65,6 +187,27 @@ namespace utilmm
         /** Get the first child named \c name or an empty set */
 	config_set const& child(std::string const& name) const;
 
+        class child_iterator;
+        typedef boost::iterator_range<child_iterator> child_range;
+        /** The children named \c name, in insertion order. Unlike \c
+         * children, it does not copy anything */
+        child_range children_range(boost::string_view name) const;
+        /** All the children, sorted by name */
+        child_range children_range() const;
+        typedef ValueMap::const_iterator value_iterator;
+        typedef boost::iterator_range<value_iterator> value_range;
+        /** All the values as (key, value) pairs, sorted by key and in
+         * insertion order for a given key */
+        value_range values_range() const;
+
+        /** The first child named \c name, or 0 if there is none */
+        config_set const* find_child(boost::string_view name) const;
+        /** Resolves a path of child names separated by '/', e.g. "a/b/c",
+         * taking the first child of each name. Empty names are ignored.
+         * @return the config_set or 0 if one of the children does not
+         * exist */
+        config_set const* lookup(boost::string_view path) const;
+
 	/** In a config_set object, all values are stored as lists of strings. This
 	 * method converts the stored value into the required type using the
 	 * associated config_set::convert template specialization (if it exists).
@@ -72,17 +215,19 @@ namespace utilmm
 	 * If no value is stored under the given key, returns \c defval
 	 */
         template<typename T> 
-        T get(std::string const& name, T const& defval = T(),
+        T get(boost::string_view name, T const& defval = T(),
                 typename boost::enable_if< details::is_list<T> >::type *enabler = 0) const;
 	/** In a config_set object, all values are stored as lists of strings. This
 	 * method is a convenience method when only one value is stored for a given
 	 * key.  It converts the stored value into the required type using the
 	 * associated config_set::convert template specialization (if it exists).
 	 *
-	 * If no value is associated with the key, returns \c defval
+	 * If no value is associated with the key, returns \c defval. If more
+	 * than one value is, the first one is converted. It does not
+	 * allocate memory, unless the conversion itself does.
 	 */
         template<typename T> 
-        T get(std::string const& name, T const& defval = T(),
+        T get(boost::string_view name, T const& defval = T(),
                 typename boost::disable_if< details::is_list<T> >::type *enabler = 0) const;
 
         /** Replaces any value associated with \c name with the value provided.
@@ -102,45 +247,109 @@ namespace utilmm
         void insert(std::string const& name, config_set const* value);
         /** Remove the given option */
         void erase(std::string const& name);
+
+        template<typename T> class binding;
+        /** Returns a handle on the value of \c name, converted to \c T.
+         * See config_set::binding */
+        template<typename T>
+        binding<T> bind(std::string const& name, T const& defval = T()) const
+        { return binding<T>(*this, name, defval); }
+    };
+
+    /** Iterates on config_set children. It dereferences to the child,
+     * and name() gives the name under which it is stored */
+    class config_set::child_iterator
+        : public boost::iterator_adaptor<child_iterator, config_set::ChildMap::const_iterator,
+                config_set const, boost::use_default, config_set const&>
+    {
+        friend class boost::iterator_core_access;
+        config_set const& dereference() const { return *this->base()->second; }
+
+    public:
+        child_iterator() {}
+        explicit child_iterator(config_set::ChildMap::const_iterator it)
+            : child_iterator::iterator_adaptor_(it) {}
+
+        boost::string_view name() const { return this->base()->first.view(); }
+    };
+
+    /** A handle on a config_set value, converted to \c T once.
+     *
+     * The value is converted again only when it may have changed, i.e.
+     * after a call to \c set, \c insert or \c erase on the config_set.
+     * Otherwise, reading it is a comparison and a load. The first
+     * conversion is done by the first read, and conversion errors are
+     * reported by the reads only. The config_set must outlive the
+     * binding.
+     */
+    template<typename T>
+    class config_set::binding
+    {
+    public:
+        /** See config_set::get for the meaning of \c defval */
+        binding(config_set const& set, std::string const& name, T const& defval = T())
+            : m_set(&set), m_name(name), m_defval(defval)
+            , m_generation(set.m_generation - 1) {}
+
+        /** The current value
+         * @throw boost::bad_lexical_cast if the value cannot be converted */
+        T const& get() const
+        {
+            if (m_generation != m_set->m_generation)
+                update();
+            return m_value;
+        }
+        T const& operator * () const { return get(); }
+        T const* operator -> () const { return &get(); }
+
+    private:
+        void update() const
+        {
+            m_value = m_set->get<T>(m_name, m_defval);
+            m_generation = m_set->m_generation;
+        }
+
+        config_set const* m_set;
+        std::string m_name;
+        T m_defval;
+        mutable T m_value;
+        mutable unsigned long m_generation;
     };
 
     namespace details {
         typedef std::list<std::string> stringlist;
     }
 
-    template<> bool config_set::convert(std::string const& value);
+    template<> bool config_set::convert(boost::string_view value);
     template<typename T> 
-    T config_set::convert(const std::string& value)
-    { return boost::lexical_cast<T>(value); }
-
-
-    template<>
-    config_set::stringlist config_set::get(std::string const& name,
-            config_set::stringlist const& defval,
-            boost::enable_if< details::is_list<config_set::stringlist> >::type *enabler) const;
+    T config_set::convert(boost::string_view value)
+    { return boost::lexical_cast<T>(value.data(), value.size()); }
 
     template<typename T> 
-    T config_set::get(std::string const& name, T const& defval,
+    T config_set::get(boost::string_view name, T const& defval,
             typename boost::enable_if< details::is_list<T> >::type *enabler) const
     {
-        stringlist values = get< stringlist >(name);
-        if (values.empty())
+        std::pair<ValueMap::const_iterator, ValueMap::const_iterator>
+            range = find_range(m_values, name);
+        if (range.first == range.second)
             return defval;
         
         T result;
-        for (stringlist::const_iterator it = values.begin(); it != values.end(); ++it)
-            result.push_back(convert<typename T::value_type>(*it));
+        for (ValueMap::const_iterator it = range.first; it != range.second; ++it)
+            result.push_back(convert<typename T::value_type>(it->second.view()));
 
         return result;
     }
 
     template<typename T>
-    T config_set::get(std::string const& name, T const& defval,
+    T config_set::get(boost::string_view name, T const& defval,
             typename boost::disable_if< details::is_list<T> >::type *enabler) const
     {   
-        std::list<T> deflist;
-        deflist.push_back(defval);
-        return get< std::list<T> >(name, deflist).front();
+        ValueMap::const_iterator it =
+            std::lower_bound(m_values.begin(), m_values.end(), name, key_less());
+        if (it == m_values.end() || it->first.view() != name)
+            return defval;
+        return convert<T>(it->second.view());
     }
 }
 
@@ -3,6 +3,9 @@
 
 #include <string>
 #include <list>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
 #include <utilmm/configfile/exceptions.hh>
 
 namespace utilmm
@@ -11,14 +14,30 @@ namespace utilmm
 
     class process;
     
+    /** Access to the pkg-config description of a package
+     *
+     * By default, the .pc files are read by a parser built in the
+     * library, which follows the rules of the pkg-config implementation
+     * found at build time: search path, variable substitution, Requires
+     * chains and flag ordering. Parsed files and computed flags are kept
+     * in memory for the life of the process, or until one of the
+     * PKG_CONFIG_* variables changes. The External backend runs the
+     * pkg-config program for each query instead. See pkgconfig_batch
+     * to run many queries with the pkg-config program.
+     */
     class pkgconfig
     {
         typedef std::string string;
       
     public:
+        enum Backend {
+            Native,  /// parse the .pc files in-process
+            External /// run the pkg-config program
+        };
+
         /** Creates a package description file.
          * @throws not_found(name) if the package is not available */
-        pkgconfig(string const& name);
+        pkgconfig(string const& name, Backend backend = Native);
 
         ~pkgconfig();
 
@@ -27,8 +46,9 @@ namespace utilmm
         /** The package version */
         string version() const;
 
-        /** Checks if the given package is available */
-        static bool exists(string const& name);
+        /** Checks if the given package and the packages it requires are
+         * available */
+        static bool exists(string const& name, Backend backend = Native);
 
         /** Get a variable defined in this package description */
         string get(string const& var, string const& defval = string()) const;
@@ -39,20 +59,95 @@ namespace utilmm
         };
         /** Get compile flags for the given mode */
         string compiler(Modes mode = pkgconfig::All) const;
-        /** Get link flags for the given mode */
+        /** Get link flags for the given mode. Static gives all the flags
+         * needed for static linking, as pkg-config --libs --static */
         string linker(Modes mode = pkgconfig::All) const;
 
+        /** The names of the packages pkg-config knows about */
         static std::list<string> packages();
         
     private:
         /** The package name */
         string m_name;
+        Backend m_backend;
 
         /** Run the given process object and returns its standard output */
         static string run(process& prs);
         /** Get the value returned by pkgconfig with the given argument applied to the current package*/
         string run(string const& argument) const;
      };
+
+    /** Runs many queries with the pkg-config program
+     *
+     * A query is about a set of packages, given as on the pkg-config
+     * command line ("gtk+-3.0 glib-2.0 >= 2.50"), and gets the flags of
+     * the whole set from a single run of pkg-config. Identical queries
+     * are run only once, and run() starts several pkg-config at the
+     * same time.
+     *
+     * The results are saved in pkgconfig.cache, in the directory given
+     * by config_file::cache_directory(), along with the path,
+     * modification time and size of the .pc files of the packages and of
+     * the packages they require. A saved result is used as long as none
+     * of these files changes. The .pc files are looked for as the Native
+     * backend does: the queries are not cached when one of the packages
+     * cannot be found that way, or when one of the PKG_CONFIG_* variables
+     * that backend does not support is set.
+     */
+    class pkgconfig_batch : boost::noncopyable
+    {
+    public:
+        enum Query {
+            Exists,   /// pkg-config --exists
+            Version,  /// pkg-config --modversion, one line per package
+            Compiler, /// the flags of pkgconfig::compiler
+            Linker    /// the flags of pkgconfig::linker
+        };
+
+        pkgconfig_batch();
+        ~pkgconfig_batch();
+
+        /** Adds a query and returns its index. \c mode is only used by
+         * the Compiler and Linker queries. Identical queries get the same
+         * index */
+        std::size_t add(std::string const& packages, Query query, pkgconfig::Modes mode = pkgconfig::All);
+        /** Adds a query for the value of the variable \c name */
+        std::size_t variable(std::string const& packages, std::string const& name);
+
+        /** Resolves the queries added since the last call, running at
+         * most \c thread_count pkg-config at the same time, one per CPU
+         * if zero
+         *
+         * @throws unix_error if pkg-config cannot be started */
+        void run(unsigned int thread_count = 0);
+
+        /** The number of different queries */
+        std::size_t size() const;
+        /** False if pkg-config failed, for instance because one of the
+         * packages is not available. An Exists query has no other result */
+        bool found(std::size_t query) const;
+        /** The output of pkg-config, without the blanks at both ends. It
+         * is empty if the query failed */
+        std::string const& result(std::size_t query) const;
+        /** How many times the last run() started pkg-config */
+        std::size_t process_count() const;
+
+    private:
+        struct entry
+        {
+            /** The pkg-config arguments, the package names last */
+            std::vector<std::string> command;
+            std::string packages;
+            bool done;
+            bool found;
+            std::string result;
+        };
+        std::vector<entry> m_entries;
+        boost::unordered_map<std::string, std::size_t> m_index;
+        std::size_t m_process_count;
+
+        std::size_t add(std::string const& packages, std::string const& arguments);
+    };
 }
 
 #endif
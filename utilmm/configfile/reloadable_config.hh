@@ -0,0 +1,85 @@
+#ifndef UTILMM_RELOADABLE_CONFIG_HH
+#define UTILMM_RELOADABLE_CONFIG_HH
+
+#include <utilmm/configfile/configfile.hh>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace utilmm
+{
+    /** A configuration file which is reloaded when it changes
+     *
+     * The directory of the file is watched with inotify, so that the
+     * file is reloaded whether it is modified in place or replaced. The
+     * file is parsed by a background thread, and the new tree replaces
+     * the current one atomically: readers get the current tree with
+     * \c current and never wait for a reload.
+     *
+     * After each reload, the subscribers get the new tree and the list
+     * of the values which changed. If the new file cannot be parsed, the
+     * current tree is kept.
+     */
+    class reloadable_config : private boost::noncopyable
+    {
+    public:
+        typedef boost::shared_ptr<config_file const> snapshot;
+        /** Paths of the changed values. The path of a value is the path
+         * of its set (see config_set::lookup) followed by its key, e.g.
+         * "a/b/key". The nth child of a given name, when n > 0, is
+         * named "name[n]" */
+        typedef std::vector<std::string> key_list;
+        typedef boost::function<void (snapshot const&, key_list const&)> subscriber;
+
+        /** Loads \c name and starts watching it
+         * @throw not_found, parse_error */
+        explicit reloadable_config(std::string const& name);
+        /** Stops watching the file */
+        ~reloadable_config();
+
+        /** The file path */
+        std::string const& path() const;
+        /** The last successfully loaded tree */
+        snapshot current() const;
+
+        /** Registers a callback, called by the reloading thread after
+         * each reload which changed something. The callbacks may call
+         * reload(). If reload() is also called by other threads, the
+         * callbacks of concurrent reloads may run at the same time
+         * @return an identifier for unsubscribe */
+        int subscribe(subscriber const& callback);
+        void unsubscribe(int id);
+
+        /** Reloads the file now, in the calling thread
+         * @return the changed keys
+         * @throw not_found, parse_error */
+        key_list reload();
+
+        /** The keys whose values differ between \c a and \c b */
+        static key_list diff(config_set const& a, config_set const& b);
+
+    private:
+        void watch();
+
+        std::string m_path;
+        mutable snapshot m_current;
+
+        boost::mutex m_reload_mutex;
+        boost::mutex m_subscribers_mutex;
+        std::map<int, subscriber> m_subscribers;
+        int m_next_id;
+
+        int m_inotify;
+        int m_stop;
+        boost::scoped_ptr<boost::thread> m_thread;
+    };
+}
+
+#endif
+
@@ -2,10 +2,70 @@
 #define UTILMM_CONFIGFILE_SHELL_EXPAND_HH
 
 #include <string>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility/string_view.hpp>
 
 namespace utilmm
 {
+    /** A set of environment variables
+     *
+     * It is usually a copy of the process environment taken by
+     * capture(), which shell_expand() can then use instead of getenv().
+     * Reading a const environment is thread-safe, and the result of
+     * the expansion does not depend on later changes of the process
+     * environment.
+     */
+    class environment
+    {
+        struct name_hash
+        {
+            std::size_t operator()(boost::string_view name) const
+            { return boost::hash_range(name.begin(), name.end()); }
+        };
+        struct name_equal
+        {
+            bool operator()(boost::string_view a, boost::string_view b) const
+            { return a == b; }
+        };
+        typedef boost::unordered_map<std::string, std::string, name_hash, name_equal> VariableMap;
+        VariableMap m_variables;
+
+    public:
+        /** An empty environment */
+        environment();
+
+        /** A copy of the current process environment */
+        static environment capture();
+
+        /** Sets the value of \c name */
+        void set(std::string const& name, std::string const& value);
+        /** The value of \c name, or NULL if it is not set. The pointer
+         * is valid until \c name is set again */
+        std::string const* get(boost::string_view name) const;
+
+        std::size_t size() const;
+    };
+
+    /** Expands the environment variables in \c text
+     *
+     * Variables are given either as $NAME or as ${NAME}, where NAME is
+     * made of letters, digits and underscores. ${NAME:-default} expands
+     * to \c default, itself expanded, if NAME is not set or empty.
+     * Unset variables expand to the empty string, and a '$' which does
+     * not start a variable reference is kept as-is.
+     *
+     * This version reads the process environment through getenv(), and
+     * must not run concurrently with changes of the environment.
+     */
     std::string shell_expand(std::string const& text);
+
+    /** Expands the variables in \c text using \c env instead of the
+     * process environment */
+    std::string shell_expand(boost::string_view text, environment const& env);
+
+    /** Appends the expansion of \c text using \c env to \c output */
+    void shell_expand(boost::string_view text, environment const& env, std::string& output);
 }
 
 #endif
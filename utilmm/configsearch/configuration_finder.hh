@@ -10,11 +10,47 @@ namespace utilmm {
 * Search for configuration files available within the current directory and 
 * pathes given by the ROCK_CONFIG_PATH variable
 *
+* By default, the directories are listed the first time a file is looked
+* for in them, and the next searches are answered from these listings. See
+* IndexMode for how the listings are kept up to date.
+*
 */
 class ConfigurationFinder
 {
 
 public: 
+	/**
+	* How the directory listings used by the searches are kept up to date
+	*/
+	enum IndexMode
+	{
+		/** No listing: check each candidate path on the file system */
+		NoIndex,
+		/** Keep the listings until invalidateIndex() is called */
+		StaticIndex,
+		/** Drop the listing of a directory as soon as a file is added to or
+		* removed from it, using inotify. The directories which do not exist
+		* are checked on every search. This is the default on Linux, and is
+		* the same as StaticIndex on the other systems */
+		WatchedIndex
+	};
+
+	/**
+	* Changes the index mode, and drops the current listings
+	*/
+	static void setIndexMode(IndexMode mode);
+
+	/**
+	* The current index mode
+	*/
+	static IndexMode getIndexMode();
+
+	/**
+	* Drops the directory listings, so that the next searches see the
+	* current content of the directories
+	*/
+	static void invalidateIndex();
+
 	/**
 	* Search for a file by name (no recursive search)
 	* \return The full path once the file was found, otherwise an empty string
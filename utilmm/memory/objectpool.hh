@@ -1,7 +1,7 @@
 #ifndef SIM_OBJECTPOOL_HH
 #define SIM_OBJECTPOOL_HH
 
-#include <list>
+#include <vector>
 #include <boost/noncopyable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <utilmm/memory/sweep.hh>
@@ -15,14 +15,16 @@ namespace utilmm
          * This class manages a list of heap-allocated
          * constructed objects.
          *
-         * The pool is thread-safe
+         * The pool is thread-safe. Objects are handed out in LIFO
+         * order, and putting an object back never allocates as long as
+         * the pool did not grow past its largest size.
          */
 
         template<typename T>
         class object_pool : boost::noncopyable
         {
             boost::mutex m_mutex;
-            std::list<T*> m_available;
+            std::vector<T*> m_available;
 
             typedef boost::mutex mutex;
 
@@ -33,10 +35,10 @@ namespace utilmm
             T* get() 
             { mutex::scoped_lock lock(m_mutex); 
                 if (m_available.empty())
-                    m_available.push_back(new T());
+                    return new T();
 
-                T* ret = m_available.front();
-                m_available.pop_front();
+                T* ret = m_available.back();
+                m_available.pop_back();
                 return ret;
             }
 
@@ -44,6 +46,20 @@ namespace utilmm
             { mutex::scoped_lock lock(m_mutex);
                 m_available.push_back(object);
             }
+
+            /** Makes sure that at least \c count objects are available */
+            void reserve(size_t count)
+            { mutex::scoped_lock lock(m_mutex);
+                m_available.reserve(count);
+                while (m_available.size() < count)
+                    m_available.push_back(new T());
+            }
+
+            /** The count of objects currently available */
+            size_t available()
+            { mutex::scoped_lock lock(m_mutex);
+                return m_available.size();
+            }
         };
 
         /** Get a pointer on a T object from an object pool,
@@ -9,8 +9,6 @@
 #include <utilmm/plugin/abstract_factory.hh>
 #include <utilmm/plugin/plugin_wrapper.hh>
 
-#include <iostream>
-
 namespace utilmm { namespace plugin {
 
     template<class BasePlugin, class Concrete, class Base, class Parameters>
@@ -23,7 +21,6 @@ namespace utilmm { namespace plugin {
     {                
         BasePlugin* create(dll_handle dll)
         {
-            std::cout << "CF: 0 args\n";
             return new plugin_wrapper<Concrete, boost::mpl::list<> >(dll);
         }
     };
@@ -34,7 +31,6 @@ namespace utilmm { namespace plugin {
     {                
         BasePlugin* create(dll_handle dll, A1 a1)
         {
-            std::cout << "CF: 1 args\n";
             return new plugin_wrapper<Concrete, boost::mpl::list<A1> >(dll, a1);
         }
     };
@@ -45,7 +41,6 @@ namespace utilmm { namespace plugin {
     {                
         BasePlugin* create(dll_handle dll, A1 a1, A2 a2)
         {
-            std::cout << "CF: 2 args\n";
             return new plugin_wrapper<Concrete, boost::mpl::list<A1, A2> >(dll, a1, a2);
         }
     };
@@ -7,35 +7,165 @@
 #define BOOST_DLL_HPP_VP_2004_08_24
 
 #include <string>
+#include <map>
+#include <vector>
 #include <stdexcept>
+#include <cstdlib>
+#include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
-#include <boost/bind.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/type_traits/remove_pointer.hpp>
 
 // FIXME: that's for Linux only
 #include <dlfcn.h> 
 
-#include <iostream>
-
 namespace utilmm { namespace plugin {
 
-    struct killer 
-    {
-        killer(void* h) : h(h) {}
-        template<class T>
-        void operator()(T)
+    namespace details {
+
+        /** Schedules the calls to dlclose() for the libraries whose last
+         * reference went away. That reference can be held by an object
+         * created from the library, and closing the library right away
+         * would then unmap the code of the destructor being run. The
+         * handles are closed by dll::collect() instead, which is called
+         * by the next call to open_dll() and at exit.
+         */
+        struct closed_handles
+        {
+            static closed_handles& instance()
+            {
+                // Never destroyed, so that libraries released by static
+                // destructors can still be added
+                static closed_handles* closed = new closed_handles;
+                return *closed;
+            }
+
+            void add(void* handle)
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+                m_handles.push_back(handle);
+                if (!m_registered)
+                {
+                    m_registered = true;
+                    std::atexit(&closed_handles::close_at_exit);
+                }
+            }
+
+            void close_all()
+            {
+                std::vector<void*> handles;
+                { boost::mutex::scoped_lock lock(m_mutex);
+                    handles.swap(m_handles);
+                }
+                for (std::size_t i = 0; i < handles.size(); ++i)
+                    dlclose(handles[i]);
+            }
+
+        private:
+            closed_handles() : m_registered(false) {}
+            static void close_at_exit() { instance().close_all(); }
+
+            boost::mutex m_mutex;
+            std::vector<void*> m_handles;
+            bool m_registered;
+        };
+
+        /** An opened library and the symbols already resolved in it. It
+         * is shared by all the dll objects referring to the same
+         * library, and the library is closed when the last of them (or
+         * the last symbol obtained through them) goes away.
+         */
+        class dll_state : boost::noncopyable
         {
-            std::cout << "Killing DLL\n";
-            dlclose(h);
+        public:
+            explicit dll_state(const std::string& name)
+                : m_handle(dlopen(name.c_str(), RTLD_LAZY|RTLD_GLOBAL))
+            {
+                if (!m_handle) {
+                    char const* error = dlerror();
+                    throw std::logic_error(std::string("Could not open DLL: ")
+                            + (error ? error : name));
+                }
+            }
+            ~dll_state() { closed_handles::instance().add(m_handle); }
+
+            void* symbol(const std::string& symbol_name)
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+                std::map<std::string, void*>::const_iterator it =
+                    m_symbols.find(symbol_name);
+                if (it != m_symbols.end())
+                    return it->second;
+
+                // Clear the error state.
+                dlerror();
+                void* address = dlsym(m_handle, symbol_name.c_str());
+                char* error = dlerror();
+                if (error) {
+                    throw std::logic_error(error);
+                }
+                m_symbols.insert(std::make_pair(symbol_name, address));
+                return address;
+            }
+
+        private:
+            void* m_handle;
+            boost::mutex m_mutex;
+            std::map<std::string, void*> m_symbols;
+        };
+
+        /** Returns the state of the library \c name, opening it if no
+         * dll object currently refers to it. Libraries released since the
+         * last call are closed afterwards, so that reopening one of them
+         * does not reload it. */
+        inline boost::shared_ptr<dll_state> open_dll(const std::string& name)
+        {
+            typedef std::map<std::string, boost::weak_ptr<dll_state> > cache_t;
+            static boost::mutex cache_mutex;
+            static cache_t cache;
+
+            boost::shared_ptr<dll_state> state;
+            { boost::mutex::scoped_lock lock(cache_mutex);
+                boost::weak_ptr<dll_state>& cached = cache[name];
+                state = cached.lock();
+                if (!state) {
+                    state.reset(new dll_state(name));
+                    cached = state;
+                }
+            }
+            closed_handles::instance().close_all();
+            return state;
         }
-        void* h;
-    };
+    }
 
+    /** A shared library, opened on the first symbol access
+     *
+     * A library is unloaded once no dll object, symbol or plugin object
+     * refers to it anymore, at the next call to collect(). collect() is
+     * called when another library is opened and at exit. It can also be
+     * called explicitly, for instance after the plugin objects have been
+     * deleted.
+     */
     class dll {
     public:
         dll() {} // TODO: should remove this or make non-public
         dll(const std::string& name) : m_name(name) {}
 
+        /** The library path, as given to the constructor */
+        const std::string& name() const { return m_name; }
+
+        /** Opens the library now instead of on the first symbol access.
+         * It is a no-op if the library is already opened.
+         */
+        void open() const { state(); }
+
+        /** Closes the libraries which are not referred to anymore. It
+         * must not be called from the code of such a library, for
+         * instance from the destructor of a plugin object.
+         */
+        static void collect() { details::closed_handles::instance().close_all(); }
+
         template<typename SymbolType>
         boost::shared_ptr<
             typename boost::remove_pointer<SymbolType>::type> 
@@ -44,31 +174,30 @@ namespace utilmm { namespace plugin {
             // TODO: static assert that SymbolType is a pointer.
             typedef typename boost::remove_pointer<SymbolType>::type PointedType;
             
-            // Open the library. Yes, we do it on every access to 
-            // a symbol, see the design discussion in the documentation.
-            void* handle = dlopen(m_name.c_str(), RTLD_LAZY|RTLD_GLOBAL);
-            if (!handle) {
-                throw std::logic_error("Could not open DLL");
-            }
-            // Clear the error state.
-            dlerror();
-            void* address = dlsym(handle, symbol_name.c_str());
-            char* error = dlerror();
-            if (error) {
-                throw std::logic_error(error);
-            }
+            // The library is opened once and shared by all the dll
+            // objects referring to it, and resolved symbols are cached.
+            // The returned pointer keeps the library opened.
+            boost::shared_ptr<details::dll_state> s = state();
+            void* address = s->symbol(symbol_name);
             // Cast the to right type.
-            SymbolType s = (SymbolType)(address);
+            SymbolType sym = (SymbolType)(address);
 
-            boost::shared_ptr<PointedType> result(s, 
-                                                  //killer(handle));
-                                                  boost::bind(dlclose, handle));
-            
-            return result;            
+            return boost::shared_ptr<PointedType>(s, sym);
         }        
 
     private:
+        boost::shared_ptr<details::dll_state> state() const
+        {
+            boost::shared_ptr<details::dll_state> s = boost::atomic_load(&m_state);
+            if (!s) {
+                s = details::open_dll(m_name);
+                boost::atomic_store(&m_state, s);
+            }
+            return s;
+        }
+
         std::string m_name;
+        mutable boost::shared_ptr<details::dll_state> m_state;
     };
 
 }}
@@ -0,0 +1,388 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+#ifndef UTILMM_PLUGIN_LOADER_HH
+#define UTILMM_PLUGIN_LOADER_HH
+
+#include <utilmm/plugin/dll.hh>
+#include <utilmm/plugin/abstract_factory.hh>
+#include <utilmm/plugin/virtual_constructors.hh>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+#include <stdexcept>
+#include <time.h>
+
+#include <boost/any.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace utilmm { namespace plugin {
+
+    namespace details {
+        /** Monotonic time in seconds, used for the loader statistics */
+        inline double monotonic_time()
+        {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ts.tv_sec + ts.tv_nsec * 1e-9;
+        }
+    }
+
+    /** What a loader knows about one library. Times are in seconds. */
+    struct library_statistics
+    {
+        library_statistics()
+            : loaded(false), open_time(0), symbol_time(0)
+            , construct_time(0), objects(0) {}
+
+        std::string library;
+        /** True if the library has been opened successfully */
+        bool loaded;
+        /** Why the library could not be opened, empty otherwise */
+        std::string error;
+        /** Time spent in dlopen(), including the static constructors */
+        double open_time;
+        /** Time spent resolving the exported classes */
+        double symbol_time;
+        /** Total time spent in the constructors of the created objects */
+        double construct_time;
+        /** Count of objects created from this library */
+        std::size_t objects;
+    };
+
+    /** Loads the plugin libraries for \c BasePlugin and creates objects
+     * from them.
+     *
+     * Libraries given to load() are opened in the background by a pool
+     * of threads. Classes given to declare() are only looked for in
+     * their library, which is opened by the first create() needing it.
+     * The time spent opening each library, resolving its classes and
+     * constructing its objects is recorded, see statistics() and
+     * report().
+     *
+     * All methods are thread-safe.
+     */
+    template<class BasePlugin>
+    class loader : boost::noncopyable
+    {
+        typedef std::map<std::string, boost::any> exported_plugins_t;
+        typedef std::pair<abstract_factory<BasePlugin>*, dll_handle> resolved_factory;
+
+        enum library_state { Declared, Queued, Loading, Loaded, Failed };
+        struct library_entry
+        {
+            library_entry(std::string const& name)
+                : module(name), state(Declared)
+            { stats.library = name; }
+
+            dll module;
+            library_state state;
+            library_statistics stats;
+        };
+
+        struct class_entry
+        {
+            class_entry() : library(0), factory(0, dll_handle()) {}
+            library_entry* library;
+            resolved_factory factory;
+        };
+
+        typedef std::map<std::string, boost::shared_ptr<library_entry> > library_map;
+        typedef boost::unordered_map<std::string, class_entry> class_map;
+
+        mutable boost::mutex m_mutex;
+        boost::condition_variable m_changed;
+        library_map m_libraries;
+        class_map   m_classes;
+        std::deque<library_entry*> m_queue;
+        std::size_t m_pending;
+        bool m_stop;
+        boost::thread_group m_threads;
+
+    public:
+        /** Starts \c thread_count loading threads, one per CPU if zero */
+        explicit loader(unsigned int thread_count = 0)
+            : m_pending(0), m_stop(false)
+        {
+            if (thread_count == 0)
+                thread_count = boost::thread::hardware_concurrency();
+            if (thread_count == 0)
+                thread_count = 1;
+            for (unsigned int i = 0; i < thread_count; ++i)
+                m_threads.create_thread(boost::bind(&loader::worker, this));
+        }
+
+        /** Finishes the pending loads and stops the threads. The objects
+         * already created keep their library loaded. */
+        ~loader()
+        {
+            { boost::mutex::scoped_lock lock(m_mutex);
+                m_stop = true;
+            }
+            m_changed.notify_all();
+            m_threads.join_all();
+        }
+
+        /** Queues \c library to be opened in the background. It is a no-op
+         * if the library is already loaded or queued. */
+        void load(std::string const& library)
+        {
+            { boost::mutex::scoped_lock lock(m_mutex);
+                library_entry& lib = get_library(library);
+                if (lib.state != Declared)
+                    return;
+                lib.state = Queued;
+                ++m_pending;
+                m_queue.push_back(&lib);
+            }
+            m_changed.notify_all();
+        }
+
+        /** Declares that \c klass is exported by \c library. The library
+         * is opened by the first create() of one of its classes, unless
+         * load() is called for it. */
+        void declare(std::string const& klass, std::string const& library)
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            class_entry& c = m_classes[klass];
+            if (!c.factory.first)
+                c.library = &get_library(library);
+        }
+
+        /** Waits for all the libraries being loaded */
+        void wait()
+        {
+            boost::unique_lock<boost::mutex> lock(m_mutex);
+            while (m_pending)
+                m_changed.wait(lock);
+        }
+
+        /** Creates an object of class \c klass
+         *
+         * If the class is not known yet, waits for the pending loads.
+         * @throws std::logic_error if the class cannot be found or its
+         * library cannot be opened
+         */
+        BasePlugin* create(std::string const& klass)
+        {
+            std::pair<resolved_factory, library_entry*> r = resolve(klass);
+            double start = details::monotonic_time();
+            BasePlugin* result = r.first.first->create(r.first.second);
+            constructed(*r.second, details::monotonic_time() - start);
+            return result;
+        }
+
+        template<class A1>
+        BasePlugin* create(std::string const& klass, A1 a1)
+        {
+            std::pair<resolved_factory, library_entry*> r = resolve(klass);
+            double start = details::monotonic_time();
+            BasePlugin* result = r.first.first->create(r.first.second, a1);
+            constructed(*r.second, details::monotonic_time() - start);
+            return result;
+        }
+
+        template<class A1, class A2>
+        BasePlugin* create(std::string const& klass, A1 a1, A2 a2)
+        {
+            std::pair<resolved_factory, library_entry*> r = resolve(klass);
+            double start = details::monotonic_time();
+            BasePlugin* result = r.first.first->create(r.first.second, a1, a2);
+            constructed(*r.second, details::monotonic_time() - start);
+            return result;
+        }
+
+        /** The statistics of all the known libraries, sorted by name */
+        std::vector<library_statistics> statistics() const
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            std::vector<library_statistics> result;
+            for (typename library_map::const_iterator it = m_libraries.begin();
+                    it != m_libraries.end(); ++it)
+                result.push_back(it->second->stats);
+            return result;
+        }
+
+        /** Writes a table of statistics(), times in milliseconds */
+        void report(std::ostream& out) const
+        {
+            std::vector<library_statistics> stats = statistics();
+
+            std::ios::fmtflags flags = out.flags();
+            out << std::setw(12) << "open (ms)" << std::setw(14) << "symbols (ms)"
+                << std::setw(12) << "ctor (ms)" << std::setw(9) << "objects" << "  library\n";
+            out << std::fixed << std::setprecision(3);
+
+            library_statistics total;
+            for (std::vector<library_statistics>::const_iterator it = stats.begin();
+                    it != stats.end(); ++it)
+            {
+                out << std::setw(12) << it->open_time * 1e3
+                    << std::setw(14) << it->symbol_time * 1e3
+                    << std::setw(12) << it->construct_time * 1e3
+                    << std::setw(9) << it->objects << "  " << it->library;
+                if (!it->error.empty())
+                    out << " (failed: " << it->error << ")";
+                else if (!it->loaded)
+                    out << " (not loaded)";
+                out << "\n";
+
+                total.open_time      += it->open_time;
+                total.symbol_time    += it->symbol_time;
+                total.construct_time += it->construct_time;
+                total.objects        += it->objects;
+            }
+            out << std::setw(12) << total.open_time * 1e3
+                << std::setw(14) << total.symbol_time * 1e3
+                << std::setw(12) << total.construct_time * 1e3
+                << std::setw(9) << total.objects << "  total" << std::endl;
+            out.flags(flags);
+        }
+
+    private:
+        /** Must be called with m_mutex locked */
+        library_entry& get_library(std::string const& name)
+        {
+            boost::shared_ptr<library_entry>& lib = m_libraries[name];
+            if (!lib)
+                lib.reset(new library_entry(name));
+            return *lib;
+        }
+
+        /** Returns the factory for \c klass, loading its library in the
+         * current thread if it is declared and not loaded yet */
+        std::pair<resolved_factory, library_entry*> resolve(std::string const& klass)
+        {
+            boost::unique_lock<boost::mutex> lock(m_mutex);
+            for (;;)
+            {
+                typename class_map::const_iterator it = m_classes.find(klass);
+                library_entry* lib = (it == m_classes.end()) ? 0 : it->second.library;
+                if (lib && it->second.factory.first)
+                    return std::make_pair(it->second.factory, lib);
+
+                if (!lib)
+                {
+                    if (!m_pending)
+                        throw std::logic_error("Class of the specified name is not found");
+                    m_changed.wait(lock);
+                    continue;
+                }
+
+                switch (lib->state)
+                {
+                    case Declared:
+                        ++m_pending;
+                        // fall through
+                    case Queued:
+                        // The loading thread skips libraries that are not
+                        // queued anymore
+                        lib->state = Loading;
+                        lock.unlock();
+                        open(*lib);
+                        lock.lock();
+                        break;
+                    case Loading:
+                        m_changed.wait(lock);
+                        break;
+                    case Failed:
+                        throw std::logic_error("Could not load " + lib->stats.library
+                                + ": " + lib->stats.error);
+                    case Loaded:
+                        throw std::logic_error("Class " + klass + " is not exported by "
+                                + lib->stats.library);
+                }
+            }
+        }
+
+        /** Opens \c lib and resolves its classes. The library must be in
+         * the Loading state, and m_mutex must not be locked. */
+        void open(library_entry& lib)
+        {
+            std::vector< std::pair<std::string, resolved_factory> > classes;
+            std::string error;
+            double start = details::monotonic_time(), opened = start;
+            try
+            {
+                lib.module.open();
+                opened = details::monotonic_time();
+
+                typedef exported_plugins_t& (*get_plugins_list_t)();
+                dll_handle f = lib.module.template get<get_plugins_list_t>("boost_exported_plugins_list");
+                exported_plugins_t& e = (*f)();
+                for (exported_plugins_t::iterator it = e.begin(); it != e.end(); ++it)
+                {
+                    abstract_factory<BasePlugin>** xw =
+                        boost::any_cast<abstract_factory<BasePlugin>*>(&it->second);
+                    if (xw)
+                        classes.push_back(std::make_pair(it->first, resolved_factory(*xw, f)));
+                }
+            }
+            catch(std::logic_error const& e)
+            { error = e.what(); }
+            double resolved = details::monotonic_time();
+
+            { boost::mutex::scoped_lock lock(m_mutex);
+                lib.stats.open_time   = opened - start;
+                lib.stats.symbol_time = error.empty() ? resolved - opened : 0;
+                lib.stats.error  = error;
+                lib.stats.loaded = error.empty();
+                lib.state = error.empty() ? Loaded : Failed;
+                for (std::size_t i = 0; i < classes.size(); ++i)
+                {
+                    class_entry& c = m_classes[classes[i].first];
+                    c.library = &lib;
+                    c.factory = classes[i].second;
+                }
+                --m_pending;
+            }
+            m_changed.notify_all();
+        }
+
+        void constructed(library_entry& lib, double duration)
+        {
+            boost::mutex::scoped_lock lock(m_mutex);
+            lib.stats.construct_time += duration;
+            ++lib.stats.objects;
+        }
+
+        void worker()
+        {
+            boost::unique_lock<boost::mutex> lock(m_mutex);
+            for (;;)
+            {
+                while (m_queue.empty() && !m_stop)
+                    m_changed.wait(lock);
+                if (m_queue.empty())
+                    return;
+
+                library_entry* lib = m_queue.front();
+                m_queue.pop_front();
+                if (lib->state != Queued)
+                    continue;
+
+                lib->state = Loading;
+                lock.unlock();
+                open(*lib);
+                lock.lock();
+            }
+        }
+    };
+
+}}
+
+#endif
+
+/** @file utilmm/plugin/loader.hh
+ * @brief Concurrent and lazy loading of plugin libraries
+ */
@@ -12,12 +12,146 @@
 #include <utility>
 #include <stdexcept>
 #include <string>
-#include <utility>
+#include <vector>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/weak_ptr.hpp>
 
 namespace utilmm { namespace plugin {
 
+    typedef std::map<std::string, boost::any> exported_plugins_t;
+
+    namespace details {
+
+        /** Process-wide cache of the factories already resolved for a
+         * given plugin base type, keyed by library and class name. It
+         * only holds weak references, so it does not keep libraries
+         * loaded by itself.
+         */
+        template<class BasePlugin>
+        class factory_cache : boost::noncopyable
+        {
+        public:
+            typedef std::pair<abstract_factory<BasePlugin>*, dll_handle> value_type;
+
+            static factory_cache& instance()
+            {
+                static factory_cache cache;
+                return cache;
+            }
+
+            bool find(const std::string& library, const std::string& klass, value_type& result)
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+                typename map_type::const_iterator it =
+                    m_map.find(lookup_key(library, klass), key_hash(), key_equal());
+                if (it == m_map.end())
+                    return false;
+
+                result.second = it->second.second.lock();
+                if (!result.second)
+                    return false;
+                result.first = it->second.first;
+                return true;
+            }
+
+            void insert(const std::string& library, const std::string& klass, value_type const& value)
+            {
+                boost::mutex::scoped_lock lock(m_mutex);
+                m_map[key_type(library, klass)] =
+                    entry_type(value.first, boost::weak_ptr<dll_handle::element_type>(value.second));
+            }
+
+        private:
+            typedef std::pair<std::string, std::string> key_type;
+            typedef std::pair< abstract_factory<BasePlugin>*,
+                               boost::weak_ptr<dll_handle::element_type> > entry_type;
+
+            /** Allows lookups without copying the strings in a key_type */
+            struct lookup_key
+            {
+                lookup_key(const std::string& library, const std::string& klass)
+                    : library(library), klass(klass) {}
+                const std::string& library;
+                const std::string& klass;
+            };
+            struct key_hash
+            {
+                static std::size_t hash(const std::string& library, const std::string& klass)
+                {
+                    std::size_t seed = 0;
+                    boost::hash_combine(seed, library);
+                    boost::hash_combine(seed, klass);
+                    return seed;
+                }
+                std::size_t operator()(key_type const& key) const
+                { return hash(key.first, key.second); }
+                std::size_t operator()(lookup_key const& key) const
+                { return hash(key.library, key.klass); }
+            };
+            struct key_equal
+            {
+                bool operator()(key_type const& a, key_type const& b) const
+                { return a == b; }
+                bool operator()(lookup_key const& a, key_type const& b) const
+                { return a.library == b.first && a.klass == b.second; }
+                bool operator()(key_type const& a, lookup_key const& b) const
+                { return b.library == a.first && b.klass == a.second; }
+            };
+            typedef boost::unordered_map<key_type, entry_type, key_hash, key_equal> map_type;
+
+            factory_cache() {}
+
+            boost::mutex m_mutex;
+            map_type m_map;
+        };
+
+        /** Registers all the classes \c d exports for \c BasePlugin in
+         * the factory cache
+         *
+         * @return the count of registered classes
+         */
+        template<class BasePlugin>
+        std::size_t register_exported(const dll& d)
+        {
+            typedef exported_plugins_t& (*get_plugins_list_t)();
+            dll_handle f = d.template get<get_plugins_list_t>("boost_exported_plugins_list");
+            exported_plugins_t& e = (*f)();
+
+            std::size_t count = 0;
+            for (exported_plugins_t::iterator it = e.begin(); it != e.end(); ++it)
+            {
+                abstract_factory<BasePlugin>** xw = 
+                    boost::any_cast<abstract_factory<BasePlugin>*>(&it->second);
+                if (!xw)
+                    continue;
+
+                factory_cache<BasePlugin>::instance().insert(d.name(), it->first, std::make_pair(*xw, f));
+                ++count;
+            }
+            return count;
+        }
+
+        /** \c loaded is a vector of char and not of bool, as the
+         * elements of a vector<bool> cannot be written concurrently */
+        template<class BasePlugin>
+        void preload_worker(std::vector<dll> const& libraries, std::vector<char>& loaded,
+                boost::atomic<std::size_t>& next)
+        {
+            for (std::size_t i = next++; i < libraries.size(); i = next++)
+            {
+                try { loaded[i] = (register_exported<BasePlugin>(libraries[i]) > 0); }
+                catch(std::logic_error const&) { }
+            }
+        }
+    }
+
     namespace {
-        typedef std::map<std::string, boost::any> exported_plugins_t;
         typedef exported_plugins_t& (*get_plugins_list_t)();
         typedef exported_plugins_t& (get_plugins_list_np)();
 
@@ -26,20 +160,28 @@ namespace utilmm { namespace plugin {
                   dll_handle >
         get_abstract_factory(const dll& d, const std::string& klass)
         {
+            typedef details::factory_cache<BasePlugin> cache_t;
+            typename cache_t::value_type result;
+            if (cache_t::instance().find(d.name(), klass, result))
+                return result;
+
             boost::shared_ptr<get_plugins_list_np> f; 
             f = d.template get<exported_plugins_t& (*)()>("boost_exported_plugins_list");    
             exported_plugins_t& e = (*f)();
             
-            if (e.count(klass)) {
+            exported_plugins_t::iterator it = e.find(klass);
+            if (it != e.end()) {
 
                 abstract_factory<BasePlugin>** xw = 
-                    boost::any_cast<abstract_factory<BasePlugin>*>(&(e[klass]));
+                    boost::any_cast<abstract_factory<BasePlugin>*>(&it->second);
 
                 if (!xw) {
                     throw std::logic_error("Can't cast to the right factor type\n");                    
                 }
                 abstract_factory<BasePlugin>* w = *xw;
-                return make_pair(w, f);
+                result = make_pair(w, f);
+                cache_t::instance().insert(d.name(), klass, result);
+                return result;
             } else {
                 throw std::logic_error("Class of the specified name is not found");
             }
@@ -47,12 +189,77 @@ namespace utilmm { namespace plugin {
 
     }
 
+    /** Opens all the libraries of \c dir and registers the classes
+     * they export for \c BasePlugin, so that creating them later does
+     * not need to look them up. Libraries are opened by \c
+     * thread_count threads (one per CPU if zero). Files that are not
+     * plugin libraries are ignored.
+     *
+     * @return the loaded libraries. They stay loaded as long as these
+     * dll objects (or objects created from them) exist.
+     */
+    template<class BasePlugin>
+    std::vector<dll> preload(const boost::filesystem::path& dir, unsigned int thread_count = 0)
+    {
+        std::vector<dll> libraries;
+        boost::filesystem::directory_iterator it(dir), end;
+        for (; it != end; ++it)
+        {
+            if (boost::filesystem::is_regular_file(it->status())
+                    && it->path().extension() == ".so")
+                libraries.push_back(dll(it->path().string()));
+        }
 
+        if (thread_count == 0)
+            thread_count = boost::thread::hardware_concurrency();
+        if (thread_count > libraries.size())
+            thread_count = libraries.size();
 
+        std::vector<char> loaded(libraries.size(), false);
+        boost::atomic<std::size_t> next(0);
+        boost::thread_group threads;
+        for (unsigned int i = 1; i < thread_count; ++i)
+            threads.create_thread(boost::bind(&details::preload_worker<BasePlugin>,
+                        boost::cref(libraries), boost::ref(loaded), boost::ref(next)));
+        details::preload_worker<BasePlugin>(libraries, loaded, next);
+        threads.join_all();
+
+        std::vector<dll> result;
+        for (std::size_t i = 0; i < libraries.size(); ++i)
+        {
+            if (loaded[i])
+                result.push_back(libraries[i]);
+        }
+        return result;
+    }
+
+    /** Root of the plugin_factory hierarchy. It caches the factories
+     * already resolved by this plugin_factory object, so that creating
+     * an object of a known class is a single hash lookup. As for the
+     * standard containers, a given plugin_factory object must not be
+     * used by several threads at the same time.
+     */
+    template<class BasePlugin>
     struct empty_plugin_factory_item {
         void create(int****);
     protected:
+        typedef std::pair<abstract_factory<BasePlugin>*, dll_handle> resolved_factory;
+
+        resolved_factory const& resolve(const std::string& name)
+        {
+            typename resolved_map::const_iterator it = m_resolved.find(name);
+            if (it != m_resolved.end())
+                return it->second;
+
+            resolved_factory r = get_abstract_factory<BasePlugin>(m_dll, name);
+            return m_resolved.insert(std::make_pair(name, r)).first->second;
+        }
+
         dll m_dll;
+
+    private:
+        typedef boost::unordered_map<std::string, resolved_factory> resolved_map;
+        resolved_map m_resolved;
     };
 
     template<class BasePlugin, class Base, class Parameters>
@@ -64,8 +271,7 @@ namespace utilmm { namespace plugin {
         using Base::create;
         BasePlugin* create(const std::string& name)
         {
-            std::pair<abstract_factory<BasePlugin>*,
-                dll_handle > r = get_abstract_factory<BasePlugin>(this->m_dll, name);
+            typename Base::resolved_factory const& r = this->resolve(name);
             return r.first->create(r.second);            
         }
     };
@@ -75,8 +281,7 @@ namespace utilmm { namespace plugin {
         using Base::create;
         BasePlugin* create(const std::string& name, A1 a1)
         {
-            std::pair<abstract_factory<BasePlugin>*,
-                dll_handle > r = get_abstract_factory<BasePlugin>(this->m_dll, name);
+            typename Base::resolved_factory const& r = this->resolve(name);
             return r.first->create(r.second, a1);            
         }
     };
@@ -86,8 +291,7 @@ namespace utilmm { namespace plugin {
         using Base::create;
         BasePlugin* create(const std::string& name, A1 a1, A2 a2)
         {
-            std::pair<abstract_factory<BasePlugin>*,
-                dll_handle > r = get_abstract_factory<BasePlugin>(this->m_dll, name);
+            typename Base::resolved_factory const& r = this->resolve(name);
             return r.first->create(r.second, a1, a2);            
         }
     };
@@ -112,7 +316,7 @@ namespace utilmm { namespace plugin {
         public boost::mpl::inherit_linearly<
         typename virtual_constructors<BasePlugin>::type,
         plugin_factory_item<BasePlugin, _, _>,
-        empty_plugin_factory_item>::type 
+        empty_plugin_factory_item<BasePlugin> >::type 
     {        
         plugin_factory(const dll& d)
         {
@@ -9,8 +9,6 @@
 #include <boost/mpl/list.hpp>
 #include <boost/shared_ptr.hpp>
 
-#include <iostream>
-
 namespace utilmm { namespace plugin {
 
     template<class Wrapped, class Parameters>
@@ -18,10 +16,6 @@ namespace utilmm { namespace plugin {
 
     struct dll_handle_holder {
         dll_handle_holder(dll_handle dll) : m_dll(dll) {}
-        ~dll_handle_holder()
-        {
-            std::cout << "DLL handle is dying\n";
-        }
     private:
         dll_handle m_dll;
     };
@@ -45,9 +39,7 @@ namespace utilmm { namespace plugin {
     struct plugin_wrapper<Wrapped, boost::mpl::list<A1, A2> > 
         : public dll_handle_holder, Wrapped {        
         plugin_wrapper(dll_handle dll, A1 a1, A2 a2) : 
-        dll_handle_holder(dll), Wrapped(a1, a2) {
-            std::cout << "plugin_wrapper: " << a1 << " : " << a2 << "\n";
-        }
+        dll_handle_holder(dll), Wrapped(a1, a2) {}
     };
 
 }}
@@ -6,6 +6,7 @@
 
 # include <string>
 #include <boost/utility.hpp>
+#include <boost/atomic.hpp>
 
 #include "utilmm/singleton/bits/server_fwd.hh"
 
@@ -18,6 +19,28 @@ namespace utilmm {
         virtual ~dummy_factory() {};
         virtual dummy* create() const = 0;
       };
+
+      /** @brief Per-type cache of a resolved singleton
+       *
+       * Each @c utilmm::singleton::wrapper instantiation owns one of
+       * these. The server fills it on attach and clears it once the
+       * last client of this cache detaches, so that steady-state
+       * accesses do not have to go through the server.
+       */
+      typedef boost::atomic<dummy *> instance_cache;
+
+      /** @brief Registry key of a singleton type
+       *
+       * It is built once per type from the type's mangled name. The
+       * hash only depends on that name so that all the shared libraries
+       * agree on it.
+       */
+      struct type_key {
+        explicit type_key(char const *type_name);
+
+        char const *name;
+        size_t hash;
+      };
     }
 
     /** @brief base class for @c utilmm::singleton::wrapper
@@ -38,32 +61,35 @@ namespace utilmm {
 
       /** @brief Attach a new singleton.
        *
-       * @param name Internal id of the singleton.
-       * @param inst Candidate as singleton.
+       * @param key Internal id of the singleton.
+       * @param factory Creator for the singleton.
+       * @param cache The caller's cache for this singleton
        *
        * This function called by @c wrapper::attach try to create a
-       * new singleton with @a name as unique id. If there's allready
-       * a singleton @a name then @a inst is deleted
+       * new singleton with @a key as unique id using @a factory, if
+       * there is none yet. On return, @a cache points to the singleton.
        */
-      static void attach(std::string const &name, details::dummy_factory const& factory);
+      static void attach(details::type_key const &key, details::dummy_factory const& factory,
+                         details::instance_cache &cache);
       /** @brief Detach to a singleton
        *
-       * @param name Internal id of a singleton
+       * @param key Internal id of a singleton
+       * @param cache The cache given to the matching attach
        * 
        * This function called by wrapper::detach indicate to the
-       * singleton server that the singleton identified as @a name has
+       * singleton server that the singleton identified as @a key has
        * lost one client. 
        */
-      static void detach(std::string const &name);
+      static void detach(details::type_key const &key, details::instance_cache &cache);
 
       /** @brief Singleton generic access
        *
-       * @param name Internal id of a singleton
+       * @param key Internal id of a singleton
        * 
        * @return a pointer to the dummy wrapper of the singleton
-       * attached to @a name
+       * attached to @a key
        */
-      static dummy *instance(std::string const &name);
+      static dummy *instance(details::type_key const &key);
 
     private:
       void incr_ref() const;
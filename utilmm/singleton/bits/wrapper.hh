@@ -61,7 +61,9 @@ namespace utilmm {
       wrapper();
       ~wrapper();
 
-      static std::string name();
+      static details::type_key const &key();
+
+      static details::instance_cache cache;
 
       Ty value;
 
@@ -22,6 +22,9 @@ namespace utilmm {
     /*
      * class utilmm::singleton::wrapper<>
      */
+    template<typename Ty>
+    details::instance_cache wrapper<Ty>::cache(0);
+
     // structors
     template<typename Ty>
     wrapper<Ty>::wrapper() {}
@@ -31,27 +34,34 @@ namespace utilmm {
 
     // statics
     template<typename Ty>
-    inline std::string wrapper<Ty>::name() {
-      return typeid(Ty).name();
+    inline details::type_key const &wrapper<Ty>::key() {
+      static details::type_key const the_key(typeid(Ty).name());
+      return the_key;
     }
     
     template<typename Ty>
     void wrapper<Ty>::attach() {
-      dummy::attach(name(), details::wrapper_factory<Ty>());
+      dummy::attach(key(), details::wrapper_factory<Ty>(), cache);
     }
 
     template<typename Ty>
     void wrapper<Ty>::detach() {
-      dummy::detach(name());
+      dummy::detach(key(), cache);
     }
 
     template<typename Ty>
     Ty &wrapper<Ty>::instance() {
+      // Once attached, the cache holds the server's instance. Only
+      // fall back to the (locked) server lookup if it does not.
+      dummy *inst = cache.load(boost::memory_order_acquire);
+      if( 0==inst )
+        inst = dummy::instance(key());
+
         // dynamic_cast fails on gcc 3.3.5. Don't know why, the types
         // seem right :(
         // Fall back to static_cast 
-      // return dynamic_cast<wrapper *>(dummy::instance(name()))->value;
-      return static_cast<wrapper *>(dummy::instance(name()))->value;
+      // return dynamic_cast<wrapper *>(inst)->value;
+      return static_cast<wrapper *>(inst)->value;
     }
 
   } // namespace utilm::singleton
@@ -2,6 +2,7 @@
 #define UTILMM_PROCESS_H
 #include "utilmm/config/config.h"
 #include <utilmm/system/system.hh>
+#include <boost/atomic.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/filesystem/path.hpp>
 
@@ -9,24 +10,72 @@
 #include <map>
 #include <list>
 #include <signal.h>
+#include <stdint.h>
+
+struct rusage;
 
 namespace utilmm
 {
+    namespace details { struct process_slot; }
+
+    /** The resources used by a child process. Times are in seconds
+     *
+     * @ingroup system
+     */
+    struct resource_usage
+    {
+        resource_usage()
+            : user_time(0), system_time(0), max_rss(0)
+            , read_bytes(0), write_bytes(0), start_time(0), exit_time(0) {}
+
+        /** CPU time spent in user mode and in the kernel */
+        double user_time;
+        double system_time;
+        /** Peak resident set size, in kilobytes */
+        long max_rss;
+        /** Bytes read from and written to the storage layer */
+        uint64_t read_bytes;
+        uint64_t write_bytes;
+        /** Wall-clock time, since the epoch, at which the process was
+         * started and at which its exit was noticed. The exit is noticed
+         * immediately by a process_manager, and by wait() or running()
+         * otherwise. exit_time is zero while the process runs */
+        double start_time;
+        double exit_time;
+    };
+
     /** An external process
      *
      * @ingroup system
      * @author Sylvain Joyeux <sylvain.joyeux@laas.fr>
      */
-    class process
+    class process : boost::noncopyable
     {
     public:
         static const int InvalidHandle = -1;
         /** Definition of the streams we can redirect to */
-        enum Stream { Stdout = 1, Stderr = 2 };
+        enum Stream { Stdin = 0, Stdout = 1, Stderr = 2 };
+
+        /** How start() creates the child process */
+        enum Launcher
+        {
+            /** fork() then exec. Copying the page tables of the parent makes
+             * it slow when the parent uses a lot of memory */
+            Fork,
+            /** posix_spawn(), which does not copy the address space of the
+             * parent. This is the default when it is available. start()
+             * uses Fork instead if the PATH variable is overriden by
+             * set_environment, or if a working directory is set and the C
+             * library cannot change it in posix_spawn() */
+            Spawn
+        };
 
     private:
-        typedef std::list<process*>::iterator ProcessHandle;
-        ProcessHandle m_handle;
+        friend class process_manager;
+        friend class process_pool;
+
+        /** Where killall() finds the pid of the running process */
+        details::process_slot* m_slot;
 
         boost::filesystem::path m_wdir;
         typedef std::list<std::string> CommandLine;
@@ -40,18 +89,71 @@ namespace utilmm
             bool is_null() const;
             void redirect(FILE* stream);
         };
-        output_file m_stdout, m_stderr;
+        output_file m_stdin, m_stdout, m_stderr;
         output_file& get_stream(Stream stream);
 
-        bool  m_running;
+        /** A stream connected to a pipe by capture() */
+        struct captured_stream
+        {
+            captured_stream() : enabled(false), fd(InvalidHandle), offset(0) {}
+            bool enabled;
+            /** The parent's end of the pipe */
+            int  fd;
+            /** The output read so far, or the input to write */
+            std::string data;
+            /** How much of the input has been written */
+            std::string::size_type offset;
+        };
+        captured_stream m_captured[3];
+        void open_captures();
+        void close_captures();
+
+        /** Set by the thread which reaps the process, after the exit
+         * status */
+        boost::atomic<bool> m_running;
+        /** True if a process_manager reaps the process */
+        boost::atomic<bool> m_managed;
+        /** Set once the process exited and is about to be reaped by
+         * another thread. The pid may then be reused, and signal() does
+         * nothing */
+        bool m_reaping;
         pid_t m_pid;
         bool  m_normalexit;
         int   m_status;
+        resource_usage m_usage;
 
 	bool m_do_setpgid;
 	pid_t m_pgid;
+        Launcher m_launcher;
+
+        void start_fork(char* const* argv, char* const* envp);
+        void start_spawn(char* const* argv, char* const* envp);
 
         bool wait(bool hang);
+        /** Called by the process_manager once the process has been reaped */
+        void reaped(int status, rusage const* usage);
+        /** Sets the exit status of a managed process, and makes it an
+         * unmanaged process which is not running */
+        void set_exit_status(bool normal, int status, rusage const* usage = 0);
+        /** Makes the process running until a process_pool sets its exit
+         * status */
+        void set_queued();
+        /** Called by the thread which reaps the process, after it
+         * exited and before reaping it. Once it returns, neither
+         * signal(), killall() nor sample_usage() use the pid anymore */
+        void set_reaping();
+        void set_managed(bool managed);
+        void set_running(pid_t pid);
+        void set_finished();
+        /** Writes the input without blocking
+         * @return false once all the input is written, or if the child
+         * closed its end of the pipe */
+        bool write_input();
+        /** Reads from the pipe of \c stream without blocking
+         * @return the count of bytes read, 0 at end of file or on error,
+         * and -1 if no data is available */
+        ssize_t read_captured(Stream stream, char* buffer, size_t size);
+        void append_output(Stream stream, char const* data, size_t size);
         void send_child_error(int fd, int error_type);
         void process_child_error(int fd);
 
@@ -81,7 +183,9 @@ namespace utilmm
         void clear();
 
         /** Start the process 
-         * \exception unix_error        an error occured while starting the process
+         * \exception unix_error        an error occured while starting the process,
+         *                              including when the working directory cannot
+         *                              be entered or the program cannot be executed
          * \exception already_running   this process object has already started
          */
         void start();
@@ -97,8 +201,9 @@ namespace utilmm
         /** Install a SIGINT handler which calls process::killall */
         static void install_sigint_handler();
 
-        /** Kill all processes managed by a process instance 
-         * It is safe to call this inside a signal handler */
+        /** Sends SIGINT to all the running processes started by a process
+         * instance. It is safe to call this inside a signal handler, and
+         * while other threads start processes */
         static void killall();
         
         /** Wait for the process to terminate 
@@ -147,6 +252,51 @@ namespace utilmm
 	/** \overload */
         void redirect_to( Stream stream, boost::filesystem::path const& file);
 
+        /** Connects \c stream to a pipe when the process starts
+         *
+         * The parent's end of the pipe is non-blocking, and is available
+         * through captured_fd() until close_captured() is called. It
+         * replaces any redirection of \c stream, and is removed by
+         * redirect_to() and erase_redirection().
+         *
+         * communicate() and the process_manager write the input given to
+         * set_input() and read the outputs in output(), reading all the
+         * pipes at the same time so that the child never blocks on a full
+         * pipe.
+         *
+         * \code
+         *  process prs;
+         *  prs << "sort";
+         *  prs.set_input("b\na\n");
+         *  prs.capture(process::Stdout);
+         *  prs.start();
+         *  prs.communicate();
+         *  prs.wait();
+         *  std::string sorted = prs.output(process::Stdout);
+         * \endcode
+         */
+        void capture(Stream stream);
+        /** The parent's end of the pipe of \c stream, or InvalidHandle if
+         * the stream is not captured, the process has not been started or
+         * the pipe is closed */
+        int captured_fd(Stream stream) const;
+        /** Closes the parent's end of the pipe of \c stream. Closing the
+         * pipe of Stdin sends end-of-file to the child */
+        void close_captured(Stream stream);
+        /** Sets the data written to the standard input of the child by
+         * communicate() or the process_manager. It calls capture(Stdin) */
+        void set_input(std::string const& data);
+        /** Writes the input and reads the captured outputs until all the
+         * pipes are closed. It does not wait for the process to finish.
+         * It must not be called on a process started by a process_manager,
+         * which does it in its own thread
+         * \exception unix_error    an error occured
+         */
+        void communicate();
+        /** The data read from the pipe of \c stream since the process
+         * started */
+        std::string const& output(Stream stream) const;
+
 
         /** Override an environment variable
          * This function sets or overrides an environment variable for the 
@@ -166,14 +316,32 @@ namespace utilmm
 	/** Set the process group ID at startup. See setpgid(3) */
 	void set_pgid(pid_t pid);
 
+        /** Selects how start() creates the process */
+        void set_launcher(Launcher launcher);
+        /** How start() creates the process */
+        Launcher launcher() const;
+
         /** Check if the last running process exited normally */
         bool exit_normal() const;
         /** Get the exit status of the last running process */
         int exit_status() const;
 
-        /** Get the PID of the last running process */
+        /** The resources used by the last running process, as reported by
+         * wait4(). Only the start time is set while it is running */
+        resource_usage const& usage() const;
+        /** Reads the current resource usage of the running process from
+         * /proc. It only works on Linux, and max_rss and the I/O counters
+         * may not be available depending on the kernel configuration
+         * @return false if the process is not running or /proc could not
+         * be read */
+        bool sample_usage(resource_usage& usage) const;
+
+        /** Get the PID of the last running process. It is 0 while the
+         * process waits in a process_pool, and may be read while the
+         * worker of the pool starts it */
         pid_t pid() const;
-        /** Check if the process is running */
+        /** Check if the process is running. It only reads a flag if the
+         * process is reaped by a process_manager */
         bool  running();
     };
 }
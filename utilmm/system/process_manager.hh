@@ -0,0 +1,110 @@
+#ifndef UTILMM_PROCESS_MANAGER_HH
+#define UTILMM_PROCESS_MANAGER_HH
+
+#include <utilmm/system/process.hh>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+namespace utilmm
+{
+    /** Starts processes and reaps them from a single thread
+     *
+     * Each child is watched through a pidfd (pidfd_open(2)) registered
+     * in an epoll set, and a background thread reaps the children as
+     * soon as they exit. process::running() then only reads a flag, and
+     * process::wait() waits for the manager thread. On kernels without
+     * pidfd_open (before Linux 5.3), the thread checks the children
+     * every 10 ms instead.
+     *
+     * The same thread writes the input and drains the outputs of the
+     * streams captured by process::capture(), so that many children can
+     * write to pipes without needing a thread each. The outputs either
+     * go to process::output() or to an output callback. A process is
+     * only considered finished once it exited and all its pipes are
+     * closed, so its output is complete when process::wait() returns or
+     * the exit callback is called. Its captured streams must not be used
+     * by other threads until then.
+     *
+     * The manager keeps a reference on the processes it started until
+     * they have been reaped. When it is destroyed, the processes that
+     * are still running go back to being reaped by process::wait().
+     *
+     * This class is only available on Linux.
+     *
+     * @ingroup system
+     */
+    class process_manager : private boost::noncopyable
+    {
+    public:
+        typedef boost::shared_ptr<process> process_ptr;
+        /** Called from the manager thread once a process has been
+         * reaped. It must not throw */
+        typedef boost::function<void (process&)> exit_callback;
+        /** Called from the manager thread with the data read from a
+         * captured output, instead of appending it to process::output().
+         * The data is only valid during the call. It must not throw */
+        typedef boost::function<void (process&, process::Stream, char const*, std::size_t)> output_callback;
+
+        process_manager();
+        ~process_manager();
+
+        /** Starts \c prs, and calls \c on_exit once it exited
+         * @throws the exceptions of process::start */
+        void start(process_ptr const& prs, exit_callback const& on_exit = exit_callback(),
+                output_callback const& on_output = output_callback());
+
+        /** The number of processes started by this manager which have
+         * not been reaped yet */
+        std::size_t size() const;
+
+        /** Waits until all the processes have been reaped and their
+         * callbacks called */
+        void wait_all();
+
+        /** Sends \c signo to all the processes of this manager */
+        void signal_all(int signo = SIGINT);
+
+    private:
+        struct child;
+        /** The children are identified by a counter and not by their
+         * pid, as the pid of a child which has been reaped can be
+         * reused while its pipes are still open */
+        typedef uint32_t child_id;
+        typedef std::map<child_id, boost::shared_ptr<child> > child_map;
+
+        mutable boost::mutex m_mutex;
+        boost::condition_variable m_changed;
+        child_map m_children;
+        child_id m_next_id;
+        /** Number of children without pidfd, which are polled */
+        std::size_t m_polled;
+
+        int m_epoll;
+        /** An eventfd written to wake the thread up */
+        int m_wakeup;
+        bool m_stop;
+        boost::thread m_thread;
+        /** The buffer in which the thread reads the outputs */
+        std::vector<char> m_buffer;
+
+        void wakeup();
+        void run();
+        /** Reaps the child \c id if it exited */
+        void check(child_id id);
+        /** Writes to or reads from a captured stream of the child \c id */
+        void transfer(child_id id, process::Stream stream);
+        /** Removes the child \c id once it is reaped and its pipes are
+         * closed */
+        void finish(child_id id, boost::shared_ptr<child> const& finished);
+    };
+}
+
+#endif
+
@@ -0,0 +1,117 @@
+#ifndef UTILMM_PROCESS_POOL_HH
+#define UTILMM_PROCESS_POOL_HH
+
+#include <utilmm/system/process.hh>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <vector>
+
+namespace utilmm
+{
+    /** Runs processes from a set of pre-forked helper processes
+     *
+     * Each helper is forked when the pool is created, and is connected
+     * to the pool by a socketpair. It receives the jobs as frames
+     * describing a process (command line, environment, working
+     * directory, redirections and captured streams), then forks and
+     * executes the command, forwards the captured outputs and sends
+     * back the exit status. The file descriptors given to
+     * process::redirect_to are passed to the helper along with the job.
+     *
+     * The helpers are as small as the program was when the pool was
+     * created. Creating the pool early, before the program allocates a
+     * lot of memory or starts threads, keeps them cheap to fork. At
+     * most one job runs in each helper, the others wait in a queue.
+     *
+     * A helper which dies, for instance because it has been killed, is
+     * replaced by forking the program again before the next job of its
+     * worker. That fork costs as much as one of process::start() with
+     * the Fork launcher.
+     *
+     * While a job is queued or running, its process object is running():
+     * process::wait() waits for the job to finish, and process::signal()
+     * sends the signal to the command once it is started. The launcher
+     * of the process is not used.
+     *
+     * @ingroup system
+     */
+    class process_pool : private boost::noncopyable
+    {
+    public:
+        typedef boost::shared_ptr<process> process_ptr;
+        /** Called from a thread of the pool once a job finished. The
+         * second argument is zero, or the errno value if the command
+         * could not be started. It must not throw */
+        typedef boost::function<void (process&, int)> exit_callback;
+
+        /** Forks \c helper_count helpers, one per CPU if zero. If \c
+         * max_queued is not zero, submit() blocks while \c max_queued
+         * jobs are waiting for a helper
+         * @throws unix_error if the helpers cannot be created */
+        explicit process_pool(std::size_t helper_count = 0, std::size_t max_queued = 0);
+        /** Finishes the queued jobs and stops the helpers */
+        ~process_pool();
+
+        /** Queues the command of \c prs, and calls \c on_exit once it
+         * finished
+         * @throws process::already_running if \c prs is running */
+        void submit(process_ptr const& prs, exit_callback const& on_exit = exit_callback());
+
+        /** Runs the command of \c prs in a helper and waits for it to
+         * finish
+         * @throws unix_error if the command could not be started, as
+         * process::start() */
+        void run(process& prs);
+
+        /** Waits until all the submitted jobs have finished */
+        void wait_all();
+
+        /** The count of helpers */
+        std::size_t size() const;
+
+    private:
+        struct job
+        {
+            process* prs;
+            process_ptr owner;
+            exit_callback on_exit;
+        };
+
+        struct helper
+        {
+            helper() : pid(0), socket(-1) {}
+            pid_t pid;
+            int socket;
+        };
+
+        mutable boost::mutex m_mutex;
+        boost::condition_variable m_changed;
+        std::deque<job> m_queue;
+        std::size_t m_max_queued;
+        /** Count of jobs queued or running */
+        std::size_t m_pending;
+        bool m_stop;
+        std::vector<helper> m_helpers;
+        boost::thread_group m_threads;
+
+        void enqueue(job const& new_job);
+        /** Forks a new helper from this process. It is called without
+         * m_mutex locked, by the constructor and by the worker of a
+         * helper which died */
+        void spawn(helper& h);
+        /** Stops a helper and reaps it */
+        void stop(helper& h);
+        /** Sends \c current to \c h and waits for the end of the job
+         * @return false if the helper died */
+        bool execute(helper& h, job const& current, int& error);
+        void worker(std::size_t index);
+    };
+}
+
+#endif
+
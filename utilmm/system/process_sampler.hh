@@ -0,0 +1,58 @@
+#ifndef UTILMM_PROCESS_SAMPLER_HH
+#define UTILMM_PROCESS_SAMPLER_HH
+
+#include <utilmm/system/process.hh>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
+
+namespace utilmm
+{
+    /** Periodically reads the resource usage of running processes
+     *
+     * A thread calls process::sample_usage() on each added process at a
+     * fixed period, and passes the result to a callback. Processes are
+     * removed once they are not running anymore. Nothing is sampled
+     * unless a sampler exists.
+     *
+     * This class is only available on Linux.
+     *
+     * @ingroup system
+     */
+    class process_sampler : private boost::noncopyable
+    {
+    public:
+        typedef boost::shared_ptr<process> process_ptr;
+        /** Called from the sampler thread with each sample. It must not
+         * throw */
+        typedef boost::function<void (process&, resource_usage const&)> sample_callback;
+
+        /** Samples the processes every \c period seconds */
+        process_sampler(double period, sample_callback const& callback);
+        ~process_sampler();
+
+        /** Samples \c prs until it finishes or remove() is called */
+        void add(process_ptr const& prs);
+        void remove(process_ptr const& prs);
+        /** The count of processes being sampled */
+        std::size_t size() const;
+
+    private:
+        mutable boost::mutex m_mutex;
+        boost::condition_variable m_changed;
+        std::vector<process_ptr> m_processes;
+        double m_period;
+        sample_callback m_callback;
+        bool m_stop;
+        boost::thread m_thread;
+
+        void run();
+    };
+}
+
+#endif
+
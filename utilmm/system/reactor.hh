@@ -0,0 +1,141 @@
+#ifndef UTILMM_REACTOR_HH
+#define UTILMM_REACTOR_HH
+
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <map>
+#include <set>
+#include <vector>
+#include <stdint.h>
+
+namespace utilmm
+{
+    class base_socket;
+
+    /** Dispatches the readiness of file descriptors and timers to callbacks
+     *
+     * The file descriptors are watched through epoll, which scales to
+     * thousands of descriptors, in edge-triggered mode by default: the
+     * callback is only called again once new data arrives or buffer
+     * space is freed, so it must read or write until the call would
+     * block. The descriptors should therefore be non-blocking, see
+     * base_socket::set_nonblocking.
+     *
+     * \code
+     *  reactor r;
+     *  server.set_nonblocking(true);
+     *  r.add(server, reactor::Read, accept_connections);
+     *  r.add_timer(1.0, print_statistics, 1.0);
+     *  r.run();
+     * \endcode
+     *
+     * The callbacks are called from the thread running run() or
+     * run_once(). They may add and remove descriptors and timers,
+     * including their own. Apart from stop(), the methods must only be
+     * called from that thread, or while the reactor is not running.
+     *
+     * This class is only available on Linux.
+     *
+     * @ingroup system
+     */
+    class reactor : private boost::noncopyable
+    {
+    public:
+        /** The events a descriptor is watched for */
+        enum Event
+        {
+            Read   = 1,
+            Write  = 2,
+            /** Always reported: the peer closed its end, or an error
+             * occured on the descriptor */
+            Hangup = 4,
+            Error  = 8
+        };
+
+        /** Called with the descriptor and an OR-ed field of Event values */
+        typedef boost::function<void (int, int)> io_callback;
+        typedef boost::function<void ()> timer_callback;
+        typedef unsigned long timer_id;
+
+        /** @exception unix_error raised if epoll cannot be created */
+        reactor();
+        ~reactor();
+
+        /** Watches \c fd for \c events, an OR-ed field of Read and Write
+         * @exception unix_error raised if \c fd cannot be watched, for
+         * instance if it is already
+         */
+        void add(int fd, int events, io_callback const& callback, bool edge_triggered = true);
+        /** \overload */
+        void add(base_socket const& socket, int events, io_callback const& callback, bool edge_triggered = true);
+        /** Changes the events \c fd is watched for */
+        void modify(int fd, int events);
+        /** Stops watching \c fd. It must be called before \c fd is
+         * closed */
+        void remove(int fd);
+        /** True if \c fd is watched */
+        bool contains(int fd) const;
+        /** The count of watched descriptors */
+        std::size_t size() const;
+
+        /** Calls \c callback in \c delay seconds, then every \c period
+         * seconds if \c period is not zero */
+        timer_id add_timer(double delay, timer_callback const& callback, double period = 0);
+        /** Cancels a timer. It is a no-op if the timer already fired */
+        void cancel_timer(timer_id id);
+
+        /** Waits at most \c timeout seconds, or until a timer is due if
+         * \c timeout is negative, and calls the callbacks of the ready
+         * descriptors and of the due timers
+         * @return the count of callbacks called
+         */
+        std::size_t run_once(double timeout = -1);
+        /** Calls run_once() until stop() is called */
+        void run();
+        /** Makes run() return. It can be called from any thread, and from
+         * a signal handler */
+        void stop();
+
+    private:
+        struct handler
+        {
+            io_callback callback;
+            int events;
+            bool edge_triggered;
+            /** Distinguishes the successive handlers of the same
+             * descriptor in the events returned by epoll */
+            uint32_t generation;
+        };
+        typedef boost::shared_ptr<handler> handler_ptr;
+
+        struct timer
+        {
+            double deadline;
+            double period;
+            timer_callback callback;
+        };
+        typedef std::map<timer_id, timer> timer_map;
+
+        int m_epoll;
+        /** An eventfd written by stop() */
+        int m_wakeup;
+        boost::atomic<bool> m_stop;
+        /** The handlers, indexed by descriptor */
+        std::vector<handler_ptr> m_handlers;
+        std::size_t m_count;
+        uint32_t m_generation;
+
+        timer_map m_timers;
+        /** The timers sorted by deadline */
+        std::set< std::pair<double, timer_id> > m_deadlines;
+        timer_id m_next_timer;
+
+        void control(int operation, int fd, handler const& h);
+        std::size_t run_timers();
+    };
+}
+
+#endif
+
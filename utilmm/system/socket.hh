@@ -45,6 +45,26 @@ namespace utilmm
 	/** Get the socket file descriptor */
 	int fd() const;
 
+	/** Sets or clears O_NONBLOCK on the socket. In non-blocking mode,
+	 * socket::read, socket::write and server_socket::accept return
+	 * instead of blocking, and socket::connect returns while the
+	 * connection is in progress. Non-blocking sockets are meant to be
+	 * used with a reactor.
+	 *
+	 * @exception unix_error raised if an error occured
+	 */
+	void set_nonblocking(bool enable);
+	/** True if the socket is in non-blocking mode */
+	bool nonblocking() const;
+
+	/** Returns and clears the pending error of the socket (SO_ERROR).
+	 * It tells if a non-blocking connect() succeeded, once the socket is
+	 * writable.
+	 *
+	 * @return an errno value, or zero
+	 */
+	int pending_error() const;
+
 	/** Non-blocking version of \c wait
 	 *
 	 * @param what an OR-ed field of values in the Wait enum
@@ -53,6 +73,9 @@ namespace utilmm
 	bool try_wait(int what) const;
 
 	/** Blocks until one of the specified events is detected on this socket
+	 *
+	 * Uses poll(), so that it works on file descriptors above FD_SETSIZE.
+	 * To wait on many sockets at once, use a reactor instead.
 	 *
 	 * @param what an OR-ed field of values in the Wait enum
 	 */
@@ -74,6 +97,10 @@ namespace utilmm
 	/** Creates a socket object from an already existing file descriptor */
 	socket(int fd);
 
+	/** Opens a new socket which is not connected yet. Use it to call
+	 * set_nonblocking before connect() */
+	socket(Domain domain, Type type);
+
 	/** Opens a new socket in the specified domain and of the specified type,
 	 * and connect it to \c connect_to. \c connect_to is either an IP address
 	 * of the form \c a.b.c.d:port if \c domain is Inet, or a Unix socket name
@@ -84,18 +111,26 @@ namespace utilmm
 	/** Connects or reconnects this socket to the specified peer. \c
 	 * to is either an IP address of the form \c a.b.c.d:port if \c
 	 * domain is Inet, or a Unix socket name otherwise.	 
+	 *
+	 * If the socket is non-blocking, the connection may still be in
+	 * progress when connect() returns. It is established once the socket
+	 * is writable and pending_error() returns zero. Non-blocking Unix
+	 * sockets fail with EAGAIN if the server has too many pending
+	 * connections.
 	 */
 	void connect(std::string const& to);
 
 	/** Reads at most \c size bytes in the specified buffer and returns the
-	 * count of bytes actually read.
+	 * count of bytes actually read. If the socket is non-blocking and no
+	 * data is available, returns -1.
 	 *
 	 * @exception unix_error raised if an error occured
 	 */
 	int read(void* buf, size_t size) const;
 
 	/** Writes at most \c size bytes in the specified buffer and returns
-	 * the count of bytes actually written.
+	 * the count of bytes actually written. If the socket is non-blocking
+	 * and its buffer is full, returns -1.
 	 *
 	 * @exception unix_error raised if an error occured
 	 */
@@ -114,8 +149,10 @@ namespace utilmm
 	void bind(std::string const& to);
 
 	/** Waits for an incoming connection 
-	 * If block is true, wait for a connection. If it is false, do not block 
-	 * and return NULL if there is no connection available
+	 * If the server socket is blocking, wait for a connection. If it is
+	 * non-blocking, do not block and return NULL if there is no
+	 * connection available. The returned socket is non-blocking if the
+	 * server socket is.
 	 */ 
 	socket* accept() const;
 
@@ -0,0 +1,33 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+#ifndef IN_UTILMM_TYPES_FACTORY_HEADER
+# error "Cannot include template files directly"
+#else
+
+namespace utilmm {
+
+  /*
+   * class utilmm::factory<>
+   */
+  template< class AP, typename Id, typename R, typename PC,
+	    template<typename, class, typename> class EP, class Ord >
+  template<class OutputIterator>
+  OutputIterator factory<AP, Id, R, PC, EP, Ord>::create_n
+  (id_param id, size_t n, OutputIterator out) const {
+    typename factory_db::const_iterator i = associations.find(id);
+
+    if( associations.end()==i ) {
+      for( ; n>0; --n, ++out )
+	*out = this->template on_unknown_id<R>(id);
+    } else {
+      PC const &creator = i->second;
+      for( ; n>0; --n, ++out )
+	*out = creator();
+    }
+    return out;
+  }
+
+} // namespace utilmm
+
+#endif // IN_UTILMM_TYPES_FACTORY_HEADER
@@ -27,7 +27,7 @@ namespace utilmm {
      * @ingroup factory
      * @ingroup intern
      */
-    template<class AbstractProduct, typename IdentifierType, typename Result>
+    template<typename IdentifierType, class AbstractProduct, typename Result>
     struct error {
       
       /** @brief factory error exception
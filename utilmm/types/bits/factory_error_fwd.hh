@@ -7,7 +7,7 @@
 namespace utilmm {
   namespace factory_toolbox {
     
-    template<class AbstractProduct, typename IdentifierType, typename Result>
+    template<typename IdentifierType, class AbstractProduct, typename Result>
     struct error;
     
   } // namespace utilmm::factory_toolbox
@@ -0,0 +1,151 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+#ifndef IN_UTILMM_TYPES_HASHED_FACTORY_HEADER
+# error "Cannot include template files directly"
+#else
+
+namespace utilmm {
+
+#define UTILMM_HASHED_FACTORY_TPL \
+  template< class AP, typename Id, typename R, typename PC, \
+	    template<typename, class, typename> class EP, class H, class Eq >
+#define UTILMM_HASHED_FACTORY hashed_factory<AP, Id, R, PC, EP, H, Eq>
+
+  /*
+   * class utilmm::hashed_factory<>
+   */
+  // structors
+  UTILMM_HASHED_FACTORY_TPL
+  UTILMM_HASHED_FACTORY::hashed_factory()
+    :frozen_mask(0ul), is_frozen(false) {}
+
+  // modifiers
+  UTILMM_HASHED_FACTORY_TPL
+  bool UTILMM_HASHED_FACTORY::add(id_param id, creator_param creator) {
+    if( frozen() )
+      return false;
+    return associations.insert(association(id, creator)).second;
+  }
+
+  UTILMM_HASHED_FACTORY_TPL
+  bool UTILMM_HASHED_FACTORY::remove(id_param id) {
+    if( frozen() )
+      return false;
+    return associations.erase(id)==1;
+  }
+
+  UTILMM_HASHED_FACTORY_TPL
+  bool UTILMM_HASHED_FACTORY::make_alias(id_param from, id_param to) {
+    typename factory_db::iterator i = associations.find(to);
+
+    return associations.end()==i || add(from, i->second);
+  }
+
+  UTILMM_HASHED_FACTORY_TPL
+  void UTILMM_HASHED_FACTORY::freeze() {
+    if( frozen() )
+      return;
+
+    // Keep the load factor under 1/2 so that probe sequences stay short
+    size_t size = 1;
+    while( size<2*associations.size() )
+      size <<= 1;
+
+    frozen_cell const empty = { 0, 0 };
+    frozen_db table(size, empty);
+    size_t const mask = size-1;
+    H hf;
+
+    typename factory_db::const_iterator i = associations.begin(),
+      endi = associations.end();
+    for( ; endi!=i; ++i ) {
+      size_t const h = hf(i->first);
+      size_t pos = h&mask;
+
+      while( 0!=table[pos].entry )
+	pos = (pos+1)&mask;
+      table[pos].hash = h;
+      table[pos].entry = &*i;
+    }
+
+    frozen_table.swap(table);
+    frozen_mask = mask;
+    is_frozen.store(true, boost::memory_order_release);
+  }
+
+  // observers
+  UTILMM_HASHED_FACTORY_TPL
+  bool UTILMM_HASHED_FACTORY::frozen() const {
+    return is_frozen.load(boost::memory_order_acquire);
+  }
+
+  UTILMM_HASHED_FACTORY_TPL
+  typename UTILMM_HASHED_FACTORY::association const *
+  UTILMM_HASHED_FACTORY::find(id_param id) const {
+    if( frozen() ) {
+      size_t const h = H()(id);
+      Eq eq;
+
+      for( size_t pos = h&frozen_mask; 0!=frozen_table[pos].entry; 
+	   pos = (pos+1)&frozen_mask ) {
+	frozen_cell const &cell = frozen_table[pos];
+	if( cell.hash==h && eq(cell.entry->first, id) )
+	  return cell.entry;
+      }
+      return 0;
+    } else {
+      typename factory_db::const_iterator i = associations.find(id);
+
+      return associations.end()==i ? 0 : &*i;
+    }
+  }
+
+  UTILMM_HASHED_FACTORY_TPL
+  R UTILMM_HASHED_FACTORY::create(id_param id) const {
+    association const *entry = find(id);
+
+    if( 0==entry )
+      return this->template on_unknown_id<R>(id);
+    else
+      return (entry->second)();
+  }
+
+  UTILMM_HASHED_FACTORY_TPL
+  template<class OutputIterator>
+  OutputIterator UTILMM_HASHED_FACTORY::create_n
+  (id_param id, size_t n, OutputIterator out) const {
+    association const *entry = find(id);
+
+    if( 0==entry ) {
+      for( ; n>0; --n, ++out )
+	*out = this->template on_unknown_id<R>(id);
+    } else {
+      PC const &creator = entry->second;
+      for( ; n>0; --n, ++out )
+	*out = creator();
+    }
+    return out;
+  }
+
+  UTILMM_HASHED_FACTORY_TPL
+  bool UTILMM_HASHED_FACTORY::check_entry(id_param id) const {
+    return 0!=find(id);
+  }
+
+  UTILMM_HASHED_FACTORY_TPL
+  PC const &UTILMM_HASHED_FACTORY::get_creator(id_param id) const {
+    association const *entry = find(id);
+
+    if( 0==entry )
+      return this->template on_unknown_id<PC const &>(id);
+    else
+      return entry->second;
+  }
+
+#undef UTILMM_HASHED_FACTORY
+#undef UTILMM_HASHED_FACTORY_TPL
+
+} // namespace utilmm
+
+#endif // IN_UTILMM_TYPES_HASHED_FACTORY_HEADER
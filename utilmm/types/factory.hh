@@ -5,6 +5,8 @@
 # define UTILMM_TYPES_FACTORY_HEADER
 #include "utilmm/config/config.h"
 
+# include <map>
+
 #include "boost/utility.hpp"
 
 #include "utilmm/singleton/wrapper_fwd.hh"
@@ -113,15 +115,31 @@ namespace utilmm {
      * @note If there's no creation method attched to @a id this function
      * will call @c FactoryErrorPolicy::on_unknown_id
      */
-    Result create(id_param id) {
-      typename factory_db::iterator i = associations.find(id);
+    Result create(id_param id) const {
+      typename factory_db::const_iterator i = associations.find(id);
       
       if( associations.end()==i )
-	return this->on_unknown_id(id);
+	return this->template on_unknown_id<Result>(id);
       else
 	return (i->second)();
     }
 
+    /** @brief Batch creation method
+     * @param id an identifer
+     * @param n the number of products to create
+     * @param out where the products are written
+     *
+     * Create @a n new products using the creation method attached to
+     * @a id. The creation method is looked up only once.
+     *
+     * @return @a out advanced past the last created product
+     *
+     * @note If there's no creation method attched to @a id this function
+     * will call @c FactoryErrorPolicy::on_unknown_id for each product
+     */
+    template<class OutputIterator>
+    OutputIterator create_n(id_param id, size_t n, OutputIterator out) const;
+
     /** @brief Check for entry
      * @param id an identifer
      *
@@ -143,13 +161,13 @@ namespace utilmm {
      * @return A creation method
      *
      * @note In case there's no crezation method attached to @a id this
-     * function will call @c FactoryErrorPolicy::on_unknown_type
+     * function will call @c FactoryErrorPolicy::on_unknown_id
      */
     ProductCreator const &get_creator(id_param id) const {
       typename factory_db::const_iterator i = associations.find(id);
       
       if( associations.end()==i )
-	return this->on_unknown_type(id);
+	return this->template on_unknown_id<ProductCreator const &>(id);
       else
 	return i->second;
     }
@@ -0,0 +1,197 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+#ifndef UTILMM_TYPES_HASHED_FACTORY_HEADER
+# define UTILMM_TYPES_HASHED_FACTORY_HEADER
+#include "utilmm/config/config.h"
+
+# include <vector>
+
+#include "boost/utility.hpp"
+#include "boost/atomic.hpp"
+#include "boost/unordered_map.hpp"
+
+#include "utilmm/singleton/wrapper_fwd.hh"
+#include "utilmm/functional/arg_traits.hh"
+
+#include "utilmm/types/hashed_factory_fwd.hh"
+#include "utilmm/types/bits/factory_error.hh"
+
+namespace utilmm {
+
+  /** @brief Generic Factory implementation with hashed lookup
+   *
+   * This class offers the same interface as @c utilmm::factory but
+   * stores its creation methods in a hash table, making @c create an
+   * O(1) operation.
+   *
+   * Once all the creation methods are registered, the factory can be
+   * frozen (see freeze()). A frozen factory does not accept new
+   * creation methods anymore and compacts its content in a flat,
+   * open-addressing table that can be queried concurrently by any
+   * number of threads without locking.
+   *
+   * @param AbstractProduct Base type for the produced instances.
+   * @param IdentifierType Type of the production method identifiers.   
+   * @param Result Type of the result (@c AbstractProduct*).
+   * @param ProductCreator Type of the creation methods (@c Result(*)()). 
+   * @param FactoryErrorPolicy Error management policy
+   * (@c utilmm::factory_toolbox::error)
+   * @param Hash hashing functor for @a IdentifierType
+   * (@c boost::hash<IdentifierType>)
+   * @param Equal equality functor for @a IdentifierType
+   * (@c std::equal_to<IdentifierType>)
+   *
+   * @note this class is a singleton
+   *
+   * @sa utilmm::factory
+   * @sa utilmm::singleton::use
+   *
+   * @ingroup factory
+   */
+  template< class AbstractProduct, typename IdentifierType, typename Result,
+	    typename ProductCreator,
+	    template<typename, class, typename> class FactoryErrorPolicy,
+	    class Hash, class Equal >
+  class hashed_factory
+    :public FactoryErrorPolicy<IdentifierType, AbstractProduct, Result>,
+     public boost::noncopyable {
+  private:
+    typedef typename arg_traits<IdentifierType>::type id_param;
+    typedef typename arg_traits<ProductCreator>::type creator_param;
+
+    typedef boost::unordered_map<IdentifierType, ProductCreator, 
+				 Hash, Equal> factory_db;
+    typedef typename factory_db::value_type association;
+
+    /** @brief Cell of the frozen table
+     *
+     * @c entry is null for empty cells. It points directly into @c
+     * associations, which is not modified anymore once frozen.
+     */
+    struct frozen_cell {
+      size_t hash;
+      association const *entry;
+    };
+    typedef std::vector<frozen_cell> frozen_db;
+
+    factory_db associations;
+    frozen_db  frozen_table;
+    size_t     frozen_mask;
+    boost::atomic<bool> is_frozen;
+
+    association const *find(id_param id) const;
+
+  public:
+    /** @brief Add a new production method 
+     *
+     * @param id Identifier for the production method
+     * @param creator Production method.
+     * 
+     * @retval true if the new creation method was added
+     * @retval false if there was already a creation method with @a id,
+     * or if the factory is frozen
+     */
+    bool add(id_param id, creator_param creator);
+    /** @brief Remove a production method
+     *
+     * @param id The identifier of the creation method to remove
+     *
+     * @retval true if the creation method was removed.
+     * @retval false if there was no creation method attached to @a id,
+     * or if the factory is frozen
+     */
+    bool remove(id_param id);
+    /** @brief Alias creation
+     *
+     * @param from The alias identifier
+     * @param to an identifer
+     *
+     * This method will try to create an alias to cration method named @a to
+     *
+     * @retval true if the alias was created
+     * @retval false else
+     */
+    bool make_alias(id_param from, id_param to);
+
+    /** @brief Compact and lock the factory
+     *
+     * After this call, the creation methods cannot be changed anymore
+     * and @c create, @c check_entry and @c get_creator can be called
+     * concurrently without any locking. Calling freeze() on a frozen
+     * factory has no effect.
+     *
+     * @pre No other thread is accessing the factory during the call
+     */
+    void freeze();
+    /** @brief Check if freeze() has been called */
+    bool frozen() const;
+
+    /** @brief Creation method
+     * @param id an identifer
+     *
+     * Create a new product using the cration method attched to @a id
+     *
+     * @return The created product
+     *
+     * @note If there's no creation method attched to @a id this function
+     * will call @c FactoryErrorPolicy::on_unknown_id
+     */
+    Result create(id_param id) const;
+
+    /** @brief Batch creation method
+     * @param id an identifer
+     * @param n the number of products to create
+     * @param out where the products are written
+     *
+     * Create @a n new products using the creation method attached to
+     * @a id. The creation method is looked up only once.
+     *
+     * @return @a out advanced past the last created product
+     *
+     * @note If there's no creation method attched to @a id this function
+     * will call @c FactoryErrorPolicy::on_unknown_id for each product
+     */
+    template<class OutputIterator>
+    OutputIterator create_n(id_param id, size_t n, OutputIterator out) const;
+
+    /** @brief Check for entry
+     * @param id an identifer
+     *
+     * @retval true If thered's a creation method attched to @a id
+     * @retval false else
+     */
+    bool check_entry(id_param id) const;
+
+    /** @brief Creation method access
+     *
+     * @param id An identifier
+     * 
+     * @return The creation method attached to @a id
+     *
+     * @note In case there's no creation method attached to @a id this
+     * function will call @c FactoryErrorPolicy::on_unknown_id
+     */
+    ProductCreator const &get_creator(id_param id) const;
+    
+  private:
+    hashed_factory();
+    ~hashed_factory() {}
+
+    template<class Ty>
+    friend class singleton::wrapper;
+  }; // class utilmm::hashed_factory<>
+            
+} // namespace utilmm
+
+# define IN_UTILMM_TYPES_HASHED_FACTORY_HEADER
+#include "utilmm/types/bits/hashed_factory.tcc"
+# undef IN_UTILMM_TYPES_HASHED_FACTORY_HEADER
+#endif // UTILMM_TYPES_HASHED_FACTORY_HEADER
+/** @file types/hashed_factory.hh
+ * @brief Defintion of utilmm::hashed_factory
+ *
+ * This header defines The @c utilmm::hashed_factory class
+ *
+ * @ingroup factory
+ */
@@ -0,0 +1,31 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+#ifndef UTILMM_TYPES_HASHED_FACTORY_FWD
+# define UTILMM_TYPES_HASHED_FACTORY_FWD
+
+# include <functional>
+
+#include "boost/functional/hash/hash_fwd.hpp"
+
+#include "utilmm/types/bits/factory_error_fwd.hh" 
+
+namespace utilmm {
+  
+  template< class AbstractProduct, typename IdentifierType, 
+	    typename Result = AbstractProduct *,
+	    typename ProductCreator = Result (*)(),
+	    template<typename, class, typename> 
+            class FactoryErrorPolicy = factory_toolbox::error,
+	    class Hash = boost::hash<IdentifierType>,
+	    class Equal = std::equal_to<IdentifierType> >
+  class hashed_factory;
+
+} // namespace utilmm
+
+#endif // UTILMM_TYPES_HASHED_FACTORY_FWD
+/** @file types/hashed_factory_fwd.hh
+ * @brief Forward declaration of utilmm::hashed_factory
+ *
+ * @ingroup factory
+ */
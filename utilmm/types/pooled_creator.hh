@@ -0,0 +1,110 @@
+/* -*- C++ -*-
+ * $Id$
+ */
+#ifndef UTILMM_TYPES_POOLED_CREATOR_HEADER
+# define UTILMM_TYPES_POOLED_CREATOR_HEADER
+
+#include "boost/shared_ptr.hpp"
+#include "boost/function.hpp"
+
+#include "utilmm/memory/objectpool.hh"
+
+namespace utilmm {
+  namespace factory_toolbox {
+
+    /** @brief Product types for pooled factories
+     *
+     * This class gives the @c Result and @c ProductCreator parameters to
+     * use with @c utilmm::factory or @c utilmm::hashed_factory so that
+     * products are recycled through an object pool instead of being
+     * allocated and deleted.
+     *
+     * @code
+     * typedef pooled<base> policy;
+     * typedef utilmm::hashed_factory<base, std::string,
+     *           policy::result, policy::creator> base_factory;
+     *
+     * utilmm::singleton::use<base_factory> f;
+     * f->add("derived", pooled_creator<derived, base>());
+     * @endcode
+     *
+     * @param AbstractProduct Base type for the produced instances.
+     *
+     * @sa utilmm::factory_toolbox::pooled_creator
+     *
+     * @ingroup factory
+     */
+    template<class AbstractProduct>
+    struct pooled {
+      /** @brief The product type 
+       *
+       * The object goes back to its pool when the last copy of the
+       * pointer is destroyed.
+       */
+      typedef boost::shared_ptr<AbstractProduct> result;
+      /** @brief The creation method type */
+      typedef boost::function<result ()> creator;
+    }; // struct utilmm::factory_toolbox::pooled<>
+
+    /** @brief Creation method for pooled products
+     *
+     * Each copy of a given pooled_creator shares the same pool of
+     * @a Concrete objects. The pool lives as long as either a creator
+     * or one of the products does.
+     *
+     * @note Recycled products are not reconstructed: they are handed
+     * out in the state their last user left them in.
+     *
+     * @param Concrete Type of the created objects. It must be default
+     * constructible.
+     * @param AbstractProduct Base type for the produced instances.
+     *
+     * @ingroup factory
+     */
+    template<class Concrete, class AbstractProduct = Concrete>
+    class pooled_creator {
+    public:
+      typedef pools::object_pool<Concrete> pool_type;
+      typedef typename pooled<AbstractProduct>::result result_type;
+
+      pooled_creator()
+	:the_pool(new pool_type) {}
+
+      /** @brief Get a product from the pool */
+      result_type operator()() const {
+	return result_type(the_pool->get(), recycle(the_pool));
+      }
+
+      /** @brief Access to the underlying pool
+       *
+       * It can be used for instance to pre-allocate products with
+       * @c pool_type::reserve
+       */
+      pool_type &pool() const {
+	return *the_pool;
+      }
+
+    private:
+      struct recycle {
+	explicit recycle(boost::shared_ptr<pool_type> const &p)
+	  :pool(p) {}
+
+	void operator()(Concrete *product) const {
+	  pool->put(product);
+	}
+
+	boost::shared_ptr<pool_type> pool;
+      };
+
+      boost::shared_ptr<pool_type> the_pool;
+    }; // class utilmm::factory_toolbox::pooled_creator<>
+
+  } // namespace utilmm::factory_toolbox
+} // namespace utilmm
+
+#endif // UTILMM_TYPES_POOLED_CREATOR_HEADER
+/** @file types/pooled_creator.hh
+ * @brief Definition of utilmm::factory_toolbox::pooled_creator
+ *
+ * @ingroup factory
+ */